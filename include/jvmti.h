@@ -30,7 +30,7 @@
 #ifndef _JAVA_JVMTI_H_
 #define _JAVA_JVMTI_H_
 
-#include "../jni.h"
+#include "jni.h"
 
 #ifdef __cplusplus
 extern "C" {
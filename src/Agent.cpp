@@ -0,0 +1,375 @@
+#include "Agent.h"
+#include "AllocationSites.h"
+#include "BreakpointProbes.h"
+#include "ClassList.h"
+#include "ClassTimeline.h"
+#include "ContinuousProfiler.h"
+#include "CrashHandler.h"
+#include "ExceptionMonitor.h"
+#include "FlightRecorder.h"
+#include "FrameClock.h"
+#include "Mappings.h"
+#include "Milestones.h"
+#include "NativeRegistry.h"
+#include "Options.h"
+#include "Pprof.h"
+#include "Prewarm.h"
+#include "Probes.h"
+#include "RuntimeEvents.h"
+#include "Sampler.h"
+#include "SymbolCache.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+#include "Platform.h"
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+    std::mutex liveLock;
+    std::condition_variable liveChanged;
+    bool live = false;
+
+    // Also called when initialization fails, so awaitLive() never blocks the client for good.
+    void setLive() {
+        std::lock_guard guard(liveLock);
+        live = true;
+        liveChanged.notify_all();
+    }
+    std::atomic_bool shutDown = false;
+    std::mutex loaderLock;
+    std::unordered_map<jint, std::string> loaderNames;
+
+    bool check(jvmtiError error, const char* what) {
+        if (error == JVMTI_ERROR_NONE) return true;
+        std::cerr << "[Rynox] " << what << " failed (JVMTI error " << error << ")." << std::endl;
+        return false;
+    }
+
+    void enableEvent(jvmtiEvent event) {
+        check(Agent::jvmti->SetEventNotificationMode(JVMTI_ENABLE, event, nullptr), "SetEventNotificationMode");
+    }
+
+    void JNICALL onVMInit(jvmtiEnv* jvmti, JNIEnv* env, jthread thread) {
+        // Runs on the main thread, which started before ThreadStart events were enabled.
+        if (Trace::enabled()) Trace::onThreadStart(jvmti, env, thread);
+        if (ThreadCpu::enabled()) ThreadCpu::onThreadStart(jvmti, env, thread);
+        CrashHandler::install();
+        Probes::start(env);
+        setLive();
+    }
+
+    // Reports are written here rather than in Agent_OnUnload, which a System.exit does not always reach.
+    void JNICALL onVMDeath(jvmtiEnv* jvmti, JNIEnv* env) {
+        Agent::shutdown();
+    }
+
+    void JNICALL onThreadStart(jvmtiEnv* jvmti, JNIEnv* env, jthread thread) {
+        if (Trace::enabled()) Trace::onThreadStart(jvmti, env, thread);
+        if (ThreadCpu::enabled()) ThreadCpu::onThreadStart(jvmti, env, thread);
+    }
+
+    void JNICALL onThreadEnd(jvmtiEnv* jvmti, JNIEnv* env, jthread thread) {
+        if (ThreadCpu::enabled()) ThreadCpu::onThreadEnd(jvmti, env, thread);
+    }
+
+    void JNICALL onSampledObjectAlloc(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object, jclass klass, jlong size) {
+        Sampler::onSampledObjectAlloc(jvmti, env, thread, size);
+    }
+
+    void JNICALL onGarbageCollectionStart(jvmtiEnv* jvmti) {
+        if (RuntimeEvents::enabled()) RuntimeEvents::onGarbageCollectionStart();
+    }
+
+    void JNICALL onGarbageCollectionFinish(jvmtiEnv* jvmti) {
+        SymbolCache::onGarbageCollectionFinish();
+        if (RuntimeEvents::enabled()) RuntimeEvents::onGarbageCollectionFinish();
+    }
+
+    void JNICALL onCompiledMethodLoad(jvmtiEnv* jvmti, jmethodID method, jint codeSize, const void* codeAddress,
+                                      jint mapLength, const jvmtiAddrLocationMap* map, const void* compileInfo) {
+        RuntimeEvents::onCompiledMethodLoad(jvmti, method, codeSize);
+    }
+
+    void JNICALL onMonitorWait(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object, jlong timeout) {
+        RuntimeEvents::onMonitorWait(jvmti, env, thread, object);
+    }
+
+    void JNICALL onMonitorWaited(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object, jboolean timedOut) {
+        RuntimeEvents::onMonitorWaited(jvmti, env, thread, object);
+    }
+
+    void JNICALL onMonitorContendedEnter(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object) {
+        RuntimeEvents::onMonitorContendedEnter(jvmti, env, thread, object);
+    }
+
+    void JNICALL onMonitorContendedEntered(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object) {
+        RuntimeEvents::onMonitorContendedEntered(jvmti, env, thread, object);
+    }
+
+    void JNICALL onBreakpoint(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location) {
+        FrameClock::onBreakpoint(jvmti, env, thread, method, location);
+        BreakpointProbes::onBreakpoint(jvmti, env, thread, method, location);
+    }
+
+    void JNICALL onNativeMethodBind(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, void* address, void** newAddress) {
+        NativeRegistry::onNativeMethodBind(jvmti, env, method, address, newAddress);
+    }
+
+    void JNICALL onClassFileLoadHook(jvmtiEnv* jvmti, JNIEnv* env, jclass classBeingRedefined, jobject loader,
+                                     const char* name, jobject protectionDomain, jint classDataLen,
+                                     const unsigned char* classData, jint* newClassDataLen, unsigned char** newClassData) {
+        if (Probes::enabled()) {
+            Probes::onClassFileLoadHook(jvmti, loader, name, classBeingRedefined != nullptr, classDataLen, classData, newClassDataLen,
+                                        newClassData);
+        }
+        if (classBeingRedefined) return;
+        if (ClassTimeline::enabled()) ClassTimeline::onClassFileLoadHook(name);
+    }
+
+    void JNICALL onException(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location,
+                             jobject exception, jmethodID catchMethod, jlocation catchLocation) {
+        ExceptionMonitor::onException(jvmti, env, thread, method, location, exception, catchMethod, catchLocation);
+    }
+
+    void JNICALL onClassLoad(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jclass klass) {
+        std::string name = Agent::className(jvmti, klass);
+        jobject loader = nullptr;
+        jvmti->GetClassLoader(klass, &loader);
+        jint loaderHash = Agent::loaderHash(jvmti, loader);
+        std::string loaderName = Agent::loaderName(jvmti, env, loader);
+
+        if (ClassTimeline::enabled()) ClassTimeline::onClassLoad(jvmti, env, thread, name, loaderName, loaderHash);
+        if (ClassList::enabled()) ClassList::onClassLoad(name, loaderName);
+        if (Prewarm::enabled()) Prewarm::onClassLoad(env, loader, name, loaderName);
+
+        if (loader) env->DeleteLocalRef(loader);
+    }
+
+    void JNICALL onClassPrepare(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jclass klass) {
+        std::string name = Agent::className(jvmti, klass);
+        jobject loader = nullptr;
+        jvmti->GetClassLoader(klass, &loader);
+        jint loaderHash = Agent::loaderHash(jvmti, loader);
+        if (loader) env->DeleteLocalRef(loader);
+
+        if (ClassTimeline::enabled()) ClassTimeline::onClassPrepare(name, loaderHash);
+        if (FrameClock::enabled()) FrameClock::onClassPrepare(jvmti, klass, name);
+        if (BreakpointProbes::enabled()) BreakpointProbes::onClassPrepare(jvmti, klass, name);
+        Milestones::onClassPrepare(name);
+    }
+}
+
+bool Agent::initialize(JavaVM* vm, const char* options, bool onLoad) {
+    if (jvmti) return true;
+
+    jvm = vm;
+    startNanos = Platform::nanoTime();
+    Options::parse(options);
+
+    if (!onLoad) setLive();
+
+    if (vm->GetEnv(reinterpret_cast<void**>(&jvmti), JVMTI_VERSION_11) != JNI_OK || !jvmti) {
+        std::cerr << "[Rynox] JVMTI is not available." << std::endl;
+        jvmti = nullptr;
+        setLive();
+        return false;
+    }
+
+    Mappings::configure();
+    Milestones::configure();
+    SymbolCache::configure();
+    FlightRecorder::configure();
+    Trace::configure();
+    ClassTimeline::configure();
+    ClassList::configure();
+    Prewarm::configure();
+    ExceptionMonitor::configure();
+    ThreadCpu::configure();
+    ContinuousProfiler::configure();
+    Pprof::configure();
+    Sampler::configure();
+    RuntimeEvents::configure();
+    FrameClock::configure();
+    BreakpointProbes::configure();
+    Probes::configure();
+    NativeRegistry::configure();
+    AllocationSites::configure();
+    CrashHandler::configure();
+
+    jvmtiCapabilities potential{};
+    jvmti->GetPotentialCapabilities(&potential);
+
+    jvmtiCapabilities caps{};
+    // Each class event only for its consumers, so probes alone leave ClassLoad and ClassPrepare off.
+    // Milestones trigger on ClassPrepare for ClassTimeline, ClassList and Prewarm.
+    bool classHook = ClassTimeline::enabled() || Probes::enabled();
+    bool classLoad = ClassTimeline::enabled() || ClassList::enabled() || Prewarm::enabled();
+    bool classPrepare = classLoad || FrameClock::enabled() || BreakpointProbes::enabled();
+    if ((classHook || classPrepare) && onLoad) {
+        // Only grantable during OnLoad; they let us see the classes loaded before VMInit.
+        caps.can_generate_early_vmstart = potential.can_generate_early_vmstart;
+        caps.can_generate_all_class_hook_events = potential.can_generate_all_class_hook_events;
+        caps.can_generate_early_class_hook_events = potential.can_generate_early_class_hook_events;
+    }
+    caps.can_get_line_numbers = potential.can_get_line_numbers;
+    caps.can_generate_garbage_collection_events = potential.can_generate_garbage_collection_events;
+    caps.can_generate_exception_events = ExceptionMonitor::enabled() && potential.can_generate_exception_events;
+    caps.can_get_thread_cpu_time = ThreadCpu::enabled() && potential.can_get_thread_cpu_time;
+    caps.can_generate_compiled_method_load_events = RuntimeEvents::enabled() && potential.can_generate_compiled_method_load_events;
+    caps.can_generate_monitor_events = RuntimeEvents::monitorsEnabled() && potential.can_generate_monitor_events;
+    caps.can_generate_breakpoint_events = (FrameClock::enabled() || BreakpointProbes::enabled()) && potential.can_generate_breakpoint_events;
+    caps.can_generate_sampled_object_alloc_events = Sampler::allocEnabled() && potential.can_generate_sampled_object_alloc_events;
+    caps.can_retransform_classes = Probes::enabled() && potential.can_retransform_classes;
+    caps.can_set_native_method_prefix = Probes::nativesEnabled() && potential.can_set_native_method_prefix;
+    caps.can_generate_native_method_bind_events = NativeRegistry::enabled() && potential.can_generate_native_method_bind_events;
+    caps.can_get_bytecodes = AllocationSites::enabled() && potential.can_get_bytecodes;
+    caps.can_get_constant_pool = AllocationSites::enabled() && potential.can_get_constant_pool;
+    if (!check(jvmti->AddCapabilities(&caps), "AddCapabilities")) {
+        setLive();
+        return false;
+    }
+    if (Probes::nativesEnabled()) Probes::setNativePrefix(jvmti);
+    earlyStart = caps.can_generate_early_vmstart && caps.can_generate_early_class_hook_events;
+
+    jvmtiEventCallbacks callbacks{};
+    callbacks.VMInit = &onVMInit;
+    callbacks.VMDeath = &onVMDeath;
+    callbacks.ThreadStart = &onThreadStart;
+    callbacks.ThreadEnd = &onThreadEnd;
+    callbacks.ClassFileLoadHook = &onClassFileLoadHook;
+    callbacks.ClassLoad = &onClassLoad;
+    callbacks.ClassPrepare = &onClassPrepare;
+    callbacks.Exception = &onException;
+    callbacks.GarbageCollectionStart = &onGarbageCollectionStart;
+    callbacks.GarbageCollectionFinish = &onGarbageCollectionFinish;
+    callbacks.CompiledMethodLoad = &onCompiledMethodLoad;
+    callbacks.MonitorWait = &onMonitorWait;
+    callbacks.MonitorWaited = &onMonitorWaited;
+    callbacks.MonitorContendedEnter = &onMonitorContendedEnter;
+    callbacks.MonitorContendedEntered = &onMonitorContendedEntered;
+    callbacks.Breakpoint = &onBreakpoint;
+    callbacks.SampledObjectAlloc = &onSampledObjectAlloc;
+    callbacks.NativeMethodBind = &onNativeMethodBind;
+    if (!check(jvmti->SetEventCallbacks(&callbacks, sizeof(callbacks)), "SetEventCallbacks")) {
+        setLive();
+        return false;
+    }
+
+    if (onLoad) enableEvent(JVMTI_EVENT_VM_INIT);
+    enableEvent(JVMTI_EVENT_VM_DEATH);
+    if (caps.can_generate_garbage_collection_events) {
+        enableEvent(JVMTI_EVENT_GARBAGE_COLLECTION_FINISH);
+        if (RuntimeEvents::enabled()) enableEvent(JVMTI_EVENT_GARBAGE_COLLECTION_START);
+    }
+    if (caps.can_generate_compiled_method_load_events) enableEvent(JVMTI_EVENT_COMPILED_METHOD_LOAD);
+    if (caps.can_generate_monitor_events) {
+        enableEvent(JVMTI_EVENT_MONITOR_WAIT);
+        enableEvent(JVMTI_EVENT_MONITOR_WAITED);
+        enableEvent(JVMTI_EVENT_MONITOR_CONTENDED_ENTER);
+        enableEvent(JVMTI_EVENT_MONITOR_CONTENDED_ENTERED);
+    }
+    if (caps.can_generate_breakpoint_events) enableEvent(JVMTI_EVENT_BREAKPOINT);
+    if (caps.can_generate_native_method_bind_events) enableEvent(JVMTI_EVENT_NATIVE_METHOD_BIND);
+    if (classHook) enableEvent(JVMTI_EVENT_CLASS_FILE_LOAD_HOOK);
+    if (classLoad) enableEvent(JVMTI_EVENT_CLASS_LOAD);
+    if (classPrepare) enableEvent(JVMTI_EVENT_CLASS_PREPARE);
+    if (caps.can_generate_exception_events) enableEvent(JVMTI_EVENT_EXCEPTION);
+    if (ThreadCpu::enabled() || Trace::enabled()) {
+        enableEvent(JVMTI_EVENT_THREAD_START);
+        enableEvent(JVMTI_EVENT_THREAD_END);
+    }
+    if (caps.can_generate_sampled_object_alloc_events) {
+        check(jvmti->SetHeapSamplingInterval(static_cast<jint>(Sampler::allocInterval())), "SetHeapSamplingInterval");
+        enableEvent(JVMTI_EVENT_SAMPLED_OBJECT_ALLOC);
+    }
+
+    if (caps.can_generate_breakpoint_events) {
+        FrameClock::start(jvmti);
+        BreakpointProbes::start(jvmti);
+    }
+    if (!onLoad) {
+        CrashHandler::install();
+        JNIEnv* env = nullptr;
+        if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_8) == JNI_OK && env) Probes::start(env);
+    }
+    ThreadCpu::start();
+    Sampler::start();
+    ContinuousProfiler::start();
+    FlightRecorder::start();
+    return true;
+}
+
+void Agent::shutdown() {
+    if (shutDown.exchange(true)) return;
+    ThreadCpu::stop();
+    Sampler::stop();
+    ContinuousProfiler::stop();
+    Probes::stop();
+    Pprof::writeConfigured();
+    ClassTimeline::writeReport();
+    ClassList::write();
+    Prewarm::write();
+    ExceptionMonitor::writeReport();
+    Probes::writeReport();
+    NativeRegistry::write(jvmti);
+    AllocationSites::write(jvmti);
+    FlightRecorder::stop();
+    Trace::close();
+}
+
+void Agent::awaitLive() {
+    std::unique_lock guard(liveLock);
+    liveChanged.wait(guard, [] { return live; });
+}
+
+std::string Agent::className(jvmtiEnv* jvmti, jclass klass) {
+    char* signature = nullptr;
+    if (jvmti->GetClassSignature(klass, &signature, nullptr) != JVMTI_ERROR_NONE || !signature) return {};
+
+    std::string name(signature);
+    jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+    if (name.size() >= 2 && name.front() == 'L' && name.back() == ';') return name.substr(1, name.size() - 2);
+    return name;
+}
+
+std::string Agent::methodLocation(jvmtiEnv* jvmti, JNIEnv* env, jmethodID method, jlocation location) {
+    return SymbolCache::describe(SymbolCache::lookup(jvmti, env, method), location);
+}
+
+jint Agent::loaderHash(jvmtiEnv* jvmti, jobject loader) {
+    jint hash = 0;
+    if (loader) jvmti->GetObjectHashCode(loader, &hash);
+    return hash;
+}
+
+std::string Agent::loaderName(jvmtiEnv* jvmti, JNIEnv* env, jobject loader) {
+    if (!loader) return "bootstrap";
+
+    jint hash = loaderHash(jvmti, loader);
+    {
+        std::lock_guard guard(loaderLock);
+        auto it = loaderNames.find(hash);
+        if (it != loaderNames.end()) return it->second;
+    }
+
+    jclass loaderClass = env->GetObjectClass(loader);
+    std::string name = className(jvmti, loaderClass);
+    env->DeleteLocalRef(loaderClass);
+
+    std::lock_guard guard(loaderLock);
+    loaderNames.emplace(hash, name);
+    return name;
+}
+
+bool Agent::isBuiltinLoader(std::string_view loaderName) {
+    return loaderName == "bootstrap" || loaderName == "jdk/internal/loader/ClassLoaders$PlatformClassLoader" ||
+           loaderName == "jdk/internal/loader/ClassLoaders$AppClassLoader";
+}
+
+bool Agent::isGeneratedClass(std::string_view name) {
+    return name.find("/0x") != std::string_view::npos || name.find("+0x") != std::string_view::npos ||
+           name.find("$$Lambda") != std::string_view::npos;
+}
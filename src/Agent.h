@@ -0,0 +1,37 @@
+#ifndef AGENT_H
+#define AGENT_H
+
+#include <jvmti.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// JVMTI side of the agent: owns the jvmtiEnv, the capabilities and the single event callback table
+// that fans events out to the telemetry subsystems enabled through the agent options.
+namespace Agent {
+    inline JavaVM* jvm = nullptr;
+    inline jvmtiEnv* jvmti = nullptr;
+    inline uint64_t startNanos = 0;
+    // True when loaded at startup with early VM start and early class hook events available.
+    inline bool earlyStart = false;
+
+    bool initialize(JavaVM* vm, const char* options, bool onLoad);
+    void shutdown();
+    // Blocks until VMInit when loaded at startup; JNI threads cannot attach before that.
+    void awaitLive();
+
+    // Internal name ("java/lang/String") of a class.
+    std::string className(jvmtiEnv* jvmti, jclass klass);
+    // "java/lang/String.valueOf(I)Ljava/lang/String;:123", with the line number when available.
+    std::string methodLocation(jvmtiEnv* jvmti, JNIEnv* env, jmethodID method, jlocation location);
+    // Identity hash of a loader object, 0 for the bootstrap loader.
+    jint loaderHash(jvmtiEnv* jvmti, jobject loader);
+    // Internal class name of a loader object, or "bootstrap" for the null loader. Cached per loader.
+    std::string loaderName(jvmtiEnv* jvmti, JNIEnv* env, jobject loader);
+    // True for the bootstrap, platform and application loaders that CDS can archive from a class list.
+    bool isBuiltinLoader(std::string_view loaderName);
+    // Hidden classes (lambda forms, lambda proxies) are generated at runtime and cannot be loaded by name.
+    bool isGeneratedClass(std::string_view name);
+}
+
+#endif //AGENT_H
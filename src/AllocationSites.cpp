@@ -0,0 +1,287 @@
+#include "AllocationSites.h"
+#include "Agent.h"
+#include "Bytecode.h"
+#include "ClassFile.h"
+#include "Mappings.h"
+#include "Options.h"
+#include "Sampler.h"
+#include "StackTrie.h"
+#include "SymbolCache.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    // Assumed iterations per enclosing loop when no allocation sample reached a site.
+    constexpr uint64_t LoopWeight = 10;
+    constexpr uint32_t MaxLoopDepth = 3;
+    // Allocation samples are credited to this many innermost frames, so the site calling valueOf or
+    // a lambda factory gets them as well as the allocating frame.
+    constexpr uint32_t AttributedFrames = 3;
+
+    enum Kind : uint8_t { New, Array, Boxing, Lambda, Concat };
+    constexpr const char* KindNames[] = {"new", "array", "boxing", "lambda", "concat"};
+
+    struct Site {
+        uint32_t bci;
+        Kind kind;
+        // Allocated class, array type or functional interface.
+        std::string type;
+        uint8_t loopDepth = 0;
+    };
+
+    struct Row {
+        uint64_t samples;
+        uint64_t bytes;
+        uint64_t estimate;
+        Site site;
+        std::string location;
+    };
+
+    std::string path;
+    std::vector<std::string> packages;
+    long methodLimit = 100;
+    bool configured = false;
+
+    bool isScanned(std::string_view name) {
+        auto startsWith = [&](std::string_view prefix) { return name.substr(0, prefix.size()) == prefix; };
+        if (!packages.empty()) return std::any_of(packages.begin(), packages.end(), startsWith);
+        for (std::string_view prefix : {"java/", "javax/", "jdk/", "sun/", "com/sun/"}) {
+            if (startsWith(prefix)) return false;
+        }
+        return true;
+    }
+
+    const char* primitiveArray(uint8_t type) {
+        switch (type) {
+            case JVM_T_BOOLEAN: return "boolean[]";
+            case JVM_T_CHAR: return "char[]";
+            case JVM_T_FLOAT: return "float[]";
+            case JVM_T_DOUBLE: return "double[]";
+            case JVM_T_BYTE: return "byte[]";
+            case JVM_T_SHORT: return "short[]";
+            case JVM_T_INT: return "int[]";
+            case JVM_T_LONG: return "long[]";
+            default: return "?[]";
+        }
+    }
+
+    bool isBoxing(std::string_view owner, std::string_view name, std::string_view descriptor) {
+        // Boolean and Byte are always cached.
+        static constexpr std::string_view Boxes[] = {"java/lang/Integer", "java/lang/Long", "java/lang/Short",
+                                                     "java/lang/Character", "java/lang/Float", "java/lang/Double"};
+        return name == "valueOf" && descriptor.size() > 3 && descriptor[2] == ')' && descriptor[1] != 'L' &&
+               std::find(std::begin(Boxes), std::end(Boxes), owner) != std::end(Boxes);
+    }
+
+    // Bootstrap factories referenced from the constant pool. GetConstantPool has no BootstrapMethods
+    // attribute to tie an invokedynamic to its factory, so the pool's method handles stand in for it.
+    struct Factories {
+        bool concat = false;
+        bool lambda = false;
+        // ObjectMethods, SwitchBootstraps: their call sites are not lambdas.
+        bool runtime = false;
+    };
+
+    Factories factories(ClassFile& classFile) {
+        Factories found;
+        for (uint16_t i = 1; i < classFile.constantPoolCount(); i++) {
+            if (classFile.tag(i) != JVM_CONSTANT_MethodHandle) continue;
+            std::string_view owner, name, descriptor;
+            if (!classFile.memberRef(ClassFile::u2(classFile.constant(i) + 1), owner, name, descriptor)) continue;
+            if (owner == "java/lang/invoke/StringConcatFactory") found.concat = true;
+            else if (owner == "java/lang/invoke/LambdaMetafactory") found.lambda = true;
+            else if (owner.starts_with("java/lang/runtime/")) found.runtime = true;
+        }
+        return found;
+    }
+
+    // Allocating instructions of one method, and its loops as the [target, branch] ranges of backward branches.
+    void scan(ClassFile& classFile, const uint8_t* code, uint32_t length, std::vector<Site>& found,
+              std::vector<std::pair<uint32_t, uint32_t>>& loops) {
+        Factories bootstraps;
+        bool bootstrapsRead = false;
+        Bytecode::Iterator iterator(code, length);
+        Bytecode::Instruction instruction;
+        std::string_view owner, name, descriptor;
+        while (iterator.next(instruction)) {
+            switch (instruction.opcode) {
+                case JVM_OPC_new:
+                    found.push_back({instruction.bci, New, std::string(classFile.className(instruction.u2(1)))});
+                    break;
+                case JVM_OPC_newarray:
+                    found.push_back({instruction.bci, Array, primitiveArray(instruction.u1(1))});
+                    break;
+                case JVM_OPC_anewarray:
+                    found.push_back({instruction.bci, Array, std::string(classFile.className(instruction.u2(1))) + "[]"});
+                    break;
+                case JVM_OPC_multianewarray:
+                    found.push_back({instruction.bci, Array, std::string(classFile.className(instruction.u2(1)))});
+                    break;
+                case JVM_OPC_invokestatic:
+                    if (classFile.memberRef(instruction.u2(1), owner, name, descriptor) && isBoxing(owner, name, descriptor)) {
+                        found.push_back({instruction.bci, Boxing, std::string(owner)});
+                    }
+                    break;
+                case JVM_OPC_invokedynamic: {
+                    const uint8_t* constant = classFile.tag(instruction.u2(1)) == JVM_CONSTANT_InvokeDynamic ? classFile.constant(instruction.u2(1)) : nullptr;
+                    if (!constant || !classFile.nameAndType(ClassFile::u2(constant + 2), name, descriptor)) break;
+                    if (!bootstrapsRead) bootstraps = factories(classFile), bootstrapsRead = true;
+                    size_t result = descriptor.find(')') + 1;
+                    if (bootstraps.concat && name.starts_with("makeConcat")) {
+                        found.push_back({instruction.bci, Concat, "java/lang/String"});
+                    } else if (bootstraps.lambda && !bootstraps.runtime && descriptor.substr(0, 2) != "()" && result + 2 < descriptor.size()) {
+                        // A non-capturing lambda is one constant instance after linkage.
+                        found.push_back({instruction.bci, Lambda, std::string(descriptor.substr(result + 1, descriptor.size() - result - 2))});
+                    }
+                    break;
+                }
+                case JVM_OPC_goto:
+                case JVM_OPC_goto_w:
+                case JVM_OPC_ifnull:
+                case JVM_OPC_ifnonnull:
+                    if (instruction.branchTarget() <= static_cast<int32_t>(instruction.bci)) loops.emplace_back(instruction.branchTarget(), instruction.bci);
+                    break;
+                default:
+                    if (instruction.opcode >= JVM_OPC_ifeq && instruction.opcode <= JVM_OPC_if_acmpne &&
+                        instruction.branchTarget() <= static_cast<int32_t>(instruction.bci)) {
+                        loops.emplace_back(instruction.branchTarget(), instruction.bci);
+                    }
+                    break;
+            }
+        }
+    }
+
+    // The sites of one method from GetBytecodes, with its class's GetConstantPool wrapped in an empty
+    // class file so that ClassFile resolves the indices. False for native methods and unscanned classes.
+    bool readSites(jvmtiEnv* jvmti, JNIEnv* env, jmethodID method, std::vector<Site>& found,
+                   std::vector<std::pair<uint32_t, uint32_t>>& loops) {
+        jclass klass = nullptr;
+        if (jvmti->GetMethodDeclaringClass(method, &klass) != JVMTI_ERROR_NONE) return false;
+        bool read = false;
+        jint poolCount = 0, poolLength = 0, codeLength = 0;
+        unsigned char* pool = nullptr;
+        unsigned char* code = nullptr;
+        if (isScanned(Agent::className(jvmti, klass)) &&
+            jvmti->GetConstantPool(klass, &poolCount, &poolLength, &pool) == JVMTI_ERROR_NONE &&
+            jvmti->GetBytecodes(method, &codeLength, &code) == JVMTI_ERROR_NONE) {
+            // Magic, version and count; then no flags, names, interfaces, members or attributes.
+            std::vector<uint8_t> classData = {0xCA, 0xFE, 0xBA, 0xBE, 0, 0, 0, 0, static_cast<uint8_t>(poolCount >> 8), static_cast<uint8_t>(poolCount)};
+            classData.insert(classData.end(), pool, pool + poolLength);
+            classData.resize(classData.size() + 14);
+            thread_local ClassFile classFile;
+            if (classFile.parse(classData.data(), classData.size())) {
+                scan(classFile, code, static_cast<uint32_t>(codeLength), found, loops);
+                read = true;
+            }
+        }
+        if (pool) jvmti->Deallocate(pool);
+        if (code) jvmti->Deallocate(code);
+        if (env) env->DeleteLocalRef(klass);
+        return read;
+    }
+}
+
+bool AllocationSites::enabled() {
+    return configured;
+}
+
+void AllocationSites::configure() {
+    path = Options::get("alloc-sites");
+    if (path.empty()) return;
+    if (!Sampler::enabled() && !Sampler::allocEnabled()) {
+        std::cerr << "[Rynox] Ignoring alloc-sites without sample or alloc." << std::endl;
+        return;
+    }
+    packages = Options::getAll("alloc-sites-package");
+    methodLimit = std::max(Options::getLong("alloc-sites-methods", methodLimit), 1L);
+    configured = true;
+}
+
+void AllocationSites::write(jvmtiEnv* jvmti) {
+    if (!enabled()) return;
+
+    // Inclusive CPU samples per method, and allocation samples and bytes per (method, bci).
+    std::unordered_map<jmethodID, uint64_t> cpuSamples;
+    std::unordered_map<jmethodID, uint64_t> allocSamples;
+    std::map<std::pair<jmethodID, jlocation>, std::pair<uint64_t, uint64_t>> siteSamples;
+    std::vector<jmethodID> seen;
+    StackTrie::forEachSampled([&](StackTrie::NodeId id, const StackTrie::Node& leaf) {
+        uint64_t cpu = StackTrie::count(id, StackTrie::CpuSamples);
+        uint64_t allocs = StackTrie::count(id, StackTrie::AllocSamples);
+        uint64_t bytes = StackTrie::count(id, StackTrie::AllocBytes);
+        seen.clear();
+        StackTrie::Node frame = leaf;
+        for (uint32_t depth = 0;; depth++) {
+            // Recursion counts once per stack.
+            if (std::find(seen.begin(), seen.end(), frame.method) == seen.end()) {
+                seen.push_back(frame.method);
+                cpuSamples[frame.method] += cpu;
+                allocSamples[frame.method] += allocs;
+            }
+            if (allocs && depth < AttributedFrames) {
+                auto& [samples, total] = siteSamples[{frame.method, frame.location}];
+                samples += allocs;
+                total += bytes;
+            }
+            if (frame.parent == StackTrie::Root || !StackTrie::node(frame.parent, frame)) break;
+        }
+    });
+
+    // Hot by CPU when the stack sampler runs, otherwise by allocation samples.
+    const auto& heat = Sampler::enabled() ? cpuSamples : allocSamples;
+    std::vector<std::pair<jmethodID, uint64_t>> hot(heat.begin(), heat.end());
+    std::erase_if(hot, [](const auto& method) { return method.second == 0; });
+    std::sort(hot.begin(), hot.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    if (hot.size() > static_cast<size_t>(methodLimit)) hot.resize(static_cast<size_t>(methodLimit));
+
+    // Only the hot methods are read back, as the running class has them; nothing is kept from class loading.
+    JNIEnv* env = nullptr;
+    Agent::jvm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_8);
+    std::vector<Row> rows;
+    std::vector<Site> found;
+    std::vector<std::pair<uint32_t, uint32_t>> loops;
+    size_t scanned = 0;
+    for (const auto& [method, samples] : hot) {
+        const SymbolCache::Symbol* symbol = SymbolCache::find(method);
+        if (!symbol) continue;
+        found.clear();
+        loops.clear();
+        if (!readSites(jvmti, env, method, found, loops)) continue;
+        scanned++;
+        for (Site& site : found) {
+            auto depth = std::count_if(loops.begin(), loops.end(), [&](const auto& loop) { return loop.first <= site.bci && site.bci <= loop.second; });
+            site.loopDepth = static_cast<uint8_t>(std::min<long>(depth, UINT8_MAX));
+            uint64_t estimate = samples;
+            for (uint32_t i = 0; i < std::min<uint32_t>(site.loopDepth, MaxLoopDepth); i++) estimate *= LoopWeight;
+            auto measured = siteSamples.find({method, static_cast<jlocation>(site.bci)});
+            auto [allocs, bytes] = measured != siteSamples.end() ? measured->second : std::pair<uint64_t, uint64_t>();
+            std::string location = SymbolCache::describe(symbol, site.bci);
+            rows.push_back({allocs, bytes, estimate, std::move(site), std::move(location)});
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.samples != b.samples ? a.samples > b.samples : a.estimate > b.estimate;
+    });
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[Rynox] Failed to write allocation sites to " << path << "." << std::endl;
+        return;
+    }
+    out << "# Rynox allocation sites (" << hot.size() << " hot methods, " << scanned << " methods scanned)\n";
+    out << "## Sites (alloc samples, est. MB, static estimate, loop depth, kind, type, site)\n";
+    out << std::fixed << std::setprecision(3);
+    for (const Row& row : rows) {
+        std::string type;
+        if (!Mappings::enabled() || !Mappings::deobfuscateClass(row.site.type, type)) type = row.site.type;
+        out << row.samples << "\t" << static_cast<double>(row.bytes) / 1e6 << "\t" << row.estimate << "\t"
+            << static_cast<uint32_t>(row.site.loopDepth) << "\t" << KindNames[row.site.kind] << "\t" << type << "\t"
+            << row.location << "\n";
+    }
+}
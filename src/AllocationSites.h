@@ -0,0 +1,22 @@
+#ifndef ALLOCATION_SITES_H
+#define ALLOCATION_SITES_H
+
+#include <jvmti.h>
+
+// Allocation sites in the hottest sampled methods, ranked and written to "alloc-sites=<path>" at
+// shutdown. The "alloc-sites-methods" (100) methods with the most inclusive CPU samples are taken
+// from the StackTrie, and the bytecode of each (all but the JDK's, or only classes under the
+// "alloc-sites-package=<prefix>" options) is read back through GetBytecodes and GetConstantPool and
+// scanned for what allocates: new, the array instructions, boxing valueOf calls, capturing lambdas
+// and string concatenation through invokedynamic, each with its loop depth from the backward
+// branches around it. Nothing is parsed or kept while classes load. Sites are ranked by the
+// allocation samples caught at that exact bytecode ("alloc" on) and otherwise by the method's
+// samples scaled by LoopWeight per enclosing loop. Needs the sampler ("sample" or "alloc").
+namespace AllocationSites {
+    bool enabled();
+    void configure();
+
+    void write(jvmtiEnv* jvmti);
+}
+
+#endif //ALLOCATION_SITES_H
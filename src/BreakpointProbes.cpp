@@ -0,0 +1,196 @@
+#include "BreakpointProbes.h"
+#include "Agent.h"
+#include "Mappings.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace {
+    struct Probe {
+        // As given, for the events and messages.
+        std::string name;
+        std::string className;
+        std::string methodName;
+        std::string methodSignature;
+        // 0 for the method entry.
+        long line = 0;
+        uint64_t nameId = 0;
+        std::atomic<jmethodID> method = nullptr;
+        std::atomic<jlocation> location = -1;
+        std::atomic<bool> disabled = false;
+        std::atomic<uint64_t> window = 0;
+        std::atomic<uint64_t> windowHits = 0;
+        std::atomic<uint64_t> hits = 0;
+    };
+
+    // Probes armed at one location. Several targets can resolve to the same bytecode, and only the last
+    // one disabled clears the breakpoint; one set before any probe (a frame method's) is never cleared.
+    struct Owners {
+        uint32_t armed = 0;
+        bool foreign = false;
+    };
+
+    std::deque<Probe> probes;
+    uint64_t budget = 50;
+    bool active = false;
+    std::mutex ownersLock;
+    std::map<std::pair<jmethodID, jlocation>, Owners> owners;
+
+    void addTarget(const std::string& target) {
+        size_t colon = target.rfind(':');
+        std::string method = colon == std::string::npos ? target : target.substr(0, colon);
+        long line = 0;
+        if (colon != std::string::npos) {
+            try {
+                line = std::stol(target.substr(colon + 1));
+            } catch (const std::exception&) {
+                line = -1;
+            }
+        }
+        size_t dot = method.rfind('.');
+        if (dot == std::string::npos || dot == 0 || dot + 1 == method.size() || line < 0) {
+            std::cerr << "[Rynox] Ignoring breakpoint \"" << target << "\", expected <class>.<method>[:<line>]." << std::endl;
+            return;
+        }
+        Probe& probe = probes.emplace_back();
+        probe.name = target;
+        probe.className = method.substr(0, dot);
+        probe.methodName = method.substr(dot + 1);
+        probe.line = line;
+
+        Mappings::Method obfuscated;
+        if (Mappings::enabled() && Mappings::obfuscateMethod(probe.className, probe.methodName, {}, obfuscated)) {
+            probe.className = std::move(obfuscated.owner);
+            probe.methodName = std::move(obfuscated.name);
+            probe.methodSignature = std::move(obfuscated.descriptor);
+        }
+    }
+
+    // The first bytecode of the line, or the entry.
+    jlocation locate(jvmtiEnv* jvmti, jmethodID method, long line) {
+        if (line == 0) return 0;
+        jint count = 0;
+        jvmtiLineNumberEntry* table = nullptr;
+        if (jvmti->GetLineNumberTable(method, &count, &table) != JVMTI_ERROR_NONE) return -1;
+        jlocation location = -1;
+        for (jint i = 0; i < count; i++) {
+            if (table[i].line_number == line && (location < 0 || table[i].start_location < location)) location = table[i].start_location;
+        }
+        jvmti->Deallocate(reinterpret_cast<unsigned char*>(table));
+        return location;
+    }
+
+    void arm(jvmtiEnv* jvmti, jclass klass, Probe& probe) {
+        jint count = 0;
+        jmethodID* methods = nullptr;
+        if (jvmti->GetClassMethods(klass, &count, &methods) != JVMTI_ERROR_NONE) return;
+
+        for (jint i = 0; i < count; i++) {
+            char* name = nullptr;
+            char* signature = nullptr;
+            if (jvmti->GetMethodName(methods[i], &name, &signature, nullptr) != JVMTI_ERROR_NONE || !name) continue;
+            bool match = probe.methodName == name && (probe.methodSignature.empty() || probe.methodSignature == signature);
+            jvmti->Deallocate(reinterpret_cast<unsigned char*>(name));
+            jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+            if (!match) continue;
+
+            // The first overload with the line wins.
+            jlocation location = locate(jvmti, methods[i], probe.line);
+            if (location < 0) continue;
+            jvmtiError error = jvmti->SetBreakpoint(methods[i], location);
+            if (error != JVMTI_ERROR_NONE && error != JVMTI_ERROR_DUPLICATE) {
+                std::cerr << "[Rynox] Failed to set breakpoint " << probe.name << " (JVMTI error " << error << ")." << std::endl;
+                break;
+            }
+            {
+                std::lock_guard guard(ownersLock);
+                auto [it, first] = owners.try_emplace({methods[i], location});
+                if (first) it->second.foreign = error == JVMTI_ERROR_DUPLICATE;
+                it->second.armed++;
+            }
+            probe.nameId = Trace::string(probe.name);
+            probe.location.store(location, std::memory_order_relaxed);
+            probe.method.store(methods[i], std::memory_order_release);
+            break;
+        }
+        jvmti->Deallocate(reinterpret_cast<unsigned char*>(methods));
+        if (!probe.method.load() && probe.line) std::cerr << "[Rynox] No line " << probe.line << " for breakpoint " << probe.name << "." << std::endl;
+    }
+
+    void disable(jvmtiEnv* jvmti, Probe& probe, jmethodID method, jlocation location) {
+        if (probe.disabled.exchange(true)) return;
+        {
+            std::lock_guard guard(ownersLock);
+            Owners& at = owners[{method, location}];
+            if (at.armed > 0 && --at.armed == 0 && !at.foreign) jvmti->ClearBreakpoint(method, location);
+        }
+        std::cerr << "[Rynox] Cleared breakpoint " << probe.name << " after " << probe.hits.load() << " hits, over the budget of "
+                  << budget << " per second." << std::endl;
+    }
+}
+
+bool BreakpointProbes::enabled() {
+    return active;
+}
+
+void BreakpointProbes::configure() {
+    if (!Trace::enabled()) return;
+    for (const auto& target : Options::getAll("breakpoint")) addTarget(target);
+    budget = static_cast<uint64_t>(std::max(1L, Options::getLong("breakpoint-budget", 50)));
+    active = !probes.empty();
+}
+
+void BreakpointProbes::start(jvmtiEnv* jvmti) {
+    jvmtiPhase phase;
+    if (!active || jvmti->GetPhase(&phase) != JVMTI_ERROR_NONE || phase != JVMTI_PHASE_LIVE) return;
+
+    jint count = 0;
+    jclass* classes = nullptr;
+    if (jvmti->GetLoadedClasses(&count, &classes) != JVMTI_ERROR_NONE) return;
+    for (jint i = 0; i < count; i++) {
+        jint status = 0;
+        jvmti->GetClassStatus(classes[i], &status);
+        if (status & JVMTI_CLASS_STATUS_PREPARED) onClassPrepare(jvmti, classes[i], Agent::className(jvmti, classes[i]));
+    }
+    JNIEnv* env = nullptr;
+    if (Agent::jvm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_8) == JNI_OK && env) {
+        for (jint i = 0; i < count; i++) env->DeleteLocalRef(classes[i]);
+    }
+    jvmti->Deallocate(reinterpret_cast<unsigned char*>(classes));
+}
+
+void BreakpointProbes::onClassPrepare(jvmtiEnv* jvmti, jclass klass, std::string_view className) {
+    if (!active) return;
+    for (auto& probe : probes) {
+        if (probe.className == className && !probe.method.load()) arm(jvmti, klass, probe);
+    }
+}
+
+void BreakpointProbes::onBreakpoint(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location) {
+    if (!active) return;
+    for (auto& probe : probes) {
+        if (probe.method.load(std::memory_order_acquire) != method || probe.location.load(std::memory_order_relaxed) != location) continue;
+        if (probe.disabled.load(std::memory_order_relaxed)) continue;
+        uint64_t now = Platform::nanoTime();
+        probe.hits.fetch_add(1, std::memory_order_relaxed);
+
+        // One-second windows; a racing reset only loses a few hits of the count.
+        uint64_t second = now / 1000000000;
+        uint64_t window = probe.window.load(std::memory_order_relaxed);
+        if (window != second && probe.window.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+            probe.windowHits.store(0, std::memory_order_relaxed);
+        }
+        if (probe.windowHits.fetch_add(1, std::memory_order_relaxed) >= budget) {
+            disable(jvmti, probe, method, location);
+            continue;
+        }
+        Trace::breakpointHit(now, Trace::threadId(jvmti, env, thread), probe.nameId, static_cast<uint64_t>(location));
+    }
+}
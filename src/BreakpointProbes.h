@@ -0,0 +1,23 @@
+#ifndef BREAKPOINT_PROBES_H
+#define BREAKPOINT_PROBES_H
+
+#include <jvmti.h>
+#include <string_view>
+
+// Probes on rare events (world join, resource reload) from JVMTI breakpoints, without redefining
+// classes: "breakpoint=<class>.<method>[:<line>]" stops at the method entry or at the first bytecode
+// of a source line, and each hit is emitted as a BreakpointHit event with the thread and the probe's
+// name. The method stays interpreted while armed, so a probe that fires more than
+// "breakpoint-budget" (50) times within a second is cleared for good. Active when tracing; with
+// "mappings" the targets are translated like the frame methods.
+namespace BreakpointProbes {
+    bool enabled();
+    void configure();
+
+    // Arms breakpoints in classes that were loaded before the agent (attach mode).
+    void start(jvmtiEnv* jvmti);
+    void onClassPrepare(jvmtiEnv* jvmti, jclass klass, std::string_view className);
+    void onBreakpoint(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location);
+}
+
+#endif //BREAKPOINT_PROBES_H
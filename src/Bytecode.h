@@ -0,0 +1,90 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <classfile_constants.h>
+#include <cstdint>
+
+// Instruction decoding over a Code attribute's bytes, driven by the JDK's opcode length table.
+// tableswitch and lookupswitch (variable length, 4-byte aligned) and wide are handled explicitly.
+namespace Bytecode {
+    inline constexpr unsigned char Lengths[JVM_OPC_MAX + 1] = JVM_OPCODE_LENGTH_INITIALIZER;
+
+    struct Instruction {
+        uint32_t bci;
+        uint8_t opcode;
+        // Set for an instruction prefixed by wide; opcode is then the modified instruction.
+        bool wide;
+        uint32_t length;
+        const uint8_t* bytes;
+
+        uint8_t u1(uint32_t offset) const { return bytes[offset]; }
+        uint16_t u2(uint32_t offset) const { return static_cast<uint16_t>(bytes[offset] << 8 | bytes[offset + 1]); }
+        int16_t s2(uint32_t offset) const { return static_cast<int16_t>(u2(offset)); }
+        int32_t s4(uint32_t offset) const {
+            return static_cast<int32_t>(static_cast<uint32_t>(bytes[offset]) << 24 | static_cast<uint32_t>(bytes[offset + 1]) << 16 |
+                                        static_cast<uint32_t>(bytes[offset + 2]) << 8 | bytes[offset + 3]);
+        }
+        // Local variable index of load/store/iinc/ret, honouring wide.
+        uint16_t localIndex() const { return wide ? u2(2) : u1(1); }
+        // Branch target of if*/goto/jsr (and their _w forms).
+        int32_t branchTarget() const {
+            return static_cast<int32_t>(bci) + (opcode == JVM_OPC_goto_w || opcode == JVM_OPC_jsr_w ? s4(1) : s2(1));
+        }
+    };
+
+    // Length of the instruction at bci, or 0 when it is malformed or runs past the end.
+    inline uint32_t lengthAt(const uint8_t* code, uint32_t codeLength, uint32_t bci) {
+        if (bci >= codeLength) return 0;
+        uint8_t opcode = code[bci];
+        if (opcode > JVM_OPC_MAX) return 0;
+        uint32_t length = Lengths[opcode];
+
+        if (opcode == JVM_OPC_wide) {
+            if (bci + 1 >= codeLength) return 0;
+            length = code[bci + 1] == JVM_OPC_iinc ? 6 : 4;
+        } else if (opcode == JVM_OPC_tableswitch || opcode == JVM_OPC_lookupswitch) {
+            uint32_t operands = (bci + 4) & ~3u;
+            uint32_t fixed = opcode == JVM_OPC_tableswitch ? 12 : 8;
+            if (operands + fixed > codeLength) return 0;
+            auto s4 = [code](uint32_t at) {
+                return static_cast<int32_t>(static_cast<uint32_t>(code[at]) << 24 | static_cast<uint32_t>(code[at + 1]) << 16 |
+                                            static_cast<uint32_t>(code[at + 2]) << 8 | code[at + 3]);
+            };
+            int64_t entries = opcode == JVM_OPC_tableswitch ? static_cast<int64_t>(s4(operands + 8)) - s4(operands + 4) + 1 : s4(operands + 4);
+            int64_t entrySize = opcode == JVM_OPC_tableswitch ? 4 : 8;
+            if (entries < 0 || entries > codeLength) return 0;
+            length = operands + fixed + static_cast<uint32_t>(entries * entrySize) - bci;
+        }
+        return length && bci + length <= codeLength ? length : 0;
+    }
+
+    class Iterator {
+    public:
+        Iterator(const uint8_t* code, uint32_t length) : code(code), codeLength(length) {}
+
+        bool next(Instruction& out) {
+            if (position >= codeLength) return false;
+            uint32_t length = lengthAt(code, codeLength, position);
+            if (length == 0) {
+                malformed = true;
+                position = codeLength;
+                return false;
+            }
+            bool wide = code[position] == JVM_OPC_wide;
+            out = {position, wide ? code[position + 1] : code[position], wide, length, code + position};
+            position += length;
+            return true;
+        }
+
+        // True when iteration stopped at an undecodable instruction rather than the end of the code.
+        bool failed() const { return malformed; }
+
+    private:
+        const uint8_t* code;
+        uint32_t codeLength;
+        uint32_t position = 0;
+        bool malformed = false;
+    };
+}
+
+#endif //BYTECODE_H
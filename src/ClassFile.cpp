@@ -0,0 +1,189 @@
+#include "ClassFile.h"
+
+bool ClassFile::parse(const uint8_t* data, size_t size) {
+    bytes = data;
+    length = size;
+    indexed = false;
+    malformed = size < 10 || u4(data) != 0xCAFEBABE;
+    constants.clear();
+    classInfoStart = fieldsStart = methodsStart = classAttributesStart = 0;
+    return !malformed;
+}
+
+bool ClassFile::index() {
+    if (indexed || malformed) return indexed;
+
+    uint16_t count = u2(bytes + 8);
+    constants.assign(count, 0);
+    uint32_t offset = 10;
+    for (uint16_t i = 1; i < count; i++) {
+        if (offset >= length) return malformed = true, false;
+        constants[i] = offset;
+        uint8_t constantTag = bytes[offset];
+        uint32_t size;
+        switch (constantTag) {
+            case JVM_CONSTANT_Utf8:
+                if (offset + 3 > length) return malformed = true, false;
+                size = 3 + u2(bytes + offset + 1);
+                break;
+            case JVM_CONSTANT_Integer:
+            case JVM_CONSTANT_Float:
+            case JVM_CONSTANT_Fieldref:
+            case JVM_CONSTANT_Methodref:
+            case JVM_CONSTANT_InterfaceMethodref:
+            case JVM_CONSTANT_NameAndType:
+            case JVM_CONSTANT_Dynamic:
+            case JVM_CONSTANT_InvokeDynamic:
+                size = 5;
+                break;
+            case JVM_CONSTANT_Long:
+            case JVM_CONSTANT_Double:
+                // Takes two slots; the second one is unusable.
+                size = 9;
+                i++;
+                break;
+            case JVM_CONSTANT_Class:
+            case JVM_CONSTANT_String:
+            case JVM_CONSTANT_MethodType:
+            case JVM_CONSTANT_Module:
+            case JVM_CONSTANT_Package:
+                size = 3;
+                break;
+            case JVM_CONSTANT_MethodHandle:
+                size = 4;
+                break;
+            default:
+                return malformed = true, false;
+        }
+        offset += size;
+    }
+
+    // access_flags, this_class, super_class, interfaces_count, then the interfaces.
+    classInfoStart = offset;
+    if (offset + 8 > length) return malformed = true, false;
+    offset += 8 + 2u * u2(bytes + offset + 6);
+    fieldsStart = offset;
+    if (!skipMembers(offset)) return malformed = true, false;
+    methodsStart = offset;
+    if (!skipMembers(offset)) return malformed = true, false;
+    classAttributesStart = offset;
+    if (offset + 2 > length) return malformed = true, false;
+    return indexed = true;
+}
+
+bool ClassFile::skipMembers(uint32_t& offset) {
+    if (offset + 2 > length) return false;
+    uint16_t count = u2(bytes + offset);
+    offset += 2;
+    for (uint16_t i = 0; i < count; i++) {
+        if (offset + 8 > length) return false;
+        uint16_t attributes = u2(bytes + offset + 6);
+        offset += 8;
+        for (uint16_t a = 0; a < attributes; a++) {
+            if (offset + 6 > length) return false;
+            uint32_t size = u4(bytes + offset + 2);
+            if (size > length - offset - 6) return false;
+            offset += 6 + size;
+        }
+    }
+    return true;
+}
+
+uint16_t ClassFile::constantPoolCount() {
+    return index() ? static_cast<uint16_t>(constants.size()) : 0;
+}
+
+uint8_t ClassFile::tag(uint16_t index) {
+    if (!this->index() || index >= constants.size() || constants[index] == 0) return 0;
+    return bytes[constants[index]];
+}
+
+const uint8_t* ClassFile::constant(uint16_t index) {
+    if (!this->index() || index >= constants.size() || constants[index] == 0) return nullptr;
+    return bytes + constants[index] + 1;
+}
+
+std::string_view ClassFile::utf8(uint16_t index) {
+    if (tag(index) != JVM_CONSTANT_Utf8) return {};
+    const uint8_t* entry = constant(index);
+    return {reinterpret_cast<const char*>(entry + 2), u2(entry)};
+}
+
+std::string_view ClassFile::className(uint16_t index) {
+    if (tag(index) != JVM_CONSTANT_Class) return {};
+    return utf8(u2(constant(index)));
+}
+
+bool ClassFile::nameAndType(uint16_t index, std::string_view& name, std::string_view& descriptor) {
+    if (tag(index) != JVM_CONSTANT_NameAndType) return false;
+    const uint8_t* entry = constant(index);
+    name = utf8(u2(entry));
+    descriptor = utf8(u2(entry + 2));
+    return !name.empty() && !descriptor.empty();
+}
+
+bool ClassFile::memberRef(uint16_t index, std::string_view& owner, std::string_view& name, std::string_view& descriptor) {
+    uint8_t constantTag = tag(index);
+    if (constantTag != JVM_CONSTANT_Fieldref && constantTag != JVM_CONSTANT_Methodref && constantTag != JVM_CONSTANT_InterfaceMethodref) return false;
+    const uint8_t* entry = constant(index);
+    owner = className(u2(entry));
+    return !owner.empty() && nameAndType(u2(entry + 2), name, descriptor);
+}
+
+uint16_t ClassFile::accessFlags() {
+    return index() ? u2(bytes + classInfoStart) : 0;
+}
+
+std::string_view ClassFile::thisClass() {
+    return index() ? className(u2(bytes + classInfoStart + 2)) : std::string_view();
+}
+
+std::string_view ClassFile::superClass() {
+    return index() ? className(u2(bytes + classInfoStart + 4)) : std::string_view();
+}
+
+uint16_t ClassFile::interfaceCount() {
+    return index() ? u2(bytes + classInfoStart + 6) : 0;
+}
+
+std::string_view ClassFile::interfaceAt(uint16_t position) {
+    if (position >= interfaceCount()) return {};
+    return className(u2(bytes + classInfoStart + 8 + 2u * position));
+}
+
+uint16_t ClassFile::fieldCount() {
+    return index() ? u2(bytes + fieldsStart) : 0;
+}
+
+uint16_t ClassFile::methodCount() {
+    return index() ? u2(bytes + methodsStart) : 0;
+}
+
+bool ClassFile::findAttribute(uint32_t table, std::string_view name, Attribute& out) {
+    bool found = false;
+    forEachAttribute(table, [&](const Attribute& attribute) {
+        if (attribute.name != name) return true;
+        out = attribute;
+        found = true;
+        return false;
+    });
+    return found;
+}
+
+bool ClassFile::code(const Member& method, Code& out) {
+    Attribute attribute{};
+    if (!findAttribute(method.attributes, "Code", attribute) || attribute.length < 12) return false;
+    const uint8_t* p = attribute.data;
+    out.maxStack = u2(p);
+    out.maxLocals = u2(p + 2);
+    out.length = u4(p + 4);
+    if (out.length > attribute.length - 12) return false;
+    out.code = p + 8;
+    const uint8_t* table = out.code + out.length;
+    out.exceptionCount = u2(table);
+    out.exceptionTable = table + 2;
+    uint32_t tableSize = 8u * out.exceptionCount;
+    if (8 + out.length + 2 + tableSize + 2 > attribute.length) return false;
+    out.attributes = static_cast<uint32_t>(out.exceptionTable + tableSize - bytes);
+    return true;
+}
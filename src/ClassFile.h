@@ -0,0 +1,142 @@
+#ifndef CLASS_FILE_H
+#define CLASS_FILE_H
+
+#include <classfile_constants.h>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Zero-copy view over class file bytes (JVMS 4), such as the buffer of a ClassFileLoadHook. Strings
+// are views into that buffer (modified UTF-8, identical to ASCII for ordinary names), so it must
+// outlive the view. The constant pool and the member tables are indexed on first use into storage
+// that parse() keeps, so a reused (e.g. thread_local) instance does not allocate in steady state.
+// Every accessor is bounds-checked and fails soft on malformed input: empty views, zero, or false.
+class ClassFile {
+public:
+    struct Attribute {
+        std::string_view name;
+        const uint8_t* data;
+        uint32_t length;
+    };
+
+    struct Member {
+        uint16_t accessFlags;
+        std::string_view name;
+        std::string_view descriptor;
+        // Position of the member's attribute table, for forEachAttribute and findAttribute.
+        uint32_t attributes;
+        // Byte range of the whole member_info structure.
+        uint32_t start;
+        uint32_t end;
+    };
+
+    struct Code {
+        uint16_t maxStack;
+        uint16_t maxLocals;
+        const uint8_t* code;
+        uint32_t length;
+        // exceptionCount entries of start_pc, end_pc, handler_pc, catch_type (u2 each).
+        const uint8_t* exceptionTable;
+        uint16_t exceptionCount;
+        uint32_t attributes;
+    };
+
+    static uint16_t u2(const uint8_t* p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+    static uint32_t u4(const uint8_t* p) { return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | p[2] << 8 | p[3]; }
+
+    // Checks the magic and version and resets the index; the bytes are not scanned yet.
+    bool parse(const uint8_t* data, size_t size);
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+    uint16_t minorVersion() const { return length >= 8 ? u2(bytes + 4) : 0; }
+    uint16_t majorVersion() const { return length >= 8 ? u2(bytes + 6) : 0; }
+
+    // Constant pool, 1-based; index 0 and the upper half of Long/Double entries read as invalid.
+    uint16_t constantPoolCount();
+    uint8_t tag(uint16_t index);
+    // Bytes after the tag byte, or nullptr.
+    const uint8_t* constant(uint16_t index);
+    std::string_view utf8(uint16_t index);
+    // Name of a CONSTANT_Class entry.
+    std::string_view className(uint16_t index);
+    bool nameAndType(uint16_t index, std::string_view& name, std::string_view& descriptor);
+    // Fieldref, Methodref and InterfaceMethodref entries.
+    bool memberRef(uint16_t index, std::string_view& owner, std::string_view& name, std::string_view& descriptor);
+
+    // Position of access_flags, right after the constant pool.
+    uint32_t classInfo() { return index() ? classInfoStart : 0; }
+    uint16_t accessFlags();
+    std::string_view thisClass();
+    std::string_view superClass();
+    uint16_t interfaceCount();
+    std::string_view interfaceAt(uint16_t position);
+    uint16_t fieldCount();
+    uint16_t methodCount();
+
+    // fn(const Member&) for each field or method in declaration order; stops early when fn returns false.
+    template <typename Fn>
+    bool forEachField(Fn&& fn) { return index() && forEachMember(fieldsStart, std::forward<Fn>(fn)); }
+    template <typename Fn>
+    bool forEachMethod(Fn&& fn) { return index() && forEachMember(methodsStart, std::forward<Fn>(fn)); }
+
+    // fn(const Attribute&) over an attribute table: Member::attributes, Code::attributes or classAttributes().
+    template <typename Fn>
+    bool forEachAttribute(uint32_t table, Fn&& fn);
+    uint32_t classAttributes() { return index() ? classAttributesStart : 0; }
+    // Position of the methods_count that starts the method table.
+    uint32_t methodTable() { return index() ? methodsStart : 0; }
+    bool findAttribute(uint32_t table, std::string_view name, Attribute& out);
+    // Decodes the Code attribute of a method; false for abstract and native methods.
+    bool code(const Member& method, Code& out);
+
+private:
+    bool index();
+    bool skipMembers(uint32_t& offset);
+    template <typename Fn>
+    bool forEachMember(uint32_t offset, Fn&& fn);
+
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool indexed = false;
+    bool malformed = false;
+    // Offset of each constant's tag byte; 0 for unusable slots.
+    std::vector<uint32_t> constants;
+    uint32_t classInfoStart = 0;
+    uint32_t fieldsStart = 0;
+    uint32_t methodsStart = 0;
+    uint32_t classAttributesStart = 0;
+};
+
+template <typename Fn>
+bool ClassFile::forEachAttribute(uint32_t table, Fn&& fn) {
+    if (!index() || table == 0 || table + 2 > length) return false;
+    uint16_t count = u2(bytes + table);
+    uint32_t offset = table + 2;
+    for (uint16_t i = 0; i < count; i++) {
+        if (offset + 6 > length) return false;
+        uint32_t size = u4(bytes + offset + 2);
+        if (size > length - offset - 6) return false;
+        Attribute attribute{utf8(u2(bytes + offset)), bytes + offset + 6, size};
+        if (!fn(static_cast<const Attribute&>(attribute))) return true;
+        offset += 6 + size;
+    }
+    return true;
+}
+
+template <typename Fn>
+bool ClassFile::forEachMember(uint32_t offset, Fn&& fn) {
+    uint16_t count = u2(bytes + offset);
+    offset += 2;
+    for (uint16_t i = 0; i < count; i++) {
+        // Bounds were checked when the tables were indexed.
+        uint32_t end = offset + 8;
+        for (uint16_t a = u2(bytes + offset + 6); a > 0; a--) end += 6 + u4(bytes + end + 2);
+        Member member{u2(bytes + offset), utf8(u2(bytes + offset + 2)), utf8(u2(bytes + offset + 4)), offset + 6, offset, end};
+        if (!fn(static_cast<const Member&>(member))) return true;
+        offset = end;
+    }
+    return true;
+}
+
+#endif //CLASS_FILE_H
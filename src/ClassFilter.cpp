@@ -0,0 +1,86 @@
+#include "ClassFilter.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+        return value;
+    }
+}
+
+uint64_t ClassFilter::hash(const void* data, size_t length, uint64_t seed) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    uint64_t value = seed ^ (length * 0x9e3779b97f4a7c15ull);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        value = (value ^ mix(word)) * 0x9e3779b97f4a7c15ull;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes + i, length - i);
+    return mix(value ^ tail);
+}
+
+ClassFilter::ClassFilter(std::vector<std::string> names) : keys(std::move(names)) {
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    if (keys.empty()) return;
+
+    // At most half the slots are used, so most buckets settle on their first displacements.
+    size_t slotCount = 2;
+    while (slotCount < keys.size() * 2) slotCount <<= 1;
+    mask = slotCount - 1;
+    slots.assign(slotCount, -1);
+    slotHashes.assign(slotCount, 0);
+    displacements.assign(keys.size(), 0);
+
+    std::vector<std::vector<int32_t>> buckets(displacements.size());
+    std::vector<uint64_t> hashes(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        hashes[i] = hash(keys[i].data(), keys[i].size());
+        buckets[(hashes[i] >> 32) % buckets.size()].push_back(static_cast<int32_t>(i));
+    }
+    std::vector<size_t> order(buckets.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    std::vector<size_t> candidate;
+    for (size_t bucket : order) {
+        if (buckets[bucket].empty()) break;
+        for (uint32_t displacement = 0;; displacement++) {
+            candidate.clear();
+            for (int32_t key : buckets[bucket]) {
+                size_t slot = mix(hashes[key] ^ (displacement * 0x9e3779b97f4a7c15ull)) & mask;
+                if (slots[slot] >= 0 || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) break;
+                candidate.push_back(slot);
+            }
+            if (candidate.size() != buckets[bucket].size()) continue;
+            for (size_t i = 0; i < candidate.size(); i++) {
+                int32_t key = buckets[bucket][i];
+                slots[candidate[i]] = key;
+                slotHashes[candidate[i]] = hashes[key];
+            }
+            displacements[bucket] = displacement;
+            break;
+        }
+    }
+}
+
+size_t ClassFilter::slotOf(uint64_t hash) const {
+    uint32_t displacement = displacements[(hash >> 32) % displacements.size()];
+    return mix(hash ^ (displacement * 0x9e3779b97f4a7c15ull)) & mask;
+}
+
+int32_t ClassFilter::find(std::string_view name) const {
+    if (keys.empty()) return -1;
+    uint64_t nameHash = hash(name.data(), name.size());
+    size_t slot = slotOf(nameHash);
+    if (slotHashes[slot] != nameHash || slots[slot] < 0 || keys[slots[slot]] != name) return -1;
+    return slots[slot];
+}
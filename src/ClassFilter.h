@@ -0,0 +1,35 @@
+#ifndef CLASS_FILTER_H
+#define CLASS_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable set of class names behind a hash-and-displace perfect hash: one hash of the name, one
+// displacement lookup and one slot compare, so the ClassFileLoadHook turns away the thousands of
+// classes that are not targets without locks or allocation. Rebuilt whenever the targets change.
+class ClassFilter {
+public:
+    explicit ClassFilter(std::vector<std::string> names);
+
+    // Index of the name in names(), or -1.
+    int32_t find(std::string_view name) const;
+    bool contains(std::string_view name) const { return find(name) >= 0; }
+    const std::vector<std::string>& names() const { return keys; }
+
+    // 64-bit hash shared with the transform cache; not for anything adversarial.
+    static uint64_t hash(const void* data, size_t length, uint64_t seed = 0);
+
+private:
+    size_t slotOf(uint64_t hash) const;
+
+    std::vector<std::string> keys;
+    std::vector<uint32_t> displacements;
+    std::vector<int32_t> slots;
+    std::vector<uint64_t> slotHashes;
+    size_t mask = 0;
+};
+
+#endif //CLASS_FILTER_H
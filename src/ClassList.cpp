@@ -0,0 +1,71 @@
+#include "ClassList.h"
+#include "Agent.h"
+#include "Milestones.h"
+#include "Options.h"
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    std::string listPath;
+    std::string milestone;
+    std::atomic_bool recording = false;
+    std::atomic_bool written = false;
+
+    std::mutex lock;
+    std::vector<std::string> builtinClasses;
+    std::unordered_set<std::string> seen;
+    size_t customClasses = 0;
+}
+
+bool ClassList::enabled() {
+    return !listPath.empty();
+}
+
+void ClassList::configure() {
+    listPath = Options::get("classlist");
+    if (!enabled()) return;
+
+    milestone = Options::get("classlist-until", Milestones::FirstFrame);
+    recording = true;
+    Milestones::onReached(milestone, [](const Milestones::Milestone&) {
+        recording = false;
+        std::thread(&ClassList::write).detach();
+    });
+}
+
+void ClassList::onClassLoad(std::string_view name, const std::string& loaderName) {
+    if (!recording.load(std::memory_order_relaxed) || Agent::isGeneratedClass(name)) return;
+
+    std::lock_guard guard(lock);
+    if (!Agent::isBuiltinLoader(loaderName)) {
+        customClasses++;
+        return;
+    }
+    if (seen.emplace(name).second) builtinClasses.emplace_back(name);
+}
+
+void ClassList::write() {
+    if (!enabled() || written.exchange(true)) return;
+    recording = false;
+
+    std::lock_guard guard(lock);
+    std::ofstream out(listPath, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[Rynox] Failed to write class list to " << listPath << "." << std::endl;
+        return;
+    }
+
+    bool complete = Milestones::reached(milestone);
+    out << "# NOTE: generated by Rynox, classes loaded until " << milestone << (complete ? "" : " (not reached)") << "\n";
+    out << "# Dump with -Xshare:dump -XX:SharedClassListFile=<this file> -XX:SharedArchiveFile=<archive>\n";
+    if (!Agent::earlyStart) out << "# Agent attached late, classes loaded before attach are missing\n";
+    for (const auto& name : builtinClasses) out << name << "\n";
+    out << "# " << customClasses << " classes of custom loaders not listed\n";
+
+    std::cerr << "[Rynox] Wrote " << builtinClasses.size() << " classes to " << listPath << "." << std::endl;
+}
@@ -0,0 +1,20 @@
+#ifndef CLASS_LIST_H
+#define CLASS_LIST_H
+
+#include <string>
+#include <string_view>
+
+// Records the classes loaded until a milestone ("classlist-until=<milestone>", first-frame by default)
+// and writes them to "classlist=<path>" in the -XX:SharedClassListFile format, so the next launch can
+// dump and use an AppCDS archive. Only builtin-loader classes are listed; CDS cannot archive classes
+// of custom loaders from a plain list, those are counted in a trailing comment.
+namespace ClassList {
+    bool enabled();
+    void configure();
+
+    void onClassLoad(std::string_view name, const std::string& loaderName);
+
+    void write();
+}
+
+#endif //CLASS_LIST_H
@@ -0,0 +1,242 @@
+#include "ClassTimeline.h"
+#include "Agent.h"
+#include "Milestones.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    struct PendingLoad {
+        std::string name;
+        uint64_t startNanos;
+        uint64_t childNanos;
+    };
+
+    struct ClassRecord {
+        std::string name;
+        size_t loader;
+        uint64_t threadId;
+        uint64_t hookNanos;
+        uint64_t loadNanos;
+        uint64_t prepareNanos;
+        uint64_t defineNanos;
+    };
+
+    struct LoaderRecord {
+        std::string name;
+        uint64_t classes = 0;
+        uint64_t defineNanos = 0;
+        uint64_t linkNanos = 0;
+    };
+
+    std::string reportPath;
+    std::mutex lock;
+    // Serializes the first-frame and shutdown reports; the records are copied out under "lock".
+    std::mutex writeLock;
+    std::vector<ClassRecord> classes;
+    std::vector<LoaderRecord> loaders;
+    std::unordered_map<jint, size_t> loaderByHash;
+    std::unordered_map<std::string, size_t> classByKey;
+    std::unordered_map<uint64_t, std::string> threadNames;
+
+    thread_local std::vector<PendingLoad> pendingLoads;
+    thread_local bool threadNamed = false;
+
+    std::string classKey(std::string_view name, jint loaderHash) {
+        std::string key(name);
+        key += '#';
+        key += std::to_string(loaderHash);
+        return key;
+    }
+
+    size_t loaderIndex(const std::string& name, jint hash) {
+        auto it = loaderByHash.find(hash);
+        if (it != loaderByHash.end()) return it->second;
+
+        LoaderRecord record;
+        record.name = hash ? name + "@" + std::to_string(hash) : name;
+        loaders.push_back(record);
+        loaderByHash.emplace(hash, loaders.size() - 1);
+        return loaders.size() - 1;
+    }
+
+    double millis(uint64_t nanos) {
+        return static_cast<double>(nanos) / 1e6;
+    }
+
+    std::string threadLabel(const std::unordered_map<uint64_t, std::string>& names, uint64_t threadId) {
+        auto it = names.find(threadId);
+        return it == names.end() ? "tid " + std::to_string(threadId) : it->second + " (tid " + std::to_string(threadId) + ")";
+    }
+}
+
+bool ClassTimeline::enabled() {
+    return !reportPath.empty() || Trace::enabled();
+}
+
+void ClassTimeline::configure() {
+    reportPath = Options::get("timeline");
+    if (reportPath.empty()) return;
+
+    Milestones::onReached(Milestones::FirstFrame, [](const Milestones::Milestone&) {
+        // Report off the render thread; the milestone fires from its ClassPrepare callback.
+        std::thread(&ClassTimeline::writeReport).detach();
+    });
+}
+
+void ClassTimeline::onClassFileLoadHook(const char* name) {
+    if (!name) return;
+    pendingLoads.push_back({name, Platform::nanoTime(), 0});
+}
+
+void ClassTimeline::onClassLoad(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, std::string_view name,
+                                const std::string& loaderName, jint loaderHash) {
+    uint64_t now = Platform::nanoTime();
+    uint64_t hookNanos = 0;
+    uint64_t defineNanos = 0;
+
+    for (size_t i = pendingLoads.size(); i-- > 0;) {
+        if (pendingLoads[i].name != name) continue;
+        uint64_t inclusive = now - pendingLoads[i].startNanos;
+        hookNanos = pendingLoads[i].startNanos;
+        defineNanos = inclusive - std::min(inclusive, pendingLoads[i].childNanos);
+        // Anything above the match never completed (failed define); drop it with the match.
+        pendingLoads.resize(i);
+        if (!pendingLoads.empty()) pendingLoads.back().childNanos += inclusive;
+        break;
+    }
+
+    uint64_t threadId = Platform::currentThreadId();
+    Trace::classLoad(hookNanos ? hookNanos : now, threadId, name, loaderName, hookNanos ? now - hookNanos : 0);
+    if (reportPath.empty()) return;
+
+    std::string threadName;
+    if (!threadNamed && thread) {
+        jvmtiThreadInfo info{};
+        if (jvmti->GetThreadInfo(thread, &info) == JVMTI_ERROR_NONE && info.name) {
+            threadName = info.name;
+            jvmti->Deallocate(reinterpret_cast<unsigned char*>(info.name));
+        }
+        if (info.thread_group) env->DeleteLocalRef(info.thread_group);
+        if (info.context_class_loader) env->DeleteLocalRef(info.context_class_loader);
+        threadNamed = true;
+    }
+
+    std::lock_guard guard(lock);
+    if (!threadName.empty()) threadNames[threadId] = threadName;
+    size_t loaderId = loaderIndex(loaderName, loaderHash);
+
+    classes.push_back({std::string(name), loaderId, threadId, hookNanos, now, 0, defineNanos});
+    classByKey[classKey(name, loaderHash)] = classes.size() - 1;
+    loaders[loaderId].classes++;
+    loaders[loaderId].defineNanos += defineNanos;
+}
+
+void ClassTimeline::onClassPrepare(std::string_view name, jint loaderHash) {
+    if (reportPath.empty()) return;
+    uint64_t now = Platform::nanoTime();
+
+    std::lock_guard guard(lock);
+    auto it = classByKey.find(classKey(name, loaderHash));
+    if (it == classByKey.end()) return;
+
+    ClassRecord& record = classes[it->second];
+    if (record.prepareNanos) return;
+    record.prepareNanos = now;
+    loaders[record.loader].linkNanos += now - record.loadNanos;
+}
+
+void ClassTimeline::writeReport() {
+    if (reportPath.empty()) return;
+
+    // Formatted from a copy, so loading threads only wait for the copy and not for the file.
+    std::lock_guard writing(writeLock);
+    std::vector<ClassRecord> records;
+    std::vector<LoaderRecord> loaderRecords;
+    std::unordered_map<uint64_t, std::string> names;
+    {
+        std::lock_guard guard(lock);
+        records = classes;
+        loaderRecords = loaders;
+        names = threadNames;
+    }
+
+    std::ofstream out(reportPath, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[Rynox] Failed to write class timeline to " << reportPath << "." << std::endl;
+        return;
+    }
+
+    auto linkNanos = [](const ClassRecord& record) {
+        return record.prepareNanos ? record.prepareNanos - record.loadNanos : 0;
+    };
+    auto line = [&](const ClassRecord& record) {
+        char buffer[96];
+        std::snprintf(buffer, sizeof(buffer), "%10.3f %10.1f %10.1f  ", millis(record.loadNanos - Agent::startNanos),
+                      static_cast<double>(record.defineNanos) / 1e3, static_cast<double>(linkNanos(record)) / 1e3);
+        out << buffer << record.name << "  [" << loaderRecords[record.loader].name << "] " << threadLabel(names, record.threadId) << "\n";
+    };
+
+    uint64_t totalDefine = 0;
+    uint64_t totalLink = 0;
+    for (const auto& record : records) {
+        totalDefine += record.defineNanos;
+        totalLink += linkNanos(record);
+    }
+
+    out << "# Rynox class-loading timeline\n";
+    out << "classes " << records.size() << ", loaders " << loaderRecords.size() << ", define " << millis(totalDefine)
+        << " ms, link " << millis(totalLink) << " ms\n";
+    if (!Agent::earlyStart) out << "note: agent attached late, classes loaded before attach are missing\n";
+
+    out << "\n## Per classloader (define ms, link ms, classes)\n";
+    std::vector<size_t> loaderOrder(loaderRecords.size());
+    for (size_t i = 0; i < loaderOrder.size(); i++) loaderOrder[i] = i;
+    std::sort(loaderOrder.begin(), loaderOrder.end(), [&](size_t a, size_t b) {
+        return loaderRecords[a].defineNanos + loaderRecords[a].linkNanos > loaderRecords[b].defineNanos + loaderRecords[b].linkNanos;
+    });
+    for (size_t index : loaderOrder) {
+        const auto& loader = loaderRecords[index];
+        out << millis(loader.defineNanos) << "\t" << millis(loader.linkNanos) << "\t" << loader.classes << "\t" << loader.name << "\n";
+    }
+
+    out << "\n## Slowest classes by define time (offset ms, define us, link us)\n";
+    std::vector<size_t> slowest(records.size());
+    for (size_t i = 0; i < slowest.size(); i++) slowest[i] = i;
+    size_t top = std::min<size_t>(slowest.size(), 50);
+    std::partial_sort(slowest.begin(), slowest.begin() + static_cast<long>(top), slowest.end(), [&](size_t a, size_t b) {
+        return records[a].defineNanos > records[b].defineNanos;
+    });
+    for (size_t i = 0; i < top; i++) line(records[slowest[i]]);
+
+    Milestones::Milestone firstFrame;
+    if (Milestones::reached(Milestones::FirstFrame, &firstFrame)) {
+        uint64_t pathDefine = 0;
+        uint64_t pathLink = 0;
+        size_t pathClasses = 0;
+        for (const auto& record : records) {
+            if (record.threadId != firstFrame.threadId || record.loadNanos > firstFrame.nanos) continue;
+            pathDefine += record.defineNanos;
+            pathLink += linkNanos(record);
+            pathClasses++;
+        }
+
+        out << "\n## Critical path to first frame on " << threadLabel(names, firstFrame.threadId) << "\n";
+        out << "reached at " << millis(firstFrame.nanos - Agent::startNanos) << " ms, " << pathClasses << " classes, define "
+            << millis(pathDefine) << " ms, link " << millis(pathLink) << " ms\n";
+        for (const auto& record : records) {
+            if (record.threadId == firstFrame.threadId && record.loadNanos <= firstFrame.nanos) line(record);
+        }
+    }
+
+    out << "\n## Timeline (offset ms, define us, link us)\n";
+    for (const auto& record : records) line(record);
+}
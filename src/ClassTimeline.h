@@ -0,0 +1,25 @@
+#ifndef CLASS_TIMELINE_H
+#define CLASS_TIMELINE_H
+
+#include <jvmti.h>
+#include <string>
+#include <string_view>
+
+// Startup class-loading timeline, enabled with "timeline=<report path>" (and feeding ClassLoad events
+// to the trace when tracing is on, which alone keeps no records). For every class it records
+// the ClassFileLoadHook, ClassLoad and ClassPrepare times: "define" is hook -> load minus nested loads
+// on the same thread (parse and define), "link" is load -> prepare. The report is written once the
+// first-frame milestone is reached, and again on shutdown.
+namespace ClassTimeline {
+    bool enabled();
+    void configure();
+
+    void onClassFileLoadHook(const char* name);
+    void onClassLoad(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, std::string_view name,
+                     const std::string& loaderName, jint loaderHash);
+    void onClassPrepare(std::string_view name, jint loaderHash);
+
+    void writeReport();
+}
+
+#endif //CLASS_TIMELINE_H
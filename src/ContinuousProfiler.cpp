@@ -0,0 +1,226 @@
+#include "ContinuousProfiler.h"
+#include "Options.h"
+#include "StackProfile.h"
+#include "StackTrie.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace {
+    constexpr uint64_t HourMillis = 3600 * 1000;
+
+    std::string directory;
+    uint64_t windowMillis = 0;
+    uint64_t compactMillis = 0;
+    uint64_t retentionMillis = 0;
+    uint64_t maxBytes = 0;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    bool running = false;
+    bool finished = true;
+    StackTrie::CountSnapshot previous;
+    uint64_t windowStart = 0;
+    bool warnedTruncation = false;
+
+    struct HistoryFile {
+        std::string name;
+        bool compacted;
+        uint64_t start;
+        uint64_t length;
+        uint64_t size;
+    };
+
+    uint64_t epochMillis() {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    std::string fileName(bool compacted, uint64_t start, uint64_t length) {
+        return std::string(compacted ? "hour-" : "window-") + std::to_string(start) + "-" + std::to_string(length) + ".rstk";
+    }
+
+    // Written under a temporary name and renamed, so a reader or a crash never sees half a window.
+    bool writeFile(const std::string& name, const std::vector<uint8_t>& data) {
+        std::string path = directory + "/" + name;
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+            if (!out) return false;
+        }
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    bool readFile(const std::string& name, std::vector<uint8_t>& data) {
+        std::ifstream in(directory + "/" + name, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return static_cast<bool>(in) || in.eof();
+    }
+
+    std::vector<HistoryFile> listHistory() {
+        std::vector<HistoryFile> files;
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) return files;
+        while (dirent* entry = readdir(dir)) {
+            HistoryFile file{entry->d_name, false, 0, 0, 0};
+            unsigned long long start = 0, length = 0;
+            char suffix[8] = {};
+            if (std::sscanf(entry->d_name, "window-%llu-%llu.%7s", &start, &length, suffix) == 3) file.compacted = false;
+            else if (std::sscanf(entry->d_name, "hour-%llu-%llu.%7s", &start, &length, suffix) == 3) file.compacted = true;
+            else continue;
+            if (std::string(suffix) != "rstk") continue;
+
+            struct stat info{};
+            if (stat((directory + "/" + file.name).c_str(), &info) != 0) continue;
+            file.start = start;
+            file.length = length;
+            file.size = static_cast<uint64_t>(info.st_size);
+            files.push_back(std::move(file));
+        }
+        closedir(dir);
+        std::sort(files.begin(), files.end(), [](const HistoryFile& a, const HistoryFile& b) { return a.start < b.start; });
+        return files;
+    }
+
+    void removeFile(const HistoryFile& file) {
+        std::remove((directory + "/" + file.name).c_str());
+    }
+
+    void compact(uint64_t now) {
+        std::map<uint64_t, std::vector<HistoryFile>> hours;
+        for (const auto& file : listHistory()) {
+            if (!file.compacted && file.start + file.length + compactMillis <= now) hours[file.start / HourMillis].push_back(file);
+        }
+
+        for (auto& [hour, files] : hours) {
+            // Windows compacted in an earlier pass already have an hour file; fold it in as well.
+            StackProfile merged;
+            std::vector<uint8_t> data;
+            uint64_t start = files.front().start;
+            uint64_t end = 0;
+            std::vector<HistoryFile> inputs = files;
+            for (const auto& file : listHistory()) {
+                if (file.compacted && file.start / HourMillis == hour) inputs.push_back(file);
+            }
+
+            for (const auto& file : inputs) {
+                StackProfile profile;
+                if (!readFile(file.name, data) || !profile.parse(data.data(), data.size())) {
+                    std::cerr << "[Rynox] Dropping unreadable profile window " << file.name << "." << std::endl;
+                    continue;
+                }
+                merged.merge(profile);
+                start = std::min(start, file.start);
+                end = std::max(end, file.start + file.length);
+            }
+
+            if (end > start && !writeFile(fileName(true, start, end - start), merged.serialize())) {
+                std::cerr << "[Rynox] Failed to write compacted profile for " << directory << "." << std::endl;
+                continue;
+            }
+            std::string kept = fileName(true, start, end - start);
+            for (const auto& file : inputs) {
+                if (file.name != kept) removeFile(file);
+            }
+        }
+    }
+
+    void enforceRetention(uint64_t now) {
+        std::vector<HistoryFile> files = listHistory();
+        uint64_t total = 0;
+        for (const auto& file : files) total += file.size;
+
+        for (const auto& file : files) {
+            bool expired = file.start + file.length + retentionMillis < now;
+            if (!expired && total <= maxBytes) break;
+            removeFile(file);
+            total -= file.size;
+        }
+    }
+
+    void writeWindow() {
+        uint64_t now = epochMillis();
+        std::vector<uint8_t> data = StackTrie::serialize(&previous);
+        if (!writeFile(fileName(false, windowStart, now - windowStart), data)) {
+            std::cerr << "[Rynox] Failed to write profile window to " << directory << "." << std::endl;
+        }
+        windowStart = now;
+        // The trie is shared with the trace and the reports, whose node ids must stay valid, so it
+        // is not reset per window; each window records how many of its stacks were cut short.
+        if (StackTrie::truncated() && !warnedTruncation) {
+            warnedTruncation = true;
+            std::cerr << "[Rynox] Stack table full, later profile windows hold truncated stacks; raise stack-nodes." << std::endl;
+        }
+        compact(now);
+        enforceRetention(now);
+    }
+
+    void* runProfiler(void*) {
+        std::unique_lock guard(lock);
+        while (running) {
+            wake.wait_until(guard, std::chrono::steady_clock::now() + std::chrono::milliseconds(windowMillis), [] { return !running; });
+            writeWindow();
+        }
+        finished = true;
+        wake.notify_all();
+        return nullptr;
+    }
+}
+
+bool ContinuousProfiler::enabled() {
+    return !directory.empty();
+}
+
+void ContinuousProfiler::configure() {
+    directory = Options::get("continuous");
+    if (directory.empty()) return;
+    mkdir(directory.c_str(), 0755);
+
+    windowMillis = static_cast<uint64_t>(std::max(1L, Options::getLong("continuous-window", 60))) * 1000;
+    compactMillis = static_cast<uint64_t>(std::max(0L, Options::getLong("continuous-compact", 60))) * 60 * 1000;
+    retentionMillis = static_cast<uint64_t>(std::max(1L, Options::getLong("continuous-retention", 1440))) * 60 * 1000;
+    maxBytes = static_cast<uint64_t>(std::max(1L, Options::getLong("continuous-max-mb", 256))) << 20;
+    StackTrie::configure();
+}
+
+void ContinuousProfiler::start() {
+    if (!enabled()) return;
+    std::lock_guard guard(lock);
+    if (running) return;
+    windowStart = epochMillis();
+    // Counts from before the start (an earlier trie user) do not belong to the first window.
+    StackTrie::serialize(&previous);
+
+    pthread_t thread;
+    running = true;
+    finished = false;
+    if (pthread_create(&thread, nullptr, &runProfiler, nullptr) != 0) {
+        std::cerr << "[Rynox] Failed to create continuous profiler thread." << std::endl;
+        running = false;
+        finished = true;
+        return;
+    }
+    pthread_detach(thread);
+}
+
+void ContinuousProfiler::stop() {
+    // Wakes the thread, which writes the partial last window before it exits.
+    std::unique_lock guard(lock);
+    if (!running) return;
+    running = false;
+    wake.notify_all();
+    wake.wait(guard, [] { return finished; });
+}
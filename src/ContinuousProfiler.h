@@ -0,0 +1,20 @@
+#ifndef CONTINUOUS_PROFILER_H
+#define CONTINUOUS_PROFILER_H
+
+// Continuous profiling into a bounded on-disk history, enabled with "continuous=<directory>" (the
+// sampler then defaults to 20 ms). Every "continuous-window" seconds (60) the samples counted since
+// the previous window are written as window-<start epoch ms>-<length ms>.rstk, a delta StackTrie
+// serialization that also counts the stacks cut short once the StackTrie is full. Windows older
+// than "continuous-compact" minutes (60) are merged per hour into hour-<start>-<length>.rstk; files
+// ending more than "continuous-retention" minutes (1440) ago are deleted, and the oldest go first
+// while the directory exceeds "continuous-max-mb" (256). "rynox-report history <directory>" merges
+// the files of a time range back into top methods or collapsed stacks.
+namespace ContinuousProfiler {
+    bool enabled();
+    void configure();
+
+    void start();
+    void stop();
+}
+
+#endif //CONTINUOUS_PROFILER_H
@@ -0,0 +1,91 @@
+#include "CrashHandler.h"
+#include "Options.h"
+#include "Trace.h"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace {
+    constexpr int Signals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+    constexpr int MaxSignal = 64;
+
+    bool active = false;
+    std::atomic_bool installed = false;
+    std::atomic_bool sealed = false;
+    struct sigaction previous[MaxSignal] = {};
+
+    uint64_t threadId() {
+#ifdef __linux__
+        // Not Platform::currentThreadId: its thread_local may allocate on first use.
+        return static_cast<uint64_t>(syscall(SYS_gettid));
+#else
+        return reinterpret_cast<uintptr_t>(pthread_self());
+#endif
+    }
+
+    void seal(int signal, const siginfo_t* info) {
+        if (sealed.exchange(true)) return;
+        Trace::seal(threadId(), signal, info ? reinterpret_cast<uintptr_t>(info->si_addr) : 0);
+    }
+
+    // Runs the handler that was installed before ours; true when it returned (the signal was handled).
+    bool chain(int signal, siginfo_t* info, void* context) {
+        const struct sigaction& action = previous[signal];
+        if (action.sa_flags & SA_SIGINFO) {
+            if (!action.sa_sigaction) return false;
+            action.sa_sigaction(signal, info, context);
+            return true;
+        }
+        if (action.sa_handler == SIG_IGN) return true;
+        if (action.sa_handler == SIG_DFL || !action.sa_handler) return false;
+        action.sa_handler(signal);
+        return true;
+    }
+
+    void handle(int signal, siginfo_t* info, void* context) {
+        int savedErrno = errno;
+        // SIGABRT is always the end; other faults only when nobody before us takes care of them.
+        if (signal == SIGABRT) seal(signal, info);
+        if (chain(signal, info, context)) {
+            errno = savedErrno;
+            return;
+        }
+
+        seal(signal, info);
+        // No previous handler: die the default way. A fault re-triggers when we return; sent signals are re-raised.
+        struct sigaction fallback{};
+        fallback.sa_handler = SIG_DFL;
+        sigemptyset(&fallback.sa_mask);
+        sigaction(signal, &fallback, nullptr);
+        if (signal == SIGABRT || !info || info->si_code <= 0) raise(signal);
+        errno = savedErrno;
+    }
+}
+
+bool CrashHandler::enabled() {
+    return active;
+}
+
+void CrashHandler::configure() {
+    active = Trace::enabled() && Options::get("crash-handler", "true") != "false";
+}
+
+void CrashHandler::install() {
+    if (!active || installed.exchange(true)) return;
+    for (int signal : Signals) {
+        struct sigaction action{};
+        action.sa_sigaction = &handle;
+        action.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(signal, &action, &previous[signal]) != 0) {
+            std::cerr << "[Rynox] Failed to install crash handler for signal " << signal << "." << std::endl;
+        }
+    }
+}
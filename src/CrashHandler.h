@@ -0,0 +1,17 @@
+#ifndef CRASH_HANDLER_H
+#define CRASH_HANDLER_H
+
+// Seals the trace when the process dies on a fatal signal, active whenever tracing unless
+// "crash-handler=false". Handlers for SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT are chained in front
+// of the JVM's: faults go to the JVM first, since HotSpot uses SIGSEGV for implicit null checks and
+// safepoint polls, and a genuine crash ends in abort(), whose SIGABRT seals the trace. The sealing
+// path only stores into already-mapped trace memory, so it is async-signal-safe.
+namespace CrashHandler {
+    bool enabled();
+    void configure();
+
+    // Call once the JVM has installed its own handlers (VMInit, or attach).
+    void install();
+}
+
+#endif //CRASH_HANDLER_H
@@ -0,0 +1,231 @@
+#include "ExceptionMonitor.h"
+#include "Agent.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr size_t SketchDepth = 4;
+    constexpr size_t SketchWidth = 4096;
+    constexpr size_t SiteSlots = 512;
+    constexpr uint32_t PromoteThreshold = 4;
+    constexpr jint StackDepth = 32;
+    constexpr size_t MaxStacks = 256;
+
+    enum SlotState : uint32_t { Empty, Claimed, Ready };
+
+    struct Site {
+        std::atomic<uint64_t> key = 0;
+        std::atomic<uint32_t> state = Empty;
+        std::string exceptionClass;
+        std::string thrownAt;
+        std::string caughtAt;
+    };
+
+    struct StackSample {
+        uint64_t key;
+        uint64_t nanos;
+        std::vector<std::string> frames;
+    };
+
+    std::string reportPath;
+    long stacksPerSecond = 10;
+    long stormThreshold = 10000;
+
+    std::array<std::array<std::atomic<uint32_t>, SketchWidth>, SketchDepth> sketch{};
+    std::array<Site, SiteSlots> sites;
+    std::atomic<uint64_t> totalThrows = 0;
+    std::atomic<uint64_t> droppedSites = 0;
+
+    std::atomic<uint64_t> currentSecond = 0;
+    std::atomic<uint64_t> secondThrows = 0;
+    std::atomic<int64_t> stackBudget = 0;
+    std::atomic<uint64_t> storms = 0;
+
+    std::mutex stackLock;
+    std::vector<StackSample> stacks;
+    size_t nextStack = 0;
+
+    uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+        return value;
+    }
+
+    uint64_t siteKey(jint classHash, jmethodID method, jlocation location) {
+        uint64_t key = mix(reinterpret_cast<uintptr_t>(method) ^ (static_cast<uint64_t>(location) << 48));
+        key = mix(key ^ static_cast<uint32_t>(classHash));
+        return key ? key : 1;
+    }
+
+    uint32_t addToSketch(uint64_t key) {
+        uint32_t estimate = UINT32_MAX;
+        for (size_t row = 0; row < SketchDepth; row++) {
+            size_t column = mix(key + row * 0x9e3779b97f4a7c15ull) & (SketchWidth - 1);
+            estimate = std::min(estimate, sketch[row][column].fetch_add(1, std::memory_order_relaxed) + 1);
+        }
+        return estimate;
+    }
+
+    uint32_t estimate(uint64_t key) {
+        uint32_t estimate = UINT32_MAX;
+        for (size_t row = 0; row < SketchDepth; row++) {
+            size_t column = mix(key + row * 0x9e3779b97f4a7c15ull) & (SketchWidth - 1);
+            estimate = std::min(estimate, sketch[row][column].load(std::memory_order_relaxed));
+        }
+        return estimate;
+    }
+
+    // Finds the slot for a key, claiming an empty one when asked to; "claimed" tells the caller it
+    // owns the new slot and must fill it in. Returns nullptr when the key is not tracked.
+    Site* findSite(uint64_t key, bool claim, bool& claimed) {
+        claimed = false;
+        size_t index = key & (SiteSlots - 1);
+        for (size_t probe = 0; probe < SiteSlots; probe++) {
+            Site& site = sites[(index + probe) & (SiteSlots - 1)];
+            uint64_t existing = site.key.load(std::memory_order_acquire);
+            if (existing == key) return &site;
+            if (existing != 0) continue;
+            if (!claim) return nullptr;
+            if (site.key.compare_exchange_strong(existing, key, std::memory_order_acq_rel)) {
+                claimed = true;
+                return &site;
+            }
+            if (existing == key) return &site;
+        }
+        if (claim) droppedSites.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    void rollSecond(uint64_t second) {
+        uint64_t previous = currentSecond.load(std::memory_order_relaxed);
+        if (previous == second || !currentSecond.compare_exchange_strong(previous, second)) return;
+
+        uint64_t throws = secondThrows.exchange(0, std::memory_order_relaxed);
+        stackBudget.store(stacksPerSecond, std::memory_order_relaxed);
+        if (previous == 0 || throws < static_cast<uint64_t>(stormThreshold)) return;
+
+        storms.fetch_add(1, std::memory_order_relaxed);
+        const Site* top = nullptr;
+        uint32_t topCount = 0;
+        for (const auto& site : sites) {
+            if (site.state.load(std::memory_order_acquire) != Ready) continue;
+            uint32_t count = estimate(site.key.load(std::memory_order_relaxed));
+            if (count > topCount) {
+                top = &site;
+                topCount = count;
+            }
+        }
+        std::cerr << "[Rynox] Exception storm: " << throws << " throws/s";
+        if (top) std::cerr << ", top " << top->exceptionClass << " at " << top->thrownAt;
+        std::cerr << "." << std::endl;
+    }
+
+    void captureStack(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jclass exceptionClass, uint64_t key) {
+        jvmtiFrameInfo frames[StackDepth];
+        jint count = 0;
+        if (jvmti->GetStackTrace(thread, 0, StackDepth, frames, &count) != JVMTI_ERROR_NONE) return;
+
+        if (Trace::enabled() && count > 0) {
+            Trace::exception(Platform::nanoTime(), Trace::threadId(jvmti, env, thread), Agent::className(jvmti, exceptionClass),
+                             Agent::methodLocation(jvmti, env, frames[0].method, frames[0].location),
+                             Trace::stack(jvmti, env, frames, count));
+        }
+
+        StackSample sample{key, Platform::nanoTime(), {}};
+        sample.frames.reserve(static_cast<size_t>(count));
+        for (jint i = 0; i < count; i++) sample.frames.push_back(Agent::methodLocation(jvmti, env, frames[i].method, frames[i].location));
+
+        std::lock_guard guard(stackLock);
+        if (stacks.size() < MaxStacks) {
+            stacks.push_back(std::move(sample));
+        } else {
+            stacks[nextStack] = std::move(sample);
+            nextStack = (nextStack + 1) % MaxStacks;
+        }
+    }
+}
+
+bool ExceptionMonitor::enabled() {
+    return !reportPath.empty();
+}
+
+void ExceptionMonitor::configure() {
+    reportPath = Options::get("exceptions");
+    stacksPerSecond = Options::getLong("exception-stacks", stacksPerSecond);
+    stormThreshold = Options::getLong("exception-storm", stormThreshold);
+}
+
+void ExceptionMonitor::onException(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location,
+                                   jobject exception, jmethodID catchMethod, jlocation catchLocation) {
+    jclass exceptionClass = env->GetObjectClass(exception);
+    jint classHash = 0;
+    jvmti->GetObjectHashCode(exceptionClass, &classHash);
+
+    uint64_t key = siteKey(classHash, method, location);
+    uint32_t count = addToSketch(key);
+    totalThrows.fetch_add(1, std::memory_order_relaxed);
+    secondThrows.fetch_add(1, std::memory_order_relaxed);
+    rollSecond(Platform::nanoTime() / 1000000000ull);
+
+    if (count >= PromoteThreshold) {
+        bool claimed = false;
+        Site* site = findSite(key, true, claimed);
+        if (site && claimed) {
+            // Names are resolved once per site; the VM is gone by the time the report is written.
+            site->exceptionClass = Agent::className(jvmti, exceptionClass);
+            site->thrownAt = Agent::methodLocation(jvmti, env, method, location);
+            site->caughtAt = catchMethod ? Agent::methodLocation(jvmti, env, catchMethod, catchLocation) : "uncaught";
+            site->state.store(Ready, std::memory_order_release);
+        }
+    }
+
+    if (stackBudget.load(std::memory_order_relaxed) > 0 && stackBudget.fetch_sub(1, std::memory_order_relaxed) > 0) {
+        captureStack(jvmti, env, thread, exceptionClass, key);
+    }
+    env->DeleteLocalRef(exceptionClass);
+}
+
+void ExceptionMonitor::writeReport() {
+    if (!enabled()) return;
+
+    std::ofstream out(reportPath, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[Rynox] Failed to write exception report to " << reportPath << "." << std::endl;
+        return;
+    }
+
+    std::vector<std::pair<uint32_t, const Site*>> ranked;
+    for (const auto& site : sites) {
+        if (site.state.load(std::memory_order_acquire) == Ready) ranked.emplace_back(estimate(site.key.load()), &site);
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    out << "# Rynox exception report\n";
+    out << "throws " << totalThrows.load() << ", storms " << storms.load() << ", untracked sites " << droppedSites.load() << "\n";
+    out << "\n## Throw sites (estimated count, exception, thrown at, caught at)\n";
+    for (const auto& [count, site] : ranked) {
+        out << count << "\t" << site->exceptionClass << "\t" << site->thrownAt << "\t" << site->caughtAt << "\n";
+    }
+
+    std::lock_guard guard(stackLock);
+    out << "\n## Sampled stacks\n";
+    for (const auto& [count, site] : ranked) {
+        uint64_t key = site->key.load();
+        auto sample = std::find_if(stacks.begin(), stacks.end(), [key](const StackSample& s) { return s.key == key; });
+        if (sample == stacks.end()) continue;
+        out << site->exceptionClass << " (" << count << ")\n";
+        for (const auto& frame : sample->frames) out << "\tat " << frame << "\n";
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef EXCEPTION_MONITOR_H
+#define EXCEPTION_MONITOR_H
+
+#include <jvmti.h>
+
+// Exception storm detector, enabled with "exceptions=<report path>". Every throw is counted by
+// exception class and throw site in a lock-free count-min sketch; sites that reach a few throws are
+// promoted into a fixed table that remembers their names and catch site (taken from the Exception
+// event itself, so no ExceptionCatch events are needed). Full stacks are captured for at most
+// "exception-stacks" throws per second, and a storm is logged when a second exceeds
+// "exception-storm" throws.
+namespace ExceptionMonitor {
+    bool enabled();
+    void configure();
+
+    void onException(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location,
+                     jobject exception, jmethodID catchMethod, jlocation catchLocation);
+
+    void writeReport();
+}
+
+#endif //EXCEPTION_MONITOR_H
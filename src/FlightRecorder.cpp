@@ -0,0 +1,116 @@
+#include "FlightRecorder.h"
+#include "FrameClock.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <pthread.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    std::string recorderDirectory;
+    uint64_t windowNanos = 0;
+    uint64_t afterNanos = 0;
+    uint64_t cooldownNanos = 0;
+    uint64_t frameThreshold = 0;
+    uint64_t tickThreshold = 0;
+    uint64_t collectionThreshold = 0;
+
+    std::atomic_bool running = false;
+    // Set once per trigger; the recorder thread clears them when it dumps.
+    std::atomic<const char*> pendingReason = nullptr;
+    std::atomic<uint64_t> pendingNanos = 0;
+    std::atomic<uint64_t> lastDump = 0;
+
+    uint64_t millis(const char* key, long fallback) {
+        return static_cast<uint64_t>(std::max(0L, Options::getLong(key, fallback))) * 1000000ull;
+    }
+
+    void dump(const char* reason, uint64_t triggerNanos) {
+        auto epoch = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        std::string path = recorderDirectory + "/rynox-" + std::to_string(epoch) + "-" + reason + ".trace";
+        uint64_t from = triggerNanos > windowNanos ? triggerNanos - windowNanos : 0;
+        if (Trace::dumpRecording(path, from)) std::cerr << "[Rynox] Flight recorder (" << reason << ") wrote " << path << "." << std::endl;
+        lastDump = Platform::nanoTime();
+    }
+
+    void* runRecorder(void*) {
+        std::string triggerFile = recorderDirectory + "/trigger";
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (access(triggerFile.c_str(), F_OK) == 0 && unlink(triggerFile.c_str()) == 0) FlightRecorder::trigger("manual");
+
+            const char* reason = pendingReason.load();
+            uint64_t triggered = pendingNanos.load();
+            if (!reason || !triggered || Platform::nanoTime() < triggered + afterNanos) continue;
+            dump(reason, triggered);
+            pendingNanos = 0;
+            pendingReason = nullptr;
+        }
+        return nullptr;
+    }
+}
+
+bool FlightRecorder::enabled() {
+    return !recorderDirectory.empty();
+}
+
+const std::string& FlightRecorder::directory() {
+    return recorderDirectory;
+}
+
+void FlightRecorder::configure() {
+    if (!Options::has("recorder")) return;
+    recorderDirectory = Options::get("recorder", ".");
+    if (recorderDirectory.empty()) recorderDirectory = ".";
+    mkdir(recorderDirectory.c_str(), 0755);
+
+    windowNanos = millis("recorder-seconds", 30) * 1000;
+    afterNanos = millis("recorder-after", 2) * 1000;
+    cooldownNanos = millis("recorder-cooldown", 30) * 1000;
+    frameThreshold = millis("recorder-frame-ms", 100);
+    tickThreshold = millis("recorder-tick-ms", 100);
+    collectionThreshold = millis("recorder-gc-ms", 200);
+}
+
+void FlightRecorder::start() {
+    if (!enabled() || !Trace::recording() || running.exchange(true)) return;
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, &runRecorder, nullptr) != 0) {
+        std::cerr << "[Rynox] Failed to create flight recorder thread." << std::endl;
+        running = false;
+        return;
+    }
+    pthread_detach(thread);
+}
+
+void FlightRecorder::stop() {
+    if (!running.exchange(false)) return;
+    // A spike right before exit is still worth its dump, without the post-trigger wait.
+    const char* reason = pendingReason.exchange(nullptr);
+    if (reason) dump(reason, pendingNanos.load() ? pendingNanos.load() : Platform::nanoTime());
+}
+
+void FlightRecorder::trigger(const char* reason) {
+    if (!running.load(std::memory_order_relaxed)) return;
+    uint64_t now = Platform::nanoTime();
+    uint64_t last = lastDump.load(std::memory_order_relaxed);
+    if (last && now - last < cooldownNanos) return;
+    const char* expected = nullptr;
+    if (pendingReason.compare_exchange_strong(expected, reason)) pendingNanos = now;
+}
+
+void FlightRecorder::onFrame(std::string_view kind, uint64_t duration) {
+    uint64_t threshold = kind == FrameClock::TickKind ? tickThreshold : frameThreshold;
+    if (threshold && duration > threshold) trigger(kind == FrameClock::TickKind ? "slow-tick" : "slow-frame");
+}
+
+void FlightRecorder::onGarbageCollection(uint64_t duration) {
+    if (collectionThreshold && duration > collectionThreshold) trigger("gc-pause");
+}
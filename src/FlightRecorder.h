@@ -0,0 +1,28 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Spike-triggered dumps of the trace ring, enabled with "recorder=<directory>". Everything the trace
+// records (samples every 20 ms unless "sample" says otherwise) goes to an in-memory ring; a trigger
+// freezes it and writes the last "recorder-seconds" (30) plus "recorder-after" seconds (2) past the
+// trigger as <directory>/rynox-<epoch ms>-<reason>.trace. Triggers are a frame or tick longer than
+// "recorder-frame-ms" / "recorder-tick-ms" (100), a GC pause over "recorder-gc-ms" (200), creating
+// <directory>/trigger, or trigger(). "recorder-cooldown" seconds (30) must pass between dumps.
+namespace FlightRecorder {
+    bool enabled();
+    void configure();
+    const std::string& directory();
+
+    void start();
+    void stop();
+
+    // Cheap and lock-free; safe from GC callbacks.
+    void trigger(const char* reason);
+    void onFrame(std::string_view kind, uint64_t duration);
+    void onGarbageCollection(uint64_t duration);
+}
+
+#endif //FLIGHT_RECORDER_H
@@ -0,0 +1,119 @@
+#include "FrameClock.h"
+#include "Agent.h"
+#include "FlightRecorder.h"
+#include "Mappings.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Probes.h"
+#include "Trace.h"
+#include <atomic>
+#include <iostream>
+#include <string>
+
+namespace {
+    struct Boundary {
+        const char* kind;
+        std::string className;
+        std::string methodName;
+        // Set when the target was translated through the mappings, where overloads share obfuscated names.
+        std::string methodSignature;
+        std::atomic<jmethodID> method = nullptr;
+        std::atomic<uint64_t> lastEntry = 0;
+    };
+
+    Boundary boundaries[] = {{FrameClock::FrameKind, {}, {}, {}}, {FrameClock::TickKind, {}, {}, {}}};
+    bool active = false;
+
+    void setTarget(Boundary& boundary, const std::string& target) {
+        if (target.empty()) return;
+        size_t dot = target.rfind('.');
+        if (dot == std::string::npos || dot == 0 || dot + 1 == target.size()) {
+            std::cerr << "[Rynox] Ignoring " << boundary.kind << " method \"" << target << "\", expected <class>.<method>." << std::endl;
+            return;
+        }
+        boundary.className = target.substr(0, dot);
+        boundary.methodName = target.substr(dot + 1);
+
+        Mappings::Method obfuscated;
+        if (Mappings::enabled() && Mappings::obfuscateMethod(boundary.className, boundary.methodName, {}, obfuscated)) {
+            boundary.className = std::move(obfuscated.owner);
+            boundary.methodName = std::move(obfuscated.name);
+            boundary.methodSignature = std::move(obfuscated.descriptor);
+        }
+    }
+
+    void arm(jvmtiEnv* jvmti, jclass klass, Boundary& boundary) {
+        jint count = 0;
+        jmethodID* methods = nullptr;
+        if (jvmti->GetClassMethods(klass, &count, &methods) != JVMTI_ERROR_NONE) return;
+
+        for (jint i = 0; i < count; i++) {
+            char* name = nullptr;
+            char* signature = nullptr;
+            if (jvmti->GetMethodName(methods[i], &name, &signature, nullptr) != JVMTI_ERROR_NONE || !name) continue;
+            bool match = boundary.methodName == name && (boundary.methodSignature.empty() || boundary.methodSignature == signature);
+            jvmti->Deallocate(reinterpret_cast<unsigned char*>(name));
+            jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+            if (!match) continue;
+
+            // The first overload wins; entry points are not overloaded in practice.
+            jvmtiError error = jvmti->SetBreakpoint(methods[i], 0);
+            if (error == JVMTI_ERROR_NONE) boundary.method = methods[i];
+            else std::cerr << "[Rynox] Failed to set " << boundary.kind << " breakpoint (JVMTI error " << error << ")." << std::endl;
+            break;
+        }
+        jvmti->Deallocate(reinterpret_cast<unsigned char*>(methods));
+    }
+}
+
+bool FrameClock::enabled() {
+    return active;
+}
+
+void FrameClock::configure() {
+    if (!Trace::enabled()) return;
+    setTarget(boundaries[0], Options::get("frame-method", "net/minecraft/client/Minecraft.runTick"));
+    setTarget(boundaries[1], Options::get("tick-method", "net/minecraft/client/Minecraft.tick"));
+    active = !boundaries[0].className.empty() || !boundaries[1].className.empty();
+}
+
+void FrameClock::start(jvmtiEnv* jvmti) {
+    jvmtiPhase phase;
+    if (!active || jvmti->GetPhase(&phase) != JVMTI_ERROR_NONE || phase != JVMTI_PHASE_LIVE) return;
+
+    jint count = 0;
+    jclass* classes = nullptr;
+    if (jvmti->GetLoadedClasses(&count, &classes) != JVMTI_ERROR_NONE) return;
+    for (jint i = 0; i < count; i++) {
+        jint status = 0;
+        jvmti->GetClassStatus(classes[i], &status);
+        if (status & JVMTI_CLASS_STATUS_PREPARED) onClassPrepare(jvmti, classes[i], Agent::className(jvmti, classes[i]));
+    }
+    JNIEnv* env = nullptr;
+    if (Agent::jvm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_8) == JNI_OK && env) {
+        for (jint i = 0; i < count; i++) env->DeleteLocalRef(classes[i]);
+    }
+    jvmti->Deallocate(reinterpret_cast<unsigned char*>(classes));
+}
+
+void FrameClock::onClassPrepare(jvmtiEnv* jvmti, jclass klass, std::string_view className) {
+    if (!active) return;
+    for (auto& boundary : boundaries) {
+        if (boundary.className == className && !boundary.method.load()) arm(jvmti, klass, boundary);
+    }
+}
+
+void FrameClock::onBreakpoint(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location) {
+    // Breakpoint probes may stop elsewhere in the same methods.
+    if (location != 0) return;
+    for (auto& boundary : boundaries) {
+        if (boundary.method.load(std::memory_order_relaxed) != method) continue;
+        uint64_t now = Platform::nanoTime();
+        uint64_t previous = boundary.lastEntry.exchange(now, std::memory_order_relaxed);
+        if (!previous) continue;
+        uint64_t threadId = Trace::threadId(jvmti, env, thread);
+        Trace::frame(previous, threadId, boundary.kind, now - previous);
+        if (FlightRecorder::enabled()) FlightRecorder::onFrame(boundary.kind, now - previous);
+        if (Probes::nativesEnabled() && boundary.kind == FrameClock::FrameKind) Probes::onFrame(now, threadId);
+    }
+}
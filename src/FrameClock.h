@@ -0,0 +1,26 @@
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+#include <jvmti.h>
+#include <string_view>
+
+// Frame and tick boundaries from JVMTI breakpoints at bci 0 of the render and tick entry points
+// ("frame-method" and "tick-method" as <class>.<method>, Mojang names of the client by default).
+// Each entry closes the previous interval of the same kind, which is emitted as a Frame event with
+// its start time and length. Active when tracing; the breakpointed methods stay interpreted, which is
+// cheap for once-per-frame entry points whose callees still compile. With "mappings" the targets are
+// translated, so the same Mojang names bind to an obfuscated client.
+namespace FrameClock {
+    inline constexpr const char* FrameKind = "frame";
+    inline constexpr const char* TickKind = "tick";
+
+    bool enabled();
+    void configure();
+
+    // Arms breakpoints in classes that were loaded before the agent (attach mode).
+    void start(jvmtiEnv* jvmti);
+    void onClassPrepare(jvmtiEnv* jvmti, jclass klass, std::string_view className);
+    void onBreakpoint(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location);
+}
+
+#endif //FRAME_CLOCK_H
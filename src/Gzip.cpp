@@ -0,0 +1,69 @@
+#include "Gzip.h"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#ifdef RYNOX_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+#ifndef RYNOX_HAVE_ZLIB
+    uint32_t crc32(const std::vector<uint8_t>& data) {
+        static const std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> entries{};
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; bit++) value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+                entries[i] = value;
+            }
+            return entries;
+        }();
+
+        uint32_t crc = 0xffffffffu;
+        for (uint8_t byte : data) crc = table[(crc ^ byte) & 0xff] ^ (crc >> 8);
+        return crc ^ 0xffffffffu;
+    }
+
+    void putLittleEndian(std::ofstream& out, uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) out.put(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+#endif
+}
+
+bool Gzip::write(const std::string& path, const std::vector<uint8_t>& data) {
+#ifdef RYNOX_HAVE_ZLIB
+    gzFile file = gzopen(path.c_str(), "wb6");
+    if (!file) return false;
+    size_t offset = 0;
+    while (offset < data.size()) {
+        unsigned chunk = static_cast<unsigned>(std::min<size_t>(data.size() - offset, 1u << 30));
+        if (gzwrite(file, data.data() + offset, chunk) != static_cast<int>(chunk)) {
+            gzclose(file);
+            return false;
+        }
+        offset += chunk;
+    }
+    return gzclose(file) == Z_OK;
+#else
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    const char header[] = {0x1f, static_cast<char>(0x8b), 8, 0, 0, 0, 0, 0, 0, 3};
+    out.write(header, sizeof(header));
+
+    size_t offset = 0;
+    do {
+        uint16_t length = static_cast<uint16_t>(std::min<size_t>(data.size() - offset, 0xffff));
+        bool last = offset + length == data.size();
+        out.put(static_cast<char>(last ? 1 : 0));
+        putLittleEndian(out, length, 2);
+        putLittleEndian(out, static_cast<uint16_t>(~length), 2);
+        out.write(reinterpret_cast<const char*>(data.data() + offset), length);
+        offset += length;
+    } while (offset < data.size());
+
+    putLittleEndian(out, crc32(data), 4);
+    putLittleEndian(out, static_cast<uint32_t>(data.size()), 4);
+    return static_cast<bool>(out);
+#endif
+}
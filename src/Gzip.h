@@ -0,0 +1,14 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes a gzip file. Uses zlib when the build found it (RYNOX_HAVE_ZLIB); otherwise emits stored
+// deflate blocks, which every gzip reader accepts, so the agent never needs zlib at runtime.
+namespace Gzip {
+    bool write(const std::string& path, const std::vector<uint8_t>& data);
+}
+
+#endif //GZIP_H
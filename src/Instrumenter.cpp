@@ -0,0 +1,684 @@
+#include "Instrumenter.h"
+#include "Bytecode.h"
+#include <algorithm>
+#include <string>
+
+namespace {
+    constexpr uint32_t Unmapped = UINT32_MAX;
+    // sipush id; invokestatic Probes.enter/exit
+    constexpr uint32_t ProbeSize = 6;
+    // See counterPrologue.
+    constexpr uint32_t CounterSize = 30;
+    constexpr uint32_t CounterStack = 5;
+    constexpr uint32_t MaxCodeLength = 65535;
+
+    struct Writer {
+        std::vector<uint8_t>& out;
+
+        void u1(uint32_t value) { out.push_back(static_cast<uint8_t>(value)); }
+        void u2(uint32_t value) { u1(value >> 8); u1(value); }
+        void u4(uint32_t value) { u2(value >> 16); u2(value); }
+        void bytes(const uint8_t* data, size_t size) { out.insert(out.end(), data, data + size); }
+        void utf8(std::string_view text) {
+            u1(JVM_CONSTANT_Utf8);
+            u2(static_cast<uint32_t>(text.size()));
+            bytes(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+        }
+        void patch2(size_t at, uint32_t value) {
+            out[at] = static_cast<uint8_t>(value >> 8);
+            out[at + 1] = static_cast<uint8_t>(value);
+        }
+        void patch4(size_t at, uint32_t value) {
+            patch2(at, value >> 16);
+            patch2(at + 2, value);
+        }
+    };
+
+    struct Reader {
+        const uint8_t* position;
+        const uint8_t* end;
+        bool ok = true;
+
+        uint32_t u1() {
+            if (position + 1 > end) return ok = false, 0;
+            return *position++;
+        }
+        uint32_t u2() {
+            if (position + 2 > end) return ok = false, 0;
+            position += 2;
+            return ClassFile::u2(position - 2);
+        }
+    };
+
+    // Constant pool indices of what the probes reference.
+    struct Pool {
+        uint16_t enter;
+        uint16_t exit;
+        uint16_t throwable;
+        uint16_t stackMapTable;
+        uint16_t counters;
+        uint16_t currentThread;
+        uint16_t threadId;
+        uint16_t longs;
+        uint16_t getAndAdd;
+        uint16_t nanos;
+        uint16_t nanoTime;
+        uint16_t code;
+    };
+
+    bool isReturn(uint8_t opcode) {
+        return opcode >= JVM_OPC_ireturn && opcode <= JVM_OPC_return;
+    }
+
+    bool isBranch(uint8_t opcode) {
+        return (opcode >= JVM_OPC_ifeq && opcode <= JVM_OPC_jsr) || opcode == JVM_OPC_ifnull || opcode == JVM_OPC_ifnonnull ||
+               opcode == JVM_OPC_goto_w || opcode == JVM_OPC_jsr_w;
+    }
+
+    bool isSwitch(uint8_t opcode) {
+        return opcode == JVM_OPC_tableswitch || opcode == JVM_OPC_lookupswitch;
+    }
+
+    // Zero bytes between a switch opcode and its 4-byte aligned operands.
+    uint32_t switchPadding(uint32_t bci) {
+        return (4 - (bci + 1) % 4) % 4;
+    }
+
+    // Index just past the field type starting at descriptor[i], or npos when it is malformed.
+    size_t skipType(std::string_view descriptor, size_t i) {
+        while (i < descriptor.size() && descriptor[i] == '[') i++;
+        if (i >= descriptor.size()) return std::string_view::npos;
+        if (descriptor[i] != 'L') return i + 1;
+        size_t end = descriptor.find(';', i);
+        return end == std::string_view::npos ? end : end + 1;
+    }
+
+    // Slots of a method descriptor's parameters, or -1 when it cannot be read.
+    int32_t parameterSlots(std::string_view descriptor) {
+        if (descriptor.empty() || descriptor[0] != '(') return -1;
+        int32_t slots = 0;
+        size_t i = 1;
+        while (i < descriptor.size() && descriptor[i] != ')') {
+            slots += descriptor[i] == 'J' || descriptor[i] == 'D' ? 2 : 1;
+            i = skipType(descriptor, i);
+        }
+        return i < descriptor.size() - 1 ? slots : -1;
+    }
+
+    // Typed load, store and return opcodes for a field descriptor character.
+    uint8_t loadOpcode(char type) {
+        switch (type) {
+            case 'J': return JVM_OPC_lload;
+            case 'F': return JVM_OPC_fload;
+            case 'D': return JVM_OPC_dload;
+            case 'L': case '[': return JVM_OPC_aload;
+            default: return JVM_OPC_iload;
+        }
+    }
+
+    uint8_t returnOpcode(char type) {
+        switch (type) {
+            case 'V': return JVM_OPC_return;
+            case 'J': return JVM_OPC_lreturn;
+            case 'F': return JVM_OPC_freturn;
+            case 'D': return JVM_OPC_dreturn;
+            case 'L': case '[': return JVM_OPC_areturn;
+            default: return JVM_OPC_ireturn;
+        }
+    }
+
+    void local(Writer& w, uint8_t opcode, uint32_t slot) {
+        w.u1(opcode);
+        w.u1(slot);
+    }
+
+    // counterOffset leaves (stripe of the current thread << stripe shift | id << 3) on the stack, with
+    // the stripe Thread.currentThread().getId() & (stripes - 1).
+    void counterOffset(Writer& w, const Pool& pool, int32_t id, size_t base, std::vector<Instrumenter::ProbeSite>* sites) {
+        w.u1(JVM_OPC_invokestatic), w.u2(pool.currentThread);
+        w.u1(JVM_OPC_invokevirtual), w.u2(pool.threadId);
+        w.u1(JVM_OPC_l2i);
+        w.u1(JVM_OPC_bipush), w.u1(Instrumenter::CounterStripes - 1);
+        w.u1(JVM_OPC_iand);
+        w.u1(JVM_OPC_bipush), w.u1(Instrumenter::CounterStripeShift);
+        w.u1(JVM_OPC_ishl);
+        w.u1(JVM_OPC_sipush);
+        if (sites) sites->push_back({static_cast<uint32_t>(w.out.size() - base), id});
+        w.u2(static_cast<uint32_t>(id));
+        w.u1(JVM_OPC_iconst_3);
+        w.u1(JVM_OPC_ishl);
+        w.u1(JVM_OPC_ior);
+    }
+
+    // The Java side of a wrapped native, as a complete method_info with the native's own attributes.
+    bool writeNativeWrapper(Writer& w, ClassFile& classFile, const ClassFile::Member& method, uint16_t target, int32_t id,
+                            const Pool& pool, size_t base, std::vector<Instrumenter::ProbeSite>* sites) {
+        bool isStatic = method.accessFlags & JVM_ACC_STATIC;
+        int32_t parameters = parameterSlots(method.descriptor);
+        if (parameters < 0) return false;
+        uint32_t start = parameters + (isStatic ? 0 : 1);
+        uint32_t offset = start + 2;
+        if (offset > 255) return false;
+        char returnType = method.descriptor[method.descriptor.find(')') + 1];
+
+        const uint8_t* header = classFile.data() + method.start;
+        w.u2(method.accessFlags & ~JVM_ACC_NATIVE);
+        w.bytes(header + 2, 4);
+        w.u2(ClassFile::u2(header + 6) + 1u);
+        classFile.forEachAttribute(method.attributes, [&](const ClassFile::Attribute& attribute) {
+            w.bytes(attribute.data - 6, attribute.length + 6);
+            return true;
+        });
+
+        w.u2(pool.code);
+        size_t lengthAt = w.out.size();
+        w.u4(0);
+        // Room for the arguments, or for a wide result under handle, buffer, offset and two longs.
+        w.u2(std::max<uint32_t>(start, 9));
+        w.u2(offset + 1);
+        size_t codeLengthAt = w.out.size();
+        w.u4(0);
+
+        w.u1(JVM_OPC_invokestatic), w.u2(pool.nanoTime);
+        local(w, JVM_OPC_lstore, start);
+        counterOffset(w, pool, id, base, sites);
+        local(w, JVM_OPC_istore, offset);
+
+        if (!isStatic) local(w, JVM_OPC_aload, 0);
+        uint32_t slot = isStatic ? 0 : 1;
+        for (size_t i = 1; method.descriptor[i] != ')'; i = skipType(method.descriptor, i)) {
+            char type = method.descriptor[i];
+            local(w, loadOpcode(type), slot);
+            slot += type == 'J' || type == 'D' ? 2 : 1;
+        }
+        w.u1(isStatic ? JVM_OPC_invokestatic : JVM_OPC_invokespecial), w.u2(target);
+
+        // longs.getAndAdd(counters, offset, 1L); longs.getAndAdd(nanos, offset, System.nanoTime() - start),
+        // with any result kept below.
+        w.u1(JVM_OPC_getstatic), w.u2(pool.longs);
+        w.u1(JVM_OPC_getstatic), w.u2(pool.counters);
+        local(w, JVM_OPC_iload, offset);
+        w.u1(JVM_OPC_lconst_1);
+        w.u1(JVM_OPC_invokevirtual), w.u2(pool.getAndAdd);
+        w.u1(JVM_OPC_pop2);
+        w.u1(JVM_OPC_getstatic), w.u2(pool.longs);
+        w.u1(JVM_OPC_getstatic), w.u2(pool.nanos);
+        local(w, JVM_OPC_iload, offset);
+        w.u1(JVM_OPC_invokestatic), w.u2(pool.nanoTime);
+        local(w, JVM_OPC_lload, start);
+        w.u1(JVM_OPC_lsub);
+        w.u1(JVM_OPC_invokevirtual), w.u2(pool.getAndAdd);
+        w.u1(JVM_OPC_pop2);
+        w.u1(returnOpcode(returnType));
+
+        w.patch4(codeLengthAt, static_cast<uint32_t>(w.out.size() - codeLengthAt - 4));
+        w.u2(0);
+        w.u2(0);
+        w.patch4(lengthAt, static_cast<uint32_t>(w.out.size() - lengthAt - 4));
+        return true;
+    }
+
+    class CodeRewriter {
+    public:
+        CodeRewriter(const ClassFile::Code& code, Instrumenter::Selection selection, const Pool& pool, std::vector<uint8_t>& out,
+                     size_t base, std::vector<Instrumenter::ProbeSite>* sites)
+            : code(code), id(selection.id), counting(selection.count), prologue(counting ? CounterSize : ProbeSize), pool(pool), w{out},
+              base(base), sites(sites), offsets(code.length + 1, Unmapped) {}
+
+        // Writes the whole Code attribute; false (with partial output) when the method cannot be rewritten.
+        bool write(ClassFile& classFile, uint16_t nameIndex, bool stackMaps) {
+            if (!layout()) return false;
+
+            w.u2(nameIndex);
+            size_t lengthAt = w.out.size();
+            w.u4(0);
+            // The counter prologue runs on an empty stack. The exit probe's int goes on top of whatever a
+            // return leaves; the handler holds the exception and the id.
+            uint32_t maxStack = counting ? std::max<uint32_t>(code.maxStack, CounterStack) : std::max<uint32_t>(code.maxStack + 1u, 2);
+            w.u2(std::min<uint32_t>(maxStack, 0xffff));
+            w.u2(code.maxLocals);
+            w.u4(codeLength());
+            size_t codeStart = w.out.size();
+            if (!emitCode() || w.out.size() - codeStart != codeLength()) return false;
+            if (!emitExceptionTable()) return false;
+
+            size_t countAt = w.out.size();
+            uint32_t count = 0;
+            bool ok = true, sawStackMap = false;
+            w.u2(0);
+            classFile.forEachAttribute(code.attributes, [&](const ClassFile::Attribute& attribute) {
+                uint16_t attributeName = ClassFile::u2(attribute.data - 6);
+                if (attribute.name == "StackMapTable") {
+                    ok = stackMaps && stackMapTable(attribute, attributeName);
+                    sawStackMap = true;
+                } else if (attribute.name == "LineNumberTable") {
+                    ok = lineNumberTable(attribute, attributeName);
+                } else if (attribute.name == "LocalVariableTable" || attribute.name == "LocalVariableTypeTable") {
+                    ok = localVariableTable(attribute, attributeName);
+                } else if (attribute.name == "RuntimeVisibleTypeAnnotations" || attribute.name == "RuntimeInvisibleTypeAnnotations") {
+                    // Their targets carry bytecode offsets; they are dropped rather than relocated.
+                    return true;
+                } else {
+                    w.bytes(attribute.data - 6, attribute.length + 6);
+                }
+                count++;
+                return ok;
+            });
+            if (!ok) return false;
+            if (stackMaps && !sawStackMap && !counting) {
+                Attribute table(w, pool.stackMapTable, 1);
+                handlerFrame(-1);
+                table.finish();
+                count++;
+            }
+            w.patch2(countAt, count);
+            w.patch4(lengthAt, static_cast<uint32_t>(w.out.size() - lengthAt - 4));
+            return true;
+        }
+
+    private:
+        // Attribute header with its length (and entry count) patched once the body is written.
+        struct Attribute {
+            Writer& w;
+            size_t lengthAt;
+
+            Attribute(Writer& w, uint16_t name, uint32_t count) : w(w) {
+                w.u2(name);
+                lengthAt = w.out.size();
+                w.u4(0);
+                w.u2(count);
+            }
+            void finish() { w.patch4(lengthAt, static_cast<uint32_t>(w.out.size() - lengthAt - 4)); }
+        };
+
+        // Assigns every original instruction its new offset; a return's offset is that of its exit probe,
+        // so branches to the return run the probe too.
+        bool layout() {
+            uint32_t position = prologue;
+            Bytecode::Iterator iterator(code.code, code.length);
+            Bytecode::Instruction instruction{};
+            while (iterator.next(instruction)) {
+                offsets[instruction.bci] = position;
+                if (!counting && !instruction.wide && isReturn(instruction.opcode)) position += ProbeSize;
+                uint32_t length = instruction.length;
+                if (!instruction.wide && isSwitch(instruction.opcode)) length = length - switchPadding(instruction.bci) + switchPadding(position);
+                position += length;
+            }
+            if (iterator.failed()) return false;
+            offsets[code.length] = position;
+            handler = position;
+            return codeLength() <= MaxCodeLength;
+        }
+
+        // Counted methods have no handler after their code.
+        uint32_t codeLength() const {
+            return counting ? handler : handler + ProbeSize + 1;
+        }
+
+        uint32_t relocate(uint32_t bci) const {
+            return bci <= code.length ? offsets[bci] : Unmapped;
+        }
+
+        uint32_t relocateBranch(uint32_t bci, int32_t offset) const {
+            int64_t target = static_cast<int64_t>(bci) + offset;
+            return target >= 0 && target < code.length ? offsets[target] : Unmapped;
+        }
+
+        void probe(uint16_t method) {
+            w.u1(JVM_OPC_sipush);
+            if (sites) sites->push_back({static_cast<uint32_t>(w.out.size() - base), id});
+            w.u2(static_cast<uint32_t>(id));
+            w.u1(JVM_OPC_invokestatic);
+            w.u2(method);
+        }
+
+        // longs.getAndAdd(counters, offset, 1L) at the thread's counterOffset.
+        void counterPrologue() {
+            w.u1(JVM_OPC_getstatic), w.u2(pool.longs);
+            w.u1(JVM_OPC_getstatic), w.u2(pool.counters);
+            counterOffset(w, pool, id, base, sites);
+            w.u1(JVM_OPC_lconst_1);
+            w.u1(JVM_OPC_invokevirtual), w.u2(pool.getAndAdd);
+            w.u1(JVM_OPC_pop2);
+        }
+
+        bool emitCode() {
+            if (counting) counterPrologue();
+            else probe(pool.enter);
+            Bytecode::Iterator iterator(code.code, code.length);
+            Bytecode::Instruction instruction{};
+            while (iterator.next(instruction)) {
+                uint32_t position = offsets[instruction.bci];
+                uint8_t opcode = instruction.opcode;
+                if (instruction.wide) {
+                    w.bytes(instruction.bytes, instruction.length);
+                } else if (isReturn(opcode) && !counting) {
+                    probe(pool.exit);
+                    w.u1(opcode);
+                } else if (isBranch(opcode)) {
+                    bool wideOffset = opcode == JVM_OPC_goto_w || opcode == JVM_OPC_jsr_w;
+                    uint32_t target = relocateBranch(instruction.bci, wideOffset ? instruction.s4(1) : instruction.s2(1));
+                    if (target == Unmapped) return false;
+                    int64_t delta = static_cast<int64_t>(target) - position;
+                    w.u1(opcode);
+                    if (wideOffset) {
+                        w.u4(static_cast<uint32_t>(delta));
+                    } else {
+                        if (delta < INT16_MIN || delta > INT16_MAX) return false;
+                        w.u2(static_cast<uint32_t>(delta));
+                    }
+                } else if (isSwitch(opcode)) {
+                    w.u1(opcode);
+                    for (uint32_t i = switchPadding(position); i > 0; i--) w.u1(0);
+                    uint32_t operands = 1 + switchPadding(instruction.bci);
+                    auto branch = [&](uint32_t at) {
+                        uint32_t target = relocateBranch(instruction.bci, instruction.s4(at));
+                        if (target == Unmapped) return false;
+                        w.u4(target - position);
+                        return true;
+                    };
+                    if (!branch(operands)) return false;
+                    if (opcode == JVM_OPC_tableswitch) {
+                        int32_t low = instruction.s4(operands + 4), high = instruction.s4(operands + 8);
+                        w.u4(static_cast<uint32_t>(low));
+                        w.u4(static_cast<uint32_t>(high));
+                        for (int64_t i = 0; i <= static_cast<int64_t>(high) - low; i++) {
+                            if (!branch(operands + 12 + static_cast<uint32_t>(i) * 4)) return false;
+                        }
+                    } else {
+                        int32_t pairs = instruction.s4(operands + 4);
+                        w.u4(static_cast<uint32_t>(pairs));
+                        for (int32_t i = 0; i < pairs; i++) {
+                            w.u4(static_cast<uint32_t>(instruction.s4(operands + 8 + i * 8)));
+                            if (!branch(operands + 12 + i * 8)) return false;
+                        }
+                    }
+                } else {
+                    w.bytes(instruction.bytes, instruction.length);
+                }
+            }
+            if (iterator.failed()) return false;
+            if (counting) return true;
+
+            // Catch-all handler: the exception is on the stack and stays there across the exit call.
+            probe(pool.exit);
+            w.u1(JVM_OPC_athrow);
+            return true;
+        }
+
+        bool emitExceptionTable() {
+            w.u2(code.exceptionCount + (counting ? 0u : 1u));
+            for (uint16_t i = 0; i < code.exceptionCount; i++) {
+                const uint8_t* entry = code.exceptionTable + i * 8;
+                uint32_t start = relocate(ClassFile::u2(entry)), end = relocate(ClassFile::u2(entry + 2));
+                uint32_t target = relocate(ClassFile::u2(entry + 4));
+                if (start == Unmapped || end == Unmapped || target == Unmapped) return false;
+                w.u2(start);
+                w.u2(end);
+                w.u2(target);
+                w.u2(ClassFile::u2(entry + 6));
+            }
+            if (counting) return true;
+            // Last, so the method's own handlers keep precedence.
+            w.u2(ProbeSize);
+            w.u2(handler);
+            w.u2(handler);
+            w.u2(0);
+            return true;
+        }
+
+        bool verificationType(Reader& in) {
+            uint32_t tag = in.u1();
+            w.u1(tag);
+            if (tag == JVM_ITEM_Object) {
+                w.u2(in.u2());
+            } else if (tag == JVM_ITEM_Uninitialized) {
+                uint32_t offset = relocate(in.u2());
+                if (offset == Unmapped) return false;
+                w.u2(offset);
+            } else if (tag > JVM_ITEM_Uninitialized) {
+                return false;
+            }
+            return in.ok;
+        }
+
+        bool verificationTypes(Reader& in, uint32_t count) {
+            for (uint32_t i = 0; i < count; i++) {
+                if (!verificationType(in)) return false;
+            }
+            return true;
+        }
+
+        // Every local reads as top in the handler, which only needs the exception.
+        void handlerFrame(int64_t previous) {
+            w.u1(255);
+            w.u2(static_cast<uint32_t>(handler - previous - 1));
+            w.u2(0);
+            w.u2(1);
+            w.u1(JVM_ITEM_Object);
+            w.u2(pool.throwable);
+        }
+
+        bool stackMapTable(const ClassFile::Attribute& attribute, uint16_t name) {
+            Reader in{attribute.data, attribute.data + attribute.length};
+            uint32_t frames = in.u2();
+            Attribute table(w, name, frames + 1);
+            int64_t previous = -1, newPrevious = -1;
+            for (uint32_t i = 0; i < frames && in.ok; i++) {
+                uint32_t type = in.u1();
+                uint32_t delta = type < 128 ? type % 64 : type >= 247 ? in.u2() : 0;
+                if (type >= 128 && type < 247) return false;
+                int64_t offset = previous + delta + 1;
+                uint32_t newOffset = offset <= code.length ? relocate(static_cast<uint32_t>(offset)) : Unmapped;
+                if (newOffset == Unmapped) return false;
+                uint32_t newDelta = static_cast<uint32_t>(newOffset - newPrevious - 1);
+                previous = offset;
+                newPrevious = newOffset;
+
+                if (type < 64 || type == 251) {
+                    if (newDelta < 64) w.u1(newDelta);
+                    else w.u1(251), w.u2(newDelta);
+                } else if (type < 128 || type == 247) {
+                    if (newDelta < 64) w.u1(64 + newDelta);
+                    else w.u1(247), w.u2(newDelta);
+                    if (!verificationType(in)) return false;
+                } else {
+                    w.u1(type);
+                    w.u2(newDelta);
+                    if (type > 251 && type < 255 && !verificationTypes(in, type - 251)) return false;
+                    if (type == 255) {
+                        uint32_t locals = in.u2();
+                        w.u2(locals);
+                        if (!verificationTypes(in, locals)) return false;
+                        uint32_t stack = in.u2();
+                        w.u2(stack);
+                        if (!verificationTypes(in, stack)) return false;
+                    }
+                }
+            }
+            if (!in.ok) return false;
+            if (counting) w.patch2(table.lengthAt + 4, frames);
+            else handlerFrame(newPrevious);
+            table.finish();
+            return true;
+        }
+
+        bool lineNumberTable(const ClassFile::Attribute& attribute, uint16_t name) {
+            Reader in{attribute.data, attribute.data + attribute.length};
+            uint32_t entries = in.u2();
+            Attribute table(w, name, entries);
+            for (uint32_t i = 0; i < entries; i++) {
+                uint32_t start = relocate(in.u2());
+                if (start == Unmapped) return false;
+                w.u2(start);
+                w.u2(in.u2());
+            }
+            table.finish();
+            return in.ok;
+        }
+
+        bool localVariableTable(const ClassFile::Attribute& attribute, uint16_t name) {
+            Reader in{attribute.data, attribute.data + attribute.length};
+            uint32_t entries = in.u2();
+            Attribute table(w, name, entries);
+            for (uint32_t i = 0; i < entries; i++) {
+                uint32_t oldStart = in.u2(), oldLength = in.u2();
+                uint32_t start = relocate(oldStart), end = relocate(oldStart + oldLength);
+                if (start == Unmapped || end == Unmapped) return false;
+                w.u2(start);
+                w.u2(end - start);
+                w.u2(in.u2());
+                w.u2(in.u2());
+                w.u2(in.u2());
+            }
+            table.finish();
+            return in.ok;
+        }
+
+        const ClassFile::Code& code;
+        int32_t id;
+        bool counting;
+        uint32_t prologue;
+        const Pool& pool;
+        Writer w;
+        size_t base;
+        std::vector<Instrumenter::ProbeSite>* sites;
+        std::vector<uint32_t> offsets;
+        uint32_t handler = 0;
+    };
+}
+
+bool Instrumenter::rewrite(ClassFile& classFile, const Selector& select, std::vector<uint8_t>& out, std::vector<ProbeSite>* sites) {
+    uint16_t poolCount = classFile.constantPoolCount();
+    if (poolCount == 0 || poolCount > 0xffff - 64) return false;
+
+    std::vector<Selection> selections;
+    bool selected = false;
+    classFile.forEachMethod([&](const ClassFile::Member& method) {
+        Selection selection;
+        bool isNative = method.accessFlags & JVM_ACC_NATIVE;
+        bool wrappable = isNative && !(classFile.accessFlags() & JVM_ACC_INTERFACE);
+        if ((wrappable || !(method.accessFlags & (JVM_ACC_ABSTRACT | JVM_ACC_NATIVE))) && method.name != "<init>" && method.name != "<clinit>") {
+            selection = select(method.name, method.descriptor, isNative);
+        }
+        if (selection.id > (selection.count || isNative ? static_cast<int32_t>(MaxCounters) - 1 : MaxProbeId)) selection.id = -1;
+        selected |= selection.id >= 0;
+        selections.push_back(selection);
+        return true;
+    });
+    if (!selected) return false;
+
+    const uint8_t* bytes = classFile.data();
+    size_t base = out.size();
+    size_t siteBase = sites ? sites->size() : 0;
+    Writer w{out};
+    w.bytes(bytes, 8);
+    w.u2(0);
+    w.bytes(bytes + 10, classFile.classInfo() - 10);
+
+    // Appended after the class's own constants; duplicates of existing entries are harmless.
+    uint16_t next = poolCount;
+    auto utf8 = [&](std::string_view text) {
+        w.utf8(text);
+        return next++;
+    };
+    auto classRef = [&](std::string_view name) {
+        uint16_t nameIndex = utf8(name);
+        w.u1(JVM_CONSTANT_Class), w.u2(nameIndex);
+        return next++;
+    };
+    auto memberRef = [&](uint8_t tag, uint16_t owner, std::string_view name, std::string_view descriptor) {
+        uint16_t nameIndex = utf8(name), descriptorIndex = utf8(descriptor);
+        w.u1(JVM_CONSTANT_NameAndType), w.u2(nameIndex), w.u2(descriptorIndex);
+        uint16_t nameAndType = next++;
+        w.u1(tag), w.u2(owner), w.u2(nameAndType);
+        return next++;
+    };
+    Pool pool{};
+    uint16_t probeClass = classRef(ProbeClass);
+    uint16_t threadClass = classRef("java/lang/Thread");
+    pool.enter = memberRef(JVM_CONSTANT_Methodref, probeClass, EnterMethod, ProbeDescriptor);
+    pool.exit = memberRef(JVM_CONSTANT_Methodref, probeClass, ExitMethod, ProbeDescriptor);
+    pool.throwable = classRef("java/lang/Throwable");
+    pool.stackMapTable = utf8("StackMapTable");
+    pool.counters = memberRef(JVM_CONSTANT_Fieldref, probeClass, CounterField, "Ljava/nio/ByteBuffer;");
+    pool.currentThread = memberRef(JVM_CONSTANT_Methodref, threadClass, "currentThread", "()Ljava/lang/Thread;");
+    pool.threadId = memberRef(JVM_CONSTANT_Methodref, threadClass, "getId", "()J");
+    pool.longs = memberRef(JVM_CONSTANT_Fieldref, probeClass, HandleField, "Ljava/lang/invoke/VarHandle;");
+    // Signature polymorphic: the descriptor is the call site's own.
+    pool.getAndAdd = memberRef(JVM_CONSTANT_Methodref, classRef("java/lang/invoke/VarHandle"), "getAndAdd", "(Ljava/nio/ByteBuffer;IJ)J");
+    pool.nanos = memberRef(JVM_CONSTANT_Fieldref, probeClass, NanosField, "Ljava/nio/ByteBuffer;");
+    pool.nanoTime = memberRef(JVM_CONSTANT_Methodref, classRef("java/lang/System"), "nanoTime", "()J");
+    pool.code = utf8("Code");
+
+    // Renamed natives: name, and a Methodref the wrapper calls.
+    uint16_t thisClass = ClassFile::u2(bytes + classFile.classInfo() + 2);
+    std::vector<std::pair<uint16_t, uint16_t>> natives(selections.size());
+    size_t nativeIndex = 0;
+    classFile.forEachMethod([&](const ClassFile::Member& method) {
+        auto& [name, target] = natives[nativeIndex];
+        if (selections[nativeIndex++].id < 0 || !(method.accessFlags & JVM_ACC_NATIVE)) return true;
+        if (next > 0xffff - 8) return false;
+        std::string renamed = std::string(NativePrefix) + std::string(method.name);
+        name = utf8(renamed);
+        w.u1(JVM_CONSTANT_NameAndType), w.u2(name), w.u2(ClassFile::u2(bytes + method.start + 4));
+        uint16_t nameAndType = next++;
+        w.u1(JVM_CONSTANT_Methodref), w.u2(thisClass), w.u2(nameAndType);
+        target = next++;
+        return true;
+    });
+    w.patch2(base + 8, next);
+    bool stackMaps = classFile.majorVersion() >= 50;
+
+    w.bytes(bytes + classFile.classInfo(), classFile.methodTable() - classFile.classInfo());
+    size_t methodCountAt = out.size();
+    w.u2(classFile.methodCount());
+    size_t index = 0;
+    bool changed = false;
+    std::vector<size_t> wrapped;
+    classFile.forEachMethod([&](const ClassFile::Member& method) {
+        Selection selection = selections[index++];
+        size_t mark = out.size();
+        size_t siteMark = sites ? sites->size() : 0;
+        bool rewritten = selection.id >= 0;
+        if (rewritten && (method.accessFlags & JVM_ACC_NATIVE)) {
+            rewritten = natives[index - 1].second && writeNativeWrapper(w, classFile, method, natives[index - 1].second, selection.id, pool, base, sites);
+            if (rewritten) wrapped.push_back(index - 1);
+        } else if (rewritten) {
+            ClassFile::Code code{};
+            rewritten = classFile.code(method, code);
+            w.bytes(bytes + method.start, 8);
+            classFile.forEachAttribute(method.attributes, [&](const ClassFile::Attribute& attribute) {
+                if (attribute.name != "Code") w.bytes(attribute.data - 6, attribute.length + 6);
+                else if (rewritten) rewritten = CodeRewriter(code, selection, pool, out, base, sites).write(classFile, ClassFile::u2(attribute.data - 6), stackMaps);
+                return rewritten;
+            });
+        }
+        if (rewritten) {
+            changed = true;
+        } else {
+            out.resize(mark);
+            if (sites) sites->resize(siteMark);
+            w.bytes(bytes + method.start, method.end - method.start);
+        }
+        return true;
+    });
+    // The renamed natives go after every original method.
+    index = 0;
+    classFile.forEachMethod([&](const ClassFile::Member& method) {
+        if (std::find(wrapped.begin(), wrapped.end(), index++) == wrapped.end()) return true;
+        w.u2((method.accessFlags & JVM_ACC_STATIC) | JVM_ACC_PRIVATE | JVM_ACC_FINAL | JVM_ACC_NATIVE | JVM_ACC_SYNTHETIC);
+        w.u2(natives[index - 1].first);
+        w.bytes(bytes + method.start + 4, 2);
+        w.u2(0);
+        return true;
+    });
+    w.patch2(methodCountAt, classFile.methodCount() + static_cast<uint32_t>(wrapped.size()));
+    w.bytes(bytes + classFile.classAttributes(), classFile.size() - classFile.classAttributes());
+
+    if (!changed) {
+        out.resize(base);
+        if (sites) sites->resize(siteBase);
+    }
+    return changed;
+}
@@ -0,0 +1,70 @@
+#ifndef INSTRUMENTER_H
+#define INSTRUMENTER_H
+
+#include "ClassFile.h"
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+// Bytecode rewriter behind the method probes. A selected method gets "sipush id; invokestatic
+// rynox/Probes.enter(I)V" in front of its code, the matching exit call in front of every return,
+// and a catch-all handler at the end that calls exit and rethrows, so each entry is paired with
+// exactly one exit. Branches, switches (whose padding moves), the exception table, line and local
+// variable tables are relocated; StackMapTable frames are re-encoded at their new offsets, with
+// uninitialized types relocated and a frame added for the handler, and max_stack grows by the probe's
+// slot. Constructors and class initializers are left alone: the handler cannot cover code that runs
+// before the superclass constructor. A method whose branches would no longer fit, or whose code would
+// exceed 64 KiB, is skipped rather than widened.
+//
+// A counted method only gets a prologue that increments its slot in rynox/Probes.counters, a direct
+// ByteBuffer over native memory: the slot is in the stripe picked by the calling thread's id, so
+// threads mostly bump different cache lines and nothing is locked or called; readers sum the stripes.
+// The increment is getAndAdd through rynox/Probes.longs, a static final byteBufferViewVarHandle that
+// the JIT folds into one atomic add, so threads whose ids share a stripe still count exactly.
+//
+// A selected native method cannot be rewritten, so it is wrapped instead, which needs the agent's
+// native method prefix to be set: the native is renamed to rynox$<name> (private, still native, and
+// linked to the same symbol through the prefix) and a Java method with the original name, flags and
+// attributes calls it between two System.nanoTime() reads, adding one to its slot in counters and the
+// elapsed nanoseconds to the same slot in nanos, both through longs like the counted prologue. Adding
+// methods is only allowed at load, so wrapping is not undone by retransformation.
+namespace Instrumenter {
+    inline constexpr const char* ProbeClass = "rynox/Probes";
+    inline constexpr const char* EnterMethod = "enter";
+    inline constexpr const char* ExitMethod = "exit";
+    inline constexpr const char* ProbeDescriptor = "(I)V";
+    inline constexpr const char* CounterField = "counters";
+    inline constexpr const char* NanosField = "nanos";
+    // MethodHandles.byteBufferViewVarHandle(long[].class, nativeOrder) over both buffers.
+    inline constexpr const char* HandleField = "longs";
+    inline constexpr const char* NativePrefix = "rynox$";
+    // Probe ids are pushed with sipush.
+    inline constexpr int32_t MaxProbeId = 32767;
+    // The counter buffer holds CounterStripes stripes of MaxCounters longs; counted ids stay below MaxCounters.
+    inline constexpr uint32_t CounterStripes = 64;
+    inline constexpr uint32_t MaxCounters = 2048;
+    inline constexpr uint32_t CounterStripeShift = 14;
+    static_assert(MaxCounters * sizeof(int64_t) == 1u << CounterStripeShift);
+
+    struct Selection {
+        // Probe id, or -1 to leave the method alone.
+        int32_t id = -1;
+        bool count = false;
+    };
+
+    // Decides what a method (name, descriptor) gets; a selected native is wrapped, with id as its counter slot.
+    using Selector = std::function<Selection(std::string_view name, std::string_view descriptor, bool isNative)>;
+
+    // Where a probe id was written: offset of the sipush operand, relative to the start of the class.
+    struct ProbeSite {
+        uint32_t offset;
+        int32_t id;
+    };
+
+    // Appends the rewritten class to "out"; false when no method was instrumented. "sites", when given,
+    // receives every id operand so a cached copy of the class can be renumbered without parsing it.
+    bool rewrite(ClassFile& classFile, const Selector& select, std::vector<uint8_t>& out, std::vector<ProbeSite>* sites = nullptr);
+}
+
+#endif //INSTRUMENTER_H
@@ -0,0 +1,343 @@
+#include "Mappings.h"
+#include "Options.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    constexpr uint32_t NotFound = UINT32_MAX;
+
+    struct MappedClass {
+        // Dotted Java names, as in the file.
+        std::string_view name;
+        std::string_view obfuscated;
+    };
+
+    struct MappedMember {
+        uint32_t owner;
+        bool method;
+        std::string_view name;
+        std::string_view obfuscated;
+        // Java types from the file: the field or return type, and a method's comma-separated arguments.
+        std::string_view type;
+        std::string_view arguments;
+        // Ranges of descriptors.
+        uint32_t descriptor = 0;
+        uint32_t descriptorLength = 0;
+        uint32_t obfuscatedDescriptor = 0;
+        uint32_t obfuscatedLength = 0;
+    };
+
+    // Open addressing over entry numbers. Keys are not stored; find() checks candidates with the caller's equality.
+    class Index {
+    public:
+        void reserve(size_t count) {
+            slots.assign(std::bit_ceil(std::max<size_t>(count * 2, 16)), Slot{0, NotFound});
+        }
+
+        void insert(uint64_t hash, uint32_t entry) {
+            size_t mask = slots.size() - 1;
+            size_t i = hash & mask;
+            while (slots[i].entry != NotFound) i = (i + 1) & mask;
+            slots[i] = {hash, entry};
+        }
+
+        template <typename Equal>
+        uint32_t find(uint64_t hash, Equal&& equal) const {
+            if (slots.empty()) return NotFound;
+            size_t mask = slots.size() - 1;
+            for (size_t i = hash & mask;; i = (i + 1) & mask) {
+                const Slot& slot = slots[i];
+                if (slot.entry == NotFound) return NotFound;
+                if (slot.hash == hash && equal(slot.entry)) return slot.entry;
+            }
+        }
+
+    private:
+        struct Slot {
+            uint64_t hash;
+            uint32_t entry;
+        };
+        std::vector<Slot> slots;
+    };
+
+    bool loaded = false;
+    std::vector<MappedClass> classes;
+    std::vector<MappedMember> members;
+    // JVM descriptors of the members, deobfuscated and obfuscated.
+    std::string descriptors;
+    Index classByName;
+    Index classByObfuscated;
+    Index memberByName;
+    Index memberByObfuscated;
+
+    // '.' and '/' hash and compare alike, so internal names are looked up against the dotted file.
+    uint64_t hashName(std::string_view text, uint64_t hash = 14695981039346656037ull) {
+        for (char c : text) hash = (hash ^ static_cast<uint8_t>(c == '.' ? '/' : c)) * 1099511628211ull;
+        return hash;
+    }
+
+    bool sameName(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return x == y || ((x == '.' || x == '/') && (y == '.' || y == '/'));
+        });
+    }
+
+    std::string internalName(std::string_view name) {
+        std::string out(name);
+        std::replace(out.begin(), out.end(), '.', '/');
+        return out;
+    }
+
+    uint64_t memberHash(uint32_t owner, bool method, std::string_view name, std::string_view descriptor) {
+        uint64_t hash = hashName(name, (owner + 1ull) * 0x9E3779B97F4A7C15ull + method);
+        return hashName(descriptor, (hash ^ 0xff) * 1099511628211ull);
+    }
+
+    uint32_t findClass(const Index& index, std::string_view name, bool obfuscated) {
+        return index.find(hashName(name), [&](uint32_t i) { return sameName(obfuscated ? classes[i].obfuscated : classes[i].name, name); });
+    }
+
+    std::string_view descriptorOf(const MappedMember& member, bool obfuscated) {
+        return std::string_view(descriptors).substr(obfuscated ? member.obfuscatedDescriptor : member.descriptor,
+                                                    obfuscated ? member.obfuscatedLength : member.descriptorLength);
+    }
+
+    uint32_t findMember(uint32_t owner, bool method, std::string_view name, std::string_view descriptor, bool obfuscated) {
+        const Index& index = obfuscated ? memberByObfuscated : memberByName;
+        return index.find(memberHash(owner, method, name, descriptor), [&](uint32_t i) {
+            const MappedMember& member = members[i];
+            return member.owner == owner && member.method == method && (obfuscated ? member.obfuscated : member.name) == name &&
+                   (descriptor.empty() || descriptorOf(member, obfuscated) == descriptor);
+        });
+    }
+
+    std::string_view trim(std::string_view text) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+        return text;
+    }
+
+    // A Java type ("int", "java.lang.String[]") as a descriptor, its classes renamed to the obfuscated side when asked.
+    void appendType(std::string& out, std::string_view type, bool obfuscate) {
+        static constexpr std::pair<std::string_view, char> Primitives[] = {
+            {"void", 'V'}, {"boolean", 'Z'}, {"byte", 'B'}, {"char", 'C'}, {"short", 'S'},
+            {"int", 'I'}, {"long", 'J'}, {"float", 'F'}, {"double", 'D'},
+        };
+        type = trim(type);
+        while (type.size() >= 2 && type.substr(type.size() - 2) == "[]") {
+            out += '[';
+            type.remove_suffix(2);
+        }
+        for (const auto& [name, code] : Primitives) {
+            if (name == type) {
+                out += code;
+                return;
+            }
+        }
+        uint32_t mapped = obfuscate ? findClass(classByName, type, false) : NotFound;
+        out += 'L';
+        for (char c : mapped != NotFound ? classes[mapped].obfuscated : type) out += c == '.' ? '/' : c;
+        out += ';';
+    }
+
+    void appendDescriptor(std::string& out, const MappedMember& member, bool obfuscate) {
+        if (!member.method) return appendType(out, member.type, obfuscate);
+        out += '(';
+        for (std::string_view arguments = member.arguments; !trim(arguments).empty();) {
+            size_t comma = arguments.find(',');
+            appendType(out, arguments.substr(0, comma), obfuscate);
+            arguments = comma == std::string_view::npos ? std::string_view() : arguments.substr(comma + 1);
+        }
+        out += ')';
+        appendType(out, member.type, obfuscate);
+    }
+
+    // Renames the classes of a JVM descriptor through the class indexes.
+    std::string translateDescriptor(std::string_view descriptor, bool toObfuscated) {
+        std::string out;
+        for (size_t i = 0; i < descriptor.size(); i++) {
+            out += descriptor[i];
+            if (descriptor[i] != 'L') continue;
+            size_t end = descriptor.find(';', i);
+            if (end == std::string_view::npos) return std::string(descriptor);
+            std::string_view name = descriptor.substr(i + 1, end - i - 1);
+            uint32_t mapped = findClass(toObfuscated ? classByName : classByObfuscated, name, !toObfuscated);
+            out += mapped == NotFound ? std::string(name) : internalName(toObfuscated ? classes[mapped].obfuscated : classes[mapped].name);
+            out += ';';
+            i = end;
+        }
+        return out;
+    }
+
+    void parse(std::string_view text) {
+        for (size_t position = 0; position < text.size();) {
+            size_t end = std::min(text.find('\n', position), text.size());
+            std::string_view line = text.substr(position, end - position);
+            position = end + 1;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            size_t arrow = line.find(" -> ");
+            if (line.empty() || line[0] == '#' || arrow == std::string_view::npos) continue;
+            std::string_view obfuscated = trim(line.substr(arrow + 4));
+
+            if (line[0] != ' ' && line[0] != '\t') {
+                if (!obfuscated.empty() && obfuscated.back() == ':') obfuscated.remove_suffix(1);
+                classes.push_back({trim(line.substr(0, arrow)), obfuscated});
+                continue;
+            }
+            if (classes.empty()) continue;
+
+            // "1:5:" line ranges lead a method, ":10:14" original lines follow its arguments.
+            std::string_view member = trim(line.substr(0, arrow));
+            while (!member.empty() && member[0] >= '0' && member[0] <= '9') {
+                size_t colon = member.find(':');
+                if (colon == std::string_view::npos) break;
+                member.remove_prefix(colon + 1);
+            }
+            size_t space = member.find(' ');
+            if (space == std::string_view::npos) continue;
+            MappedMember mapped{static_cast<uint32_t>(classes.size() - 1), false, {}, obfuscated, member.substr(0, space), {}};
+            std::string_view rest = member.substr(space + 1);
+            size_t open = rest.find('(');
+            if (open == std::string_view::npos) {
+                mapped.name = trim(rest);
+            } else {
+                size_t close = rest.find(')', open);
+                if (close == std::string_view::npos) continue;
+                mapped.method = true;
+                mapped.name = rest.substr(0, open);
+                mapped.arguments = rest.substr(open + 1, close - open - 1);
+            }
+            members.push_back(mapped);
+        }
+    }
+
+    void buildIndexes() {
+        descriptors.reserve(members.size() * 64);
+        classByName.reserve(classes.size());
+        classByObfuscated.reserve(classes.size());
+        for (uint32_t i = 0; i < classes.size(); i++) {
+            if (findClass(classByName, classes[i].name, false) == NotFound) classByName.insert(hashName(classes[i].name), i);
+            if (findClass(classByObfuscated, classes[i].obfuscated, true) == NotFound) classByObfuscated.insert(hashName(classes[i].obfuscated), i);
+        }
+
+        for (auto& member : members) {
+            member.descriptor = static_cast<uint32_t>(descriptors.size());
+            appendDescriptor(descriptors, member, false);
+            member.descriptorLength = static_cast<uint32_t>(descriptors.size() - member.descriptor);
+            member.obfuscatedDescriptor = static_cast<uint32_t>(descriptors.size());
+            appendDescriptor(descriptors, member, true);
+            member.obfuscatedLength = static_cast<uint32_t>(descriptors.size() - member.obfuscatedDescriptor);
+        }
+
+        // Methods are keyed by descriptor, and the first overload of a name also without one; fields by name.
+        memberByName.reserve(members.size() * 2);
+        memberByObfuscated.reserve(members.size());
+        for (uint32_t i = 0; i < members.size(); i++) {
+            const MappedMember& member = members[i];
+            std::string_view descriptor = member.method ? descriptorOf(member, false) : std::string_view();
+            std::string_view obfuscatedDescriptor = member.method ? descriptorOf(member, true) : std::string_view();
+            // Inlined methods repeat once per line range.
+            if (findMember(member.owner, member.method, member.name, descriptor, false) != NotFound) continue;
+            memberByName.insert(memberHash(member.owner, member.method, member.name, descriptor), i);
+            if (member.method && findMember(member.owner, true, member.name, {}, false) == NotFound) {
+                memberByName.insert(memberHash(member.owner, true, member.name, {}), i);
+            }
+            if (findMember(member.owner, member.method, member.obfuscated, obfuscatedDescriptor, true) == NotFound) {
+                memberByObfuscated.insert(memberHash(member.owner, member.method, member.obfuscated, obfuscatedDescriptor), i);
+            }
+        }
+    }
+}
+
+bool Mappings::enabled() {
+    return loaded;
+}
+
+void Mappings::configure() {
+    std::string path = Options::get("mappings");
+    if (path.empty()) return;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info{};
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << "[Rynox] Failed to read mappings from " << path << "." << std::endl;
+        if (fd >= 0) close(fd);
+        return;
+    }
+    // Stays mapped for the process: every name is a view into it.
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "[Rynox] Failed to map " << path << "." << std::endl;
+        return;
+    }
+    madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+    parse(std::string_view(static_cast<const char*>(data), static_cast<size_t>(info.st_size)));
+    buildIndexes();
+    loaded = !classes.empty();
+    std::cerr << "[Rynox] Loaded " << classes.size() << " classes and " << members.size() << " members from " << path << "." << std::endl;
+}
+
+bool Mappings::deobfuscateClass(std::string_view name, std::string& out) {
+    uint32_t mapped = findClass(classByObfuscated, name, true);
+    if (mapped == NotFound) return false;
+    out = internalName(classes[mapped].name);
+    return true;
+}
+
+bool Mappings::obfuscateClass(std::string_view name, std::string& out) {
+    uint32_t mapped = findClass(classByName, name, false);
+    if (mapped == NotFound) return false;
+    out = internalName(classes[mapped].obfuscated);
+    return true;
+}
+
+bool Mappings::deobfuscateMethod(std::string_view owner, std::string_view name, std::string_view descriptor, Method& out) {
+    uint32_t mappedOwner = findClass(classByObfuscated, owner, true);
+    if (mappedOwner == NotFound) return false;
+    uint32_t mapped = findMember(mappedOwner, true, name, descriptor, true);
+    out.owner = internalName(classes[mappedOwner].name);
+    out.name = mapped != NotFound ? members[mapped].name : name;
+    out.descriptor = mapped != NotFound ? std::string(descriptorOf(members[mapped], false)) : translateDescriptor(descriptor, false);
+    return true;
+}
+
+bool Mappings::obfuscateMethod(std::string_view owner, std::string_view name, std::string_view descriptor, Method& out) {
+    uint32_t mappedOwner = findClass(classByName, owner, false);
+    if (mappedOwner == NotFound) return false;
+    uint32_t mapped = findMember(mappedOwner, true, name, descriptor, false);
+    out.owner = internalName(classes[mappedOwner].obfuscated);
+    out.name = mapped != NotFound ? members[mapped].obfuscated : name;
+    out.descriptor = mapped != NotFound ? std::string(descriptorOf(members[mapped], true)) : translateDescriptor(descriptor, true);
+    return true;
+}
+
+bool Mappings::deobfuscateField(std::string_view owner, std::string_view name, std::string& out) {
+    uint32_t mappedOwner = findClass(classByObfuscated, owner, true);
+    uint32_t mapped = mappedOwner != NotFound ? findMember(mappedOwner, false, name, {}, true) : NotFound;
+    if (mapped == NotFound) return false;
+    out = members[mapped].name;
+    return true;
+}
+
+bool Mappings::obfuscateField(std::string_view owner, std::string_view name, std::string& out) {
+    uint32_t mappedOwner = findClass(classByName, owner, false);
+    uint32_t mapped = mappedOwner != NotFound ? findMember(mappedOwner, false, name, {}, false) : NotFound;
+    if (mapped == NotFound) return false;
+    out = members[mapped].obfuscated;
+    return true;
+}
+
+std::string Mappings::describe(std::string_view owner, std::string_view name, std::string_view descriptor) {
+    Method method;
+    if (!loaded || !deobfuscateMethod(owner, name, descriptor, method)) return std::string(owner) + "." + std::string(name) + std::string(descriptor);
+    return method.owner + "." + method.name + method.descriptor;
+}
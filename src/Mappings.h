@@ -0,0 +1,44 @@
+#ifndef MAPPINGS_H
+#define MAPPINGS_H
+
+#include <string>
+#include <string_view>
+
+// Name mappings of an obfuscated build, loaded from "mappings=<path>" in ProGuard format (as Mojang
+// publishes them: "a.b.C -> x:" class lines, each followed by indented "type name -> y" fields and
+// "[1:2:]type name(args)[:3:4] -> z" methods). The file is mmapped and parsed once at startup;
+// names stay views into it and only the JVM descriptors are built, so a multi-megabyte mapping costs
+// little more than its page cache. Open-addressing indexes over classes and members answer lookups
+// in both directions in O(1) without locking. Names are internal ("net/minecraft/client/Minecraft")
+// and descriptors JVM form on both sides of the API.
+//
+// With mappings loaded, SymbolCache reports deobfuscated names (and with it traces, stacks and pprof
+// profiles), while the frame and tick methods and the probe targets are given deobfuscated and bound
+// to the obfuscated classes.
+namespace Mappings {
+    struct Method {
+        std::string owner;
+        std::string name;
+        std::string descriptor;
+    };
+
+    bool enabled();
+    void configure();
+
+    // False, with "out" untouched, when the class is not mapped.
+    bool deobfuscateClass(std::string_view name, std::string& out);
+    bool obfuscateClass(std::string_view name, std::string& out);
+    // False when the owner is not mapped. A method the file omits keeps its name, with the classes
+    // in its descriptor still translated.
+    bool deobfuscateMethod(std::string_view owner, std::string_view name, std::string_view descriptor, Method& out);
+    // An empty descriptor takes the first overload listed.
+    bool obfuscateMethod(std::string_view owner, std::string_view name, std::string_view descriptor, Method& out);
+    // Field names only; the owner stays as given on both sides.
+    bool deobfuscateField(std::string_view owner, std::string_view name, std::string& out);
+    bool obfuscateField(std::string_view owner, std::string_view name, std::string& out);
+
+    // "<class>.<method><descriptor>" with deobfuscated names where mapped.
+    std::string describe(std::string_view owner, std::string_view name, std::string_view descriptor);
+}
+
+#endif //MAPPINGS_H
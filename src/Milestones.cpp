@@ -0,0 +1,117 @@
+#include "Milestones.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Trace.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace {
+    struct Trigger {
+        std::string milestone;
+        std::string className;
+    };
+
+    struct Listener {
+        std::string milestone;
+        std::function<void(const Milestones::Milestone&)> callback;
+    };
+
+    std::mutex lock;
+    std::vector<Trigger> triggers;
+    std::vector<Milestones::Milestone> reachedList;
+    std::vector<Listener> listeners;
+    std::atomic<size_t> pendingTriggers = 0;
+
+    void setTrigger(std::string_view milestone, std::string_view className) {
+        for (auto& trigger : triggers) {
+            if (trigger.milestone == milestone) {
+                trigger.className = className;
+                return;
+            }
+        }
+        triggers.push_back({std::string(milestone), std::string(className)});
+    }
+}
+
+void Milestones::configure() {
+    std::lock_guard guard(lock);
+    setTrigger(FirstFrame, "net/minecraft/client/gui/screens/TitleScreen");
+    setTrigger(WorldJoin, "net/minecraft/client/multiplayer/ClientLevel");
+
+    for (const auto& value : Options::getAll("milestone")) {
+        size_t colon = value.find(':');
+        if (colon == std::string::npos || colon == 0) continue;
+        setTrigger(std::string_view(value).substr(0, colon), std::string_view(value).substr(colon + 1));
+    }
+    pendingTriggers = triggers.size();
+}
+
+void Milestones::onClassPrepare(std::string_view className) {
+    if (pendingTriggers.load(std::memory_order_relaxed) == 0) return;
+
+    std::string milestone;
+    {
+        std::lock_guard guard(lock);
+        for (auto it = triggers.begin(); it != triggers.end(); ++it) {
+            if (it->className != className) continue;
+            milestone = it->milestone;
+            triggers.erase(it);
+            pendingTriggers = triggers.size();
+            break;
+        }
+    }
+    if (!milestone.empty()) reach(milestone);
+}
+
+void Milestones::reach(std::string_view name) {
+    Milestone milestone{std::string(name), Platform::nanoTime(), Platform::currentThreadId()};
+    std::vector<std::function<void(const Milestone&)>> callbacks;
+    {
+        std::lock_guard guard(lock);
+        for (const auto& existing : reachedList) {
+            if (existing.name == name) return;
+        }
+        reachedList.push_back(milestone);
+        Trace::milestone(milestone.nanos, milestone.threadId, milestone.name);
+        for (auto it = listeners.begin(); it != listeners.end();) {
+            if (it->milestone == name) {
+                callbacks.push_back(std::move(it->callback));
+                it = listeners.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const auto& callback : callbacks) callback(milestone);
+}
+
+bool Milestones::reached(std::string_view name, Milestone* out) {
+    std::lock_guard guard(lock);
+    for (const auto& existing : reachedList) {
+        if (existing.name != name) continue;
+        if (out) *out = existing;
+        return true;
+    }
+    return false;
+}
+
+void Milestones::onReached(std::string_view name, std::function<void(const Milestone&)> listener) {
+    Milestone milestone;
+    {
+        std::lock_guard guard(lock);
+        bool found = false;
+        for (const auto& existing : reachedList) {
+            if (existing.name == name) {
+                milestone = existing;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            listeners.push_back({std::string(name), std::move(listener)});
+            return;
+        }
+    }
+    listener(milestone);
+}
@@ -0,0 +1,32 @@
+#ifndef MILESTONES_H
+#define MILESTONES_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Named points in client startup (first frame, world join, ...). A milestone is reached either
+// explicitly or when its trigger class is prepared; "milestone=<name>:<internal class name>"
+// adds or overrides a trigger.
+namespace Milestones {
+    inline constexpr std::string_view FirstFrame = "first-frame";
+    inline constexpr std::string_view WorldJoin = "world-join";
+
+    struct Milestone {
+        std::string name;
+        uint64_t nanos = 0;
+        uint64_t threadId = 0;
+    };
+
+    void configure();
+    void onClassPrepare(std::string_view className);
+
+    void reach(std::string_view name);
+    bool reached(std::string_view name, Milestone* out = nullptr);
+
+    // Runs immediately if the milestone was already reached, otherwise on the reaching thread.
+    void onReached(std::string_view name, std::function<void(const Milestone&)> listener);
+}
+
+#endif //MILESTONES_H
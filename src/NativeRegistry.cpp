@@ -0,0 +1,229 @@
+#include "NativeRegistry.h"
+#include "Agent.h"
+#include "Options.h"
+#include "Platform.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <dlfcn.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+    constexpr size_t TrampolineSlots = 256;
+#if defined(__aarch64__)
+    constexpr size_t IntegerRegisters = 8;
+#else
+    constexpr size_t IntegerRegisters = 6;
+#endif
+    constexpr size_t FloatRegisters = 8;
+
+    struct Slot {
+        std::atomic<void*> original = nullptr;
+        std::atomic<uint64_t> calls = 0;
+        std::atomic<uint64_t> totalNanos = 0;
+        std::atomic<uint64_t> maxNanos = 0;
+    };
+
+    struct Binding {
+        jmethodID method;
+        void* address;
+        // "<class>.<method><descriptor>"; empty until resolved, which the primordial phase does not allow.
+        std::string name;
+        std::string library;
+        std::string symbol;
+        int32_t slot = -1;
+        // Returns float or double, so it needs the trampoline that keeps the vector register result.
+        bool floatResult = false;
+    };
+
+    std::string path;
+    // Class name -> method names to time, "*" for all.
+    std::unordered_map<std::string, std::vector<std::string>> timed;
+    bool configured = false;
+
+    std::mutex lock;
+    std::vector<Binding> bindings;
+    std::unordered_map<jmethodID, size_t> indexes;
+    std::array<Slot, TrampolineSlots> slots;
+    size_t slotsUsed = 0;
+
+    void record(Slot& slot, uint64_t duration) {
+        slot.calls.fetch_add(1, std::memory_order_relaxed);
+        slot.totalNanos.fetch_add(duration, std::memory_order_relaxed);
+        uint64_t max = slot.maxNanos.load(std::memory_order_relaxed);
+        while (duration > max && !slot.maxNanos.compare_exchange_weak(max, duration, std::memory_order_relaxed)) {}
+    }
+
+    template <size_t>
+    using Word = uint64_t;
+    template <size_t>
+    using Float = double;
+
+    // Takes every argument register and hands all of them on untouched: integer arguments, pointers
+    // included, arrive in the general registers and floating-point ones in the vector registers,
+    // independently of their interleaving, so one shape forwards any native whose arguments fit.
+    // A float travels in the low bits of a double parameter, which is never converted.
+    template <typename Return, typename Words, typename Floats>
+    struct Trampoline;
+
+    template <typename Return, size_t... W, size_t... F>
+    struct Trampoline<Return, std::index_sequence<W...>, std::index_sequence<F...>> {
+        using Function = Return (*)(Word<W>..., Float<F>...);
+
+        template <size_t Index>
+        static Return call(Word<W>... words, Float<F>... floats) {
+            Slot& slot = slots[Index];
+            uint64_t start = Platform::nanoTime();
+            Return result = reinterpret_cast<Function>(slot.original.load(std::memory_order_acquire))(words..., floats...);
+            record(slot, Platform::nanoTime() - start);
+            return result;
+        }
+
+        template <size_t... Index>
+        static std::array<void*, sizeof...(Index)> table(std::index_sequence<Index...>) {
+            return {reinterpret_cast<void*>(&call<Index>)...};
+        }
+    };
+
+    // Integer, pointer and void results come back in the first general register, float and double in the first vector register.
+    using IntegerTrampoline = Trampoline<uint64_t, std::make_index_sequence<IntegerRegisters>, std::make_index_sequence<FloatRegisters>>;
+    using FloatTrampoline = Trampoline<double, std::make_index_sequence<IntegerRegisters>, std::make_index_sequence<FloatRegisters>>;
+    const std::array<void*, TrampolineSlots> integerTrampolines = IntegerTrampoline::table(std::make_index_sequence<TrampolineSlots>());
+    const std::array<void*, TrampolineSlots> floatTrampolines = FloatTrampoline::table(std::make_index_sequence<TrampolineSlots>());
+
+    // True when a native of this descriptor takes its arguments, JNIEnv and receiver included, in registers only.
+    bool fitsRegisters(std::string_view descriptor) {
+        size_t words = 2, floats = 0;
+        for (size_t i = 1; i < descriptor.size() && descriptor[i] != ')'; i++) {
+            if (descriptor[i] == 'F' || descriptor[i] == 'D') floats++;
+            else words++;
+            while (i < descriptor.size() && descriptor[i] == '[') i++;
+            if (i < descriptor.size() && descriptor[i] == 'L') i = descriptor.find(';', i);
+            if (i == std::string_view::npos) return false;
+        }
+        return words <= IntegerRegisters && floats <= FloatRegisters;
+    }
+
+    bool resolve(jvmtiEnv* jvmti, JNIEnv* env, jmethodID method, std::string& className, std::string& name, std::string& descriptor) {
+        jclass klass = nullptr;
+        char* methodName = nullptr;
+        char* methodDescriptor = nullptr;
+        if (jvmti->GetMethodDeclaringClass(method, &klass) != JVMTI_ERROR_NONE ||
+            jvmti->GetMethodName(method, &methodName, &methodDescriptor, nullptr) != JVMTI_ERROR_NONE) {
+            return false;
+        }
+        className = Agent::className(jvmti, klass);
+        name = methodName;
+        descriptor = methodDescriptor;
+        jvmti->Deallocate(reinterpret_cast<unsigned char*>(methodName));
+        jvmti->Deallocate(reinterpret_cast<unsigned char*>(methodDescriptor));
+        if (env) env->DeleteLocalRef(klass);
+        return true;
+    }
+
+    bool isTimed(const std::string& className, const std::string& name) {
+        auto it = timed.find(className);
+        if (it == timed.end()) return false;
+        return std::any_of(it->second.begin(), it->second.end(), [&](const std::string& method) { return method == "*" || method == name; });
+    }
+}
+
+bool NativeRegistry::enabled() {
+    return configured;
+}
+
+void NativeRegistry::configure() {
+    path = Options::get("native-registry");
+    for (const auto& target : Options::getAll("native-time")) {
+        size_t dot = target.rfind('.');
+        if (dot == std::string::npos || dot == 0 || dot + 1 == target.size()) {
+            std::cerr << "[Rynox] Ignoring native-time \"" << target << "\", expected <class>.<method>." << std::endl;
+            continue;
+        }
+        timed[target.substr(0, dot)].push_back(target.substr(dot + 1));
+    }
+    configured = !path.empty();
+    if (!configured && !timed.empty()) std::cerr << "[Rynox] Ignoring native-time without native-registry." << std::endl;
+}
+
+void NativeRegistry::onNativeMethodBind(jvmtiEnv* jvmti, JNIEnv* env, jmethodID method, void* address, void** newAddress) {
+    jvmtiPhase phase = JVMTI_PHASE_PRIMORDIAL;
+    jvmti->GetPhase(&phase);
+    std::string className, name, descriptor;
+    bool resolved = (phase == JVMTI_PHASE_START || phase == JVMTI_PHASE_LIVE) && resolve(jvmti, env, method, className, name, descriptor);
+    Dl_info info{};
+    bool located = dladdr(address, &info) != 0;
+
+    std::lock_guard guard(lock);
+    auto [it, inserted] = indexes.try_emplace(method, bindings.size());
+    if (inserted) bindings.push_back({method, address, {}, {}, {}});
+    Binding& binding = bindings[it->second];
+    binding.address = address;
+    if (resolved) binding.name = className + "." + name + descriptor;
+    binding.library = located && info.dli_fname ? info.dli_fname : "";
+    binding.symbol = located && info.dli_sname ? info.dli_sname : "";
+
+    if (binding.slot < 0 && resolved && isTimed(className, name)) {
+        if (!fitsRegisters(descriptor)) {
+            std::cerr << "[Rynox] Not timing " << binding.name << ", its arguments do not fit in registers." << std::endl;
+        } else if (slotsUsed < TrampolineSlots) {
+            binding.slot = static_cast<int32_t>(slotsUsed++);
+            char result = descriptor[descriptor.find(')') + 1];
+            binding.floatResult = result == 'F' || result == 'D';
+        } else if (slotsUsed++ == TrampolineSlots) {
+            std::cerr << "[Rynox] Trampoline limit of " << TrampolineSlots << " natives reached." << std::endl;
+        }
+    }
+    if (binding.slot < 0) return;
+
+    // A rebinding (RegisterNatives again) moves the same trampoline to the new function.
+    slots[binding.slot].original.store(address, std::memory_order_release);
+    *newAddress = (binding.floatResult ? floatTrampolines : integerTrampolines)[binding.slot];
+}
+
+void NativeRegistry::write(jvmtiEnv* jvmti) {
+    if (!enabled()) return;
+
+    JNIEnv* env = nullptr;
+    Agent::jvm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_8);
+    std::lock_guard guard(lock);
+    for (auto& binding : bindings) {
+        std::string className, name, descriptor;
+        if (binding.name.empty() && resolve(jvmti, env, binding.method, className, name, descriptor)) {
+            binding.name = className + "." + name + descriptor;
+        }
+    }
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[Rynox] Failed to write native registry to " << path << "." << std::endl;
+        return;
+    }
+    // Sorted by address, so a native pc maps to the binding at or below it within its library.
+    std::vector<const Binding*> sorted;
+    for (const auto& binding : bindings) sorted.push_back(&binding);
+    std::sort(sorted.begin(), sorted.end(), [](const Binding* a, const Binding* b) { return a->address < b->address; });
+
+    out << "# Rynox native registry\n";
+    out << "## Bound natives (address, library, symbol, calls, total ms, max us, method)\n";
+    out << std::fixed << std::setprecision(3);
+    for (const Binding* binding : sorted) {
+        out << "0x" << std::hex << reinterpret_cast<uintptr_t>(binding->address) << std::dec << "\t"
+            << (binding->library.empty() ? "-" : binding->library) << "\t" << (binding->symbol.empty() ? "-" : binding->symbol) << "\t";
+        if (binding->slot >= 0) {
+            const Slot& slot = slots[binding->slot];
+            out << slot.calls.load() << "\t" << static_cast<double>(slot.totalNanos.load()) / 1e6 << "\t"
+                << static_cast<double>(slot.maxNanos.load()) / 1e3 << "\t";
+        } else {
+            out << "-\t-\t-\t";
+        }
+        out << (binding->name.empty() ? "<unresolved>" : binding->name) << "\n";
+    }
+}
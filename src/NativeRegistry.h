@@ -0,0 +1,24 @@
+#ifndef NATIVE_REGISTRY_H
+#define NATIVE_REGISTRY_H
+
+#include <jvmti.h>
+
+// Every Java native method the VM binds, from NativeMethodBind events: the method, the address it was
+// bound to and the library and symbol containing that address, written to "native-registry=<path>"
+// at shutdown so samples in native libraries can be attributed to the Java methods entering them.
+// "native-time=<class>.<method>" ("<class>.*" for all of a class) substitutes a timing trampoline for
+// the bound function: it calls the original with the same registers and adds the call's count and
+// duration to the registry. Trampolines pass integer and floating-point arguments in registers only,
+// so natives taking more than fit (six integer and eight floating-point on x86-64, counting JNIEnv and
+// the receiver) are recorded but left untimed. Unlike the "native" probes this needs no rewriting and
+// also covers natives bound before VMInit or through RegisterNatives.
+namespace NativeRegistry {
+    bool enabled();
+    void configure();
+
+    void onNativeMethodBind(jvmtiEnv* jvmti, JNIEnv* env, jmethodID method, void* address, void** newAddress);
+
+    void write(jvmtiEnv* jvmti);
+}
+
+#endif //NATIVE_REGISTRY_H
@@ -0,0 +1,54 @@
+#include "Options.h"
+#include <cstdlib>
+#include <utility>
+
+namespace {
+    std::vector<std::pair<std::string, std::string>> entries;
+}
+
+void Options::parse(const char* options) {
+    entries.clear();
+    if (!options) return;
+
+    std::string_view rest(options);
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        std::string_view item = rest.substr(0, comma);
+        rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+        if (item.empty()) continue;
+
+        size_t eq = item.find('=');
+        if (eq == std::string_view::npos) entries.emplace_back(std::string(item), std::string());
+        else entries.emplace_back(std::string(item.substr(0, eq)), std::string(item.substr(eq + 1)));
+    }
+}
+
+bool Options::has(std::string_view key) {
+    for (const auto& [k, v] : entries) {
+        if (k == key) return true;
+    }
+    return false;
+}
+
+std::string Options::get(std::string_view key, std::string_view fallback) {
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        if (it->first == key) return it->second;
+    }
+    return std::string(fallback);
+}
+
+std::vector<std::string> Options::getAll(std::string_view key) {
+    std::vector<std::string> values;
+    for (const auto& [k, v] : entries) {
+        if (k == key) values.push_back(v);
+    }
+    return values;
+}
+
+long Options::getLong(std::string_view key, long fallback) {
+    std::string value = get(key);
+    if (value.empty()) return fallback;
+    char* end = nullptr;
+    long parsed = std::strtol(value.c_str(), &end, 10);
+    return end && *end == '\0' ? parsed : fallback;
+}
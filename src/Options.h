@@ -0,0 +1,18 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Agent options are passed as "key=value,key=value"; a key may repeat to give several values.
+namespace Options {
+    void parse(const char* options);
+
+    bool has(std::string_view key);
+    std::string get(std::string_view key, std::string_view fallback = {});
+    std::vector<std::string> getAll(std::string_view key);
+    long getLong(std::string_view key, long fallback);
+}
+
+#endif //OPTIONS_H
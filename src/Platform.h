@@ -0,0 +1,32 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <cstdint>
+#include <ctime>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace Platform {
+    // Monotonic clock shared by every subsystem so events can be merged on one timeline.
+    inline uint64_t nanoTime() {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+    }
+
+    inline uint64_t currentThreadId() {
+#ifdef __linux__
+        thread_local const uint64_t tid = static_cast<uint64_t>(syscall(SYS_gettid));
+        return tid;
+#else
+        uint64_t tid = 0;
+        pthread_threadid_np(nullptr, &tid);
+        return tid;
+#endif
+    }
+}
+
+#endif //PLATFORM_H
@@ -0,0 +1,171 @@
+#include "Pprof.h"
+#include "Agent.h"
+#include "Gzip.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Sampler.h"
+#include "StackTrie.h"
+#include "SymbolCache.h"
+#include "Varint.h"
+#include <chrono>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    // Minimal protobuf encoder: only the varint and length-delimited wire types pprof uses.
+    class Message {
+    public:
+        Message& varint(uint32_t field, uint64_t value) {
+            if (value == 0) return *this;
+            tag(field, 0);
+            Varint::write(bytes, value);
+            return *this;
+        }
+
+        Message& packed(uint32_t field, const std::vector<uint64_t>& values) {
+            if (values.empty()) return *this;
+            std::vector<uint8_t> body;
+            for (uint64_t value : values) Varint::write(body, value);
+            return delimited(field, body.data(), body.size());
+        }
+
+        Message& string(uint32_t field, std::string_view text) {
+            return delimited(field, reinterpret_cast<const uint8_t*>(text.data()), text.size());
+        }
+
+        Message& message(uint32_t field, const Message& nested) {
+            return delimited(field, nested.bytes.data(), nested.bytes.size());
+        }
+
+        std::vector<uint8_t> bytes;
+
+    private:
+        void tag(uint32_t field, uint32_t wireType) {
+            Varint::write(bytes, (static_cast<uint64_t>(field) << 3) | wireType);
+        }
+
+        Message& delimited(uint32_t field, const uint8_t* data, size_t size) {
+            tag(field, 2);
+            Varint::write(bytes, size);
+            bytes.insert(bytes.end(), data, data + size);
+            return *this;
+        }
+    };
+
+    class StringTable {
+    public:
+        StringTable() { index(""); }
+
+        uint64_t index(std::string_view text) {
+            auto it = ids.find(std::string(text));
+            if (it != ids.end()) return it->second;
+            ids.emplace(std::string(text), strings.size());
+            strings.emplace_back(text);
+            return strings.size() - 1;
+        }
+
+        std::vector<std::string> strings;
+
+    private:
+        std::unordered_map<std::string, uint64_t> ids;
+    };
+
+    std::string outputPath;
+
+    Message valueType(StringTable& table, std::string_view type, std::string_view unit) {
+        Message message;
+        message.varint(1, table.index(type)).varint(2, table.index(unit));
+        return message;
+    }
+}
+
+bool Pprof::enabled() {
+    return !outputPath.empty();
+}
+
+void Pprof::configure() {
+    outputPath = Options::get("pprof");
+}
+
+bool Pprof::write(const std::string& path) {
+    StringTable table;
+    Message profile;
+    uint64_t interval = static_cast<uint64_t>(Sampler::intervalNanos());
+
+    profile.message(1, valueType(table, "cpu", "nanoseconds"));
+    profile.message(1, valueType(table, "wall", "nanoseconds"));
+    profile.message(1, valueType(table, "alloc_objects", "count"));
+    profile.message(1, valueType(table, "alloc_space", "bytes"));
+
+    std::unordered_map<jmethodID, uint64_t> functionIds;
+    std::unordered_map<StackTrie::NodeId, bool> locations;
+    std::vector<uint64_t> locationIds;
+    std::vector<uint64_t> values;
+
+    auto addLocation = [&](StackTrie::NodeId id, const StackTrie::Node& node) {
+        if (!locations.emplace(id, true).second) return;
+
+        const SymbolCache::Symbol* symbol = SymbolCache::find(node.method);
+        auto [function, inserted] = functionIds.emplace(node.method, functionIds.size() + 1);
+        if (inserted) {
+            std::string className = symbol ? symbol->className : "<unknown>";
+            std::string name = symbol ? className + "." + symbol->name : "<unknown>";
+            Message message;
+            message.varint(1, function->second).varint(2, table.index(name));
+            message.varint(3, table.index(symbol ? name + symbol->signature : name)).varint(4, table.index(className));
+            profile.message(5, message);
+        }
+
+        jint line = symbol ? symbol->lineAt(node.location) : -1;
+        Message lineMessage;
+        lineMessage.varint(1, function->second).varint(2, line > 0 ? static_cast<uint64_t>(line) : 0);
+        Message location;
+        location.varint(1, id).varint(2, 1);
+        location.message(4, lineMessage);
+        profile.message(4, location);
+    };
+
+    StackTrie::forEachSampled([&](StackTrie::NodeId leaf, const StackTrie::Node& leafNode) {
+        locationIds.clear();
+        StackTrie::Node node = leafNode;
+        for (StackTrie::NodeId id = leaf; id != StackTrie::Root;) {
+            addLocation(id, node);
+            locationIds.push_back(id);
+            id = node.parent;
+            if (id != StackTrie::Root && !StackTrie::node(id, node)) break;
+        }
+
+        values = {StackTrie::count(leaf, StackTrie::CpuSamples) * interval, StackTrie::count(leaf, StackTrie::WallSamples) * interval,
+                  StackTrie::count(leaf, StackTrie::AllocSamples), StackTrie::count(leaf, StackTrie::AllocBytes)};
+        Message sample;
+        sample.packed(1, locationIds).packed(2, values);
+        profile.message(2, sample);
+    });
+
+    Message mapping;
+    mapping.varint(1, 1).varint(5, table.index("jvm")).varint(7, 1);
+    profile.message(3, mapping);
+
+    uint64_t now = Platform::nanoTime();
+    auto epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    profile.varint(9, static_cast<uint64_t>(epoch) - (now - Agent::startNanos));
+    profile.varint(10, now - Agent::startNanos);
+    profile.message(11, valueType(table, "wall", "nanoseconds"));
+    profile.varint(12, interval);
+
+    // The string table goes last: every index above has been assigned by now.
+    for (const auto& text : table.strings) profile.string(6, text);
+
+    if (!Gzip::write(path, profile.bytes)) {
+        std::cerr << "[Rynox] Failed to write pprof profile to " << path << "." << std::endl;
+        return false;
+    }
+    std::cerr << "[Rynox] Wrote pprof profile with " << locations.size() << " locations to " << path << "." << std::endl;
+    return true;
+}
+
+void Pprof::writeConfigured() {
+    if (enabled()) write(outputPath);
+}
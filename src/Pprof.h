@@ -0,0 +1,19 @@
+#ifndef PPROF_H
+#define PPROF_H
+
+#include <string>
+
+// Exports the StackTrie as a gzip'd pprof profile.proto, enabled with "pprof=<path>" and written on
+// shutdown; without "sample" or "alloc" it turns the sampler on at 20 ms. Sample types are cpu and
+// wall (nanoseconds, samples times the sampling interval) and alloc_objects/alloc_space from
+// SampledObjectAlloc. Every trie node is one location, every method one function, under a single
+// "jvm" mapping. The protobuf encoding is hand-written.
+namespace Pprof {
+    bool enabled();
+    void configure();
+
+    bool write(const std::string& path);
+    void writeConfigured();
+}
+
+#endif //PPROF_H
@@ -0,0 +1,217 @@
+#include "Prewarm.h"
+#include "Agent.h"
+#include "Milestones.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Rynox.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/resource.h>
+
+namespace {
+    struct Entry {
+        std::string loader;
+        std::string name;
+    };
+
+    std::string orderPath;
+    std::atomic_bool recording = false;
+    std::atomic_bool written = false;
+    bool replayMode = false;
+
+    std::mutex lock;
+    std::vector<Entry> entries;
+    // Custom loaders the replay still waits for, by loader class name; first instance seen wins.
+    std::unordered_map<std::string, jweak> loaders;
+    std::atomic<size_t> missingLoaders = 0;
+
+    bool loadOrder() {
+        std::ifstream in(orderPath);
+        if (!in) return false;
+
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t space = line.find(' ');
+            if (line.empty() || line[0] == '#' || space == std::string::npos) continue;
+            Entry entry{line.substr(0, space), line.substr(space + 1)};
+            if (!Agent::isBuiltinLoader(entry.loader)) loaders.emplace(entry.loader, nullptr);
+            entries.push_back(std::move(entry));
+        }
+        missingLoaders = loaders.size();
+        return true;
+    }
+
+    jobject builtinLoader(JNIEnv* env, const std::string& loaderName) {
+        if (loaderName == "bootstrap") return nullptr;
+
+        jclass loaderClass = env->FindClass("java/lang/ClassLoader");
+        const char* getter = loaderName == "jdk/internal/loader/ClassLoaders$PlatformClassLoader" ? "getPlatformClassLoader" : "getSystemClassLoader";
+        jmethodID method = env->GetStaticMethodID(loaderClass, getter, "()Ljava/lang/ClassLoader;");
+        jobject loader = env->CallStaticObjectMethod(loaderClass, method);
+        jobject global = loader ? env->NewGlobalRef(loader) : nullptr;
+        env->DeleteLocalRef(loader);
+        env->DeleteLocalRef(loaderClass);
+        return global;
+    }
+
+    // Waits for a custom loader to show up in a class load; game and mod loaders are created after VMInit.
+    jobject awaitLoader(JNIEnv* env, const std::string& loaderName, std::chrono::steady_clock::time_point deadline) {
+        while (Client::isRunning) {
+            {
+                std::lock_guard guard(lock);
+                auto it = loaders.find(loaderName);
+                if (it == loaders.end()) return nullptr;
+                if (it->second) {
+                    jobject loader = env->NewLocalRef(it->second);
+                    if (loader) return loader;
+                }
+            }
+            if (std::chrono::steady_clock::now() >= deadline) return nullptr;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return nullptr;
+    }
+
+    void* runPrewarm(void*) {
+        JNIEnv* env = nullptr;
+        JavaVMAttachArgs args{JNI_VERSION_1_8, const_cast<char*>("Rynox Prewarm"), nullptr};
+        if (Client::jvm->AttachCurrentThreadAsDaemon(reinterpret_cast<void**>(&env), &args) != JNI_OK || !env) {
+            std::cerr << "[Rynox] Failed to attach prewarm thread to JVM." << std::endl;
+            return nullptr;
+        }
+#ifdef __linux__
+        // Per-thread nice value on Linux; keeps the replay behind the render and server threads.
+        setpriority(PRIO_PROCESS, static_cast<id_t>(Platform::currentThreadId()), 10);
+#endif
+
+        jclass classClass = env->FindClass("java/lang/Class");
+        jmethodID forName = env->GetStaticMethodID(classClass, "forName", "(Ljava/lang/String;ZLjava/lang/ClassLoader;)Ljava/lang/Class;");
+        std::unordered_map<std::string, jobject> resolved;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(Options::getLong("prewarm-timeout", 120));
+        size_t loaded = 0;
+        size_t failed = 0;
+
+        for (const auto& entry : entries) {
+            if (!Client::isRunning) break;
+
+            auto it = resolved.find(entry.loader);
+            if (it == resolved.end()) {
+                jobject loader = nullptr;
+                if (Agent::isBuiltinLoader(entry.loader)) {
+                    loader = builtinLoader(env, entry.loader);
+                } else {
+                    jobject local = awaitLoader(env, entry.loader, deadline);
+                    loader = local ? env->NewGlobalRef(local) : nullptr;
+                    env->DeleteLocalRef(local);
+                }
+                it = resolved.emplace(entry.loader, loader).first;
+            }
+            if (!it->second && entry.loader != "bootstrap") {
+                failed++;
+                continue;
+            }
+
+            env->PushLocalFrame(4);
+            std::string binaryName = entry.name;
+            std::replace(binaryName.begin(), binaryName.end(), '/', '.');
+            jstring name = env->NewStringUTF(binaryName.c_str());
+            env->CallStaticObjectMethod(classClass, forName, name, JNI_FALSE, it->second);
+            if (env->ExceptionCheck()) {
+                env->ExceptionClear();
+                failed++;
+            } else {
+                loaded++;
+            }
+            env->PopLocalFrame(nullptr);
+        }
+
+        for (const auto& [name, loader] : resolved) {
+            if (loader) env->DeleteGlobalRef(loader);
+        }
+        {
+            std::lock_guard guard(lock);
+            for (auto& [name, loader] : loaders) {
+                if (loader) env->DeleteWeakGlobalRef(loader);
+                loader = nullptr;
+            }
+            loaders.clear();
+            missingLoaders = 0;
+        }
+        env->DeleteLocalRef(classClass);
+
+        std::cerr << "[Rynox] Prewarmed " << loaded << " classes, " << failed << " failed." << std::endl;
+        Client::jvm->DetachCurrentThread();
+        return nullptr;
+    }
+}
+
+bool Prewarm::enabled() {
+    return !orderPath.empty();
+}
+
+bool Prewarm::replaying() {
+    return replayMode;
+}
+
+void Prewarm::configure() {
+    orderPath = Options::get("prewarm");
+    if (!enabled()) return;
+
+    replayMode = loadOrder();
+    if (replayMode) return;
+
+    recording = true;
+    Milestones::onReached(Options::get("prewarm-until", Milestones::FirstFrame), [](const Milestones::Milestone&) {
+        recording = false;
+        std::thread(&Prewarm::write).detach();
+    });
+}
+
+void Prewarm::onClassLoad(JNIEnv* env, jobject loader, std::string_view name, const std::string& loaderName) {
+    if (recording.load(std::memory_order_relaxed)) {
+        if (Agent::isGeneratedClass(name)) return;
+        std::lock_guard guard(lock);
+        entries.push_back({loaderName, std::string(name)});
+        return;
+    }
+
+    if (missingLoaders.load(std::memory_order_relaxed) == 0 || !loader) return;
+    std::lock_guard guard(lock);
+    auto it = loaders.find(loaderName);
+    if (it == loaders.end() || it->second) return;
+    it->second = env->NewWeakGlobalRef(loader);
+    missingLoaders--;
+}
+
+void Prewarm::start() {
+    if (!replayMode || entries.empty()) return;
+
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, &runPrewarm, nullptr) != 0) {
+        std::cerr << "[Rynox] Failed to create prewarm thread." << std::endl;
+        return;
+    }
+    pthread_detach(thread);
+}
+
+void Prewarm::write() {
+    if (replayMode || !enabled() || written.exchange(true)) return;
+    recording = false;
+
+    std::lock_guard guard(lock);
+    std::ofstream out(orderPath, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[Rynox] Failed to write class-load order to " << orderPath << "." << std::endl;
+        return;
+    }
+    out << "# Rynox class-load order: <loader class> <class>\n";
+    for (const auto& entry : entries) out << entry.loader << " " << entry.name << "\n";
+    std::cerr << "[Rynox] Recorded " << entries.size() << " classes for prewarming to " << orderPath << "." << std::endl;
+}
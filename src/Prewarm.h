@@ -0,0 +1,24 @@
+#ifndef PREWARM_H
+#define PREWARM_H
+
+#include <jni.h>
+#include <string>
+#include <string_view>
+
+// Background class prewarming, enabled with "prewarm=<path>". Without a file at that path the agent
+// records the class-load order with each class's loader until "prewarm-until=<milestone>" (first-frame
+// by default). With a recorded file, a low-priority daemon thread replays it through
+// Class.forName(name, false, loader) so the main thread finds the classes already loaded.
+namespace Prewarm {
+    bool enabled();
+    bool replaying();
+    void configure();
+
+    void onClassLoad(JNIEnv* env, jobject loader, std::string_view name, const std::string& loaderName);
+
+    // Starts the replay thread; called once the client thread is attached to a live VM.
+    void start();
+    void write();
+}
+
+#endif //PREWARM_H
@@ -0,0 +1,702 @@
+#include "Probes.h"
+#include "Agent.h"
+#include "ClassFile.h"
+#include "ClassFilter.h"
+#include "Instrumenter.h"
+#include "Mappings.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Trace.h"
+#include "TransformCache.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <set>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    constexpr size_t MaxProbes = 1024;
+    // Wrapped natives take ids from NativeBase on, so a large native selection (native-gl) cannot
+    // crowd out probe= and count= targets, and a frame boundary reads one contiguous range per stripe.
+    constexpr size_t MaxNatives = 1024;
+    constexpr int32_t NativeBase = MaxProbes;
+    constexpr size_t Buckets = 32;
+    constexpr uint32_t MaxDepth = 64;
+
+    struct Stats {
+        std::atomic<uint64_t> calls = 0;
+        std::atomic<uint64_t> totalNanos = 0;
+        std::atomic<uint64_t> maxNanos = 0;
+        // Bucket i counts calls shorter than 2^i microseconds.
+        std::array<std::atomic<uint64_t>, Buckets> histogram{};
+        std::atomic<uint64_t> traceName = 0;
+        // Counted probes keep their calls in the counter stripes instead.
+        std::atomic_bool counted = false;
+        // Wrapped natives also keep their time in the nanos stripes.
+        std::atomic_bool native = false;
+        std::atomic<uint8_t> category = 0;
+    };
+
+    enum Category : uint8_t {
+        OtherCall,
+        DrawCall,
+        StateChange,
+    };
+
+    // Native totals, summed over the wrapped methods.
+    struct NativeTotals {
+        uint64_t calls = 0;
+        uint64_t draws = 0;
+        uint64_t stateChanges = 0;
+        uint64_t nanos = 0;
+    };
+
+    struct Call {
+        jint probe;
+        uint64_t start;
+    };
+
+    struct CallStack {
+        uint32_t depth = 0;
+        uint64_t threadId = 0;
+        Call calls[MaxDepth];
+    };
+
+    struct MethodTarget {
+        // Method name, "*" for all.
+        std::string method;
+        bool count;
+        bool native = false;
+
+        bool operator==(const MethodTarget&) const = default;
+    };
+
+    // Class name -> selected methods.
+    using Targets = std::unordered_map<std::string, std::vector<MethodTarget>>;
+
+    // Wrapped by "native-gl" when the VM's OpenGL bindings are LWJGL 3.
+    constexpr const char* GlVersions[] = {"11", "12", "13", "14", "15", "20", "21", "30", "31", "32", "33",
+                                          "40", "41", "42", "43", "44", "45", "46"};
+
+    struct Original {
+        std::vector<uint8_t> bytes;
+        // First seen at load rather than by a retransformation, so methods may still be added to it.
+        bool loaded;
+    };
+
+    std::string reportPath;
+    std::string controlPath;
+    bool configured = false;
+    std::atomic_bool defined = false;
+    std::atomic_bool running = false;
+
+    std::mutex targetLock;
+    Targets targets;
+    // Fixed at startup: a wrapper adds methods, which only a class's first load may do.
+    Targets nativeTargets;
+    bool nativePrefix = false;
+    // Perfect-hash view of the target class names for the hook's fast path. Replaced filters are kept
+    // alive, since a hook may still be reading one; the set changes only by hand.
+    std::atomic<const ClassFilter*> filter = nullptr;
+    std::vector<std::unique_ptr<ClassFilter>> filters;
+    // Bytes each instrumented class was first seen with, by "<name>@<loader hash>", so detaching
+    // restores them exactly rather than relying on the VM's reconstituted class file.
+    std::mutex originalLock;
+    std::unordered_map<std::string, Original> originals;
+
+    std::mutex registryLock;
+    // Indexed by id, and by id - NativeBase.
+    std::vector<std::string> names;
+    std::vector<std::string> nativeNames;
+    std::unordered_map<std::string, int32_t> ids;
+    bool registryFull = false;
+    bool nativesFull = false;
+    std::array<Stats, MaxProbes + MaxNatives> stats;
+    static_assert(MaxProbes + MaxNatives <= Instrumenter::MaxCounters);
+    // Registered natives and their categories, readable without the registry lock.
+    std::atomic<size_t> nativeCount = 0;
+    std::array<std::atomic<uint8_t>, MaxNatives> nativeCategories{};
+    // CounterStripes stripes of MaxCounters native-order longs, behind rynox/Probes.counters.
+    int64_t* counters = nullptr;
+    // Same layout, elapsed nanoseconds of the wrapped natives, behind rynox/Probes.nanos.
+    int64_t* nanos = nullptr;
+
+    // Native totals at the last frame boundary and their per-frame sums since the first.
+    std::mutex frameLock;
+    NativeTotals lastFrame;
+    NativeTotals frameSums;
+    uint64_t frames = 0;
+    bool frameStarted = false;
+
+    thread_local CallStack callStack;
+
+    // LWJGL's unsafe variants carry an extra 'n' (nglDrawElements).
+    Category categorize(std::string_view probe) {
+        size_t parenthesis = probe.find('(');
+        size_t dot = probe.rfind('.', parenthesis);
+        std::string_view method = probe.substr(dot + 1, parenthesis - dot - 1);
+        if (method.rfind("ngl", 0) == 0) method.remove_prefix(1);
+        auto startsWith = [&](std::initializer_list<std::string_view> prefixes) {
+            return std::any_of(prefixes.begin(), prefixes.end(), [&](std::string_view prefix) { return method.rfind(prefix, 0) == 0; });
+        };
+        if (startsWith({"glDraw", "glMultiDraw"})) return DrawCall;
+        if (startsWith({"glBind", "glUseProgram", "glEnable", "glDisable", "glBlend", "glDepth", "glColorMask", "glCullFace",
+                        "glActiveTexture", "glViewport", "glScissor", "glPolygon", "glStencil", "glFrontFace", "glLineWidth"})) {
+            return StateChange;
+        }
+        return OtherCall;
+    }
+
+    int32_t registerProbe(std::string name, bool counted, bool native = false) {
+        std::lock_guard guard(registryLock);
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            stats[it->second].counted = counted;
+            return it->second;
+        }
+        if (native) {
+            if (nativeNames.size() >= MaxNatives) {
+                if (!nativesFull) std::cerr << "[Rynox] Native limit of " << MaxNatives << " methods reached." << std::endl;
+                nativesFull = true;
+                return -1;
+            }
+            auto index = nativeNames.size();
+            auto id = static_cast<int32_t>(NativeBase + index);
+            stats[id].native = true;
+            stats[id].category = categorize(name);
+            nativeCategories[index].store(stats[id].category, std::memory_order_relaxed);
+            ids.emplace(name, id);
+            nativeNames.push_back(std::move(name));
+            nativeCount.store(nativeNames.size(), std::memory_order_release);
+            return id;
+        }
+        if (names.size() >= MaxProbes) {
+            if (!registryFull) std::cerr << "[Rynox] Probe limit of " << MaxProbes << " methods reached." << std::endl;
+            registryFull = true;
+            return -1;
+        }
+        auto id = static_cast<int32_t>(names.size());
+        if (Trace::enabled()) stats[id].traceName = Trace::string(name);
+        stats[id].counted = counted;
+        ids.emplace(name, id);
+        names.push_back(std::move(name));
+        return id;
+    }
+
+    void JNICALL probeEnter(JNIEnv* env, jclass, jint probe) {
+        CallStack& stack = callStack;
+        if (stack.depth < MaxDepth) stack.calls[stack.depth] = {probe, Platform::nanoTime()};
+        stack.depth++;
+    }
+
+    void JNICALL probeExit(JNIEnv* env, jclass, jint probe) {
+        uint64_t now = Platform::nanoTime();
+        CallStack& stack = callStack;
+        if (stack.depth == 0 || --stack.depth >= MaxDepth) return;
+        const Call& call = stack.calls[stack.depth];
+        if (call.probe != probe || probe < 0 || static_cast<size_t>(probe) >= MaxProbes) return;
+
+        uint64_t duration = now - call.start;
+        Stats& probeStats = stats[probe];
+        probeStats.calls.fetch_add(1, std::memory_order_relaxed);
+        probeStats.totalNanos.fetch_add(duration, std::memory_order_relaxed);
+        uint64_t max = probeStats.maxNanos.load(std::memory_order_relaxed);
+        while (duration > max && !probeStats.maxNanos.compare_exchange_weak(max, duration, std::memory_order_relaxed)) {}
+        size_t bucket = 0;
+        while (bucket + 1 < Buckets && (duration / 1000) >> bucket) bucket++;
+        probeStats.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+        if (!Trace::enabled()) return;
+        if (!stack.threadId) stack.threadId = Trace::threadId(Agent::jvmti, env, nullptr);
+        Trace::methodCall(call.start, stack.threadId, probeStats.traceName.load(std::memory_order_relaxed), duration);
+    }
+
+    // Merged on read; every increment is atomic, so a total misses only the adds still in flight.
+    uint64_t counterTotal(int64_t* buffer, int32_t probe) {
+        uint64_t total = 0;
+        for (uint32_t stripe = 0; stripe < Instrumenter::CounterStripes; stripe++) {
+            total += static_cast<uint64_t>(std::atomic_ref<int64_t>(buffer[stripe * Instrumenter::MaxCounters + probe]).load(std::memory_order_relaxed));
+        }
+        return total;
+    }
+
+    // public final class rynox/Probes {
+    //     public static final ByteBuffer counters;
+    //     public static final ByteBuffer nanos;
+    //     public static final VarHandle longs;
+    //     static native void enter(int);
+    //     static native void exit(int);
+    // }
+    std::vector<uint8_t> probeClass() {
+        std::vector<uint8_t> out;
+        auto u1 = [&](uint32_t value) { out.push_back(static_cast<uint8_t>(value)); };
+        auto u2 = [&](uint32_t value) { u1(value >> 8), u1(value); };
+        auto utf8 = [&](std::string_view text) {
+            u1(JVM_CONSTANT_Utf8), u2(static_cast<uint32_t>(text.size()));
+            out.insert(out.end(), text.begin(), text.end());
+        };
+        u2(0xCAFE), u2(0xBABE), u2(0), u2(52);
+        u2(13);
+        utf8(Instrumenter::ProbeClass);
+        u1(JVM_CONSTANT_Class), u2(1);
+        utf8("java/lang/Object");
+        u1(JVM_CONSTANT_Class), u2(3);
+        utf8(Instrumenter::EnterMethod);
+        utf8(Instrumenter::ExitMethod);
+        utf8(Instrumenter::ProbeDescriptor);
+        utf8(Instrumenter::CounterField);
+        utf8("Ljava/nio/ByteBuffer;");
+        utf8(Instrumenter::NanosField);
+        utf8(Instrumenter::HandleField);
+        utf8("Ljava/lang/invoke/VarHandle;");
+        u2(JVM_ACC_PUBLIC | JVM_ACC_FINAL | JVM_ACC_SUPER), u2(2), u2(4), u2(0);
+        u2(3);
+        for (uint32_t name : {8u, 10u}) u2(JVM_ACC_PUBLIC | JVM_ACC_STATIC | JVM_ACC_FINAL), u2(name), u2(9), u2(0);
+        u2(JVM_ACC_PUBLIC | JVM_ACC_STATIC | JVM_ACC_FINAL), u2(11), u2(12), u2(0);
+        u2(2);
+        for (uint32_t name : {5u, 6u}) u2(JVM_ACC_PUBLIC | JVM_ACC_STATIC | JVM_ACC_NATIVE), u2(name), u2(7), u2(0);
+        u2(0);
+        return out;
+    }
+
+    // Sets a static field of Probes to a native-order direct buffer over new stripes, before any counted method runs.
+    bool publishStripes(JNIEnv* env, jclass probes, const char* name, int64_t*& stripes) {
+        size_t size = sizeof(int64_t) * Instrumenter::CounterStripes * Instrumenter::MaxCounters;
+        stripes = static_cast<int64_t*>(std::aligned_alloc(64, size));
+        if (!stripes) return false;
+        std::memset(stripes, 0, size);
+
+        jobject buffer = env->NewDirectByteBuffer(stripes, static_cast<jlong>(size));
+        jclass orderClass = env->FindClass("java/nio/ByteOrder");
+        jclass bufferClass = env->FindClass("java/nio/ByteBuffer");
+        if (!buffer || !orderClass || !bufferClass) return false;
+        jmethodID nativeOrder = env->GetStaticMethodID(orderClass, "nativeOrder", "()Ljava/nio/ByteOrder;");
+        jmethodID order = env->GetMethodID(bufferClass, "order", "(Ljava/nio/ByteOrder;)Ljava/nio/ByteBuffer;");
+        jfieldID field = env->GetStaticFieldID(probes, name, "Ljava/nio/ByteBuffer;");
+        if (!nativeOrder || !order || !field) return false;
+        jobject byteOrder = env->CallStaticObjectMethod(orderClass, nativeOrder);
+        jobject ordered = env->CallObjectMethod(buffer, order, byteOrder);
+        if (env->ExceptionCheck() || !ordered) return false;
+        env->SetStaticObjectField(probes, field, ordered);
+
+        env->DeleteLocalRef(ordered);
+        env->DeleteLocalRef(byteOrder);
+        env->DeleteLocalRef(buffer);
+        env->DeleteLocalRef(orderClass);
+        env->DeleteLocalRef(bufferClass);
+        return true;
+    }
+
+    // Sets Probes.longs, the long view whose getAndAdd the counted methods and native wrappers call.
+    bool publishHandle(JNIEnv* env, jclass probes) {
+        jclass handles = env->FindClass("java/lang/invoke/MethodHandles");
+        jclass orderClass = env->FindClass("java/nio/ByteOrder");
+        jclass longArray = env->FindClass("[J");
+        if (!handles || !orderClass || !longArray) return false;
+        jmethodID view = env->GetStaticMethodID(handles, "byteBufferViewVarHandle",
+                                                "(Ljava/lang/Class;Ljava/nio/ByteOrder;)Ljava/lang/invoke/VarHandle;");
+        jmethodID nativeOrder = env->GetStaticMethodID(orderClass, "nativeOrder", "()Ljava/nio/ByteOrder;");
+        jfieldID field = env->GetStaticFieldID(probes, Instrumenter::HandleField, "Ljava/lang/invoke/VarHandle;");
+        if (!view || !nativeOrder || !field) return false;
+        jobject byteOrder = env->CallStaticObjectMethod(orderClass, nativeOrder);
+        jobject handle = env->CallStaticObjectMethod(handles, view, longArray, byteOrder);
+        if (env->ExceptionCheck() || !handle) return false;
+        env->SetStaticObjectField(probes, field, handle);
+
+        env->DeleteLocalRef(handle);
+        env->DeleteLocalRef(byteOrder);
+        env->DeleteLocalRef(longArray);
+        env->DeleteLocalRef(orderClass);
+        env->DeleteLocalRef(handles);
+        return true;
+    }
+
+    bool addTarget(Targets& into, const std::string& target, bool count, bool native = false) {
+        size_t dot = target.rfind('.');
+        if (dot == std::string::npos || dot == 0 || dot + 1 == target.size()) {
+            std::cerr << "[Rynox] Ignoring probe \"" << target << "\", expected <class>.<method>." << std::endl;
+            return false;
+        }
+        std::string className = target.substr(0, dot);
+        std::string method = target.substr(dot + 1);
+        // Mapped names select the obfuscated class; an overloaded name takes its first overload's obfuscated name.
+        Mappings::Method obfuscated;
+        if (Mappings::enabled() && Mappings::obfuscateMethod(className, method == "*" ? std::string_view() : method, {}, obfuscated)) {
+            className = std::move(obfuscated.owner);
+            if (method != "*") method = std::move(obfuscated.name);
+        }
+        into[className].push_back({std::move(method), count, native});
+        return true;
+    }
+
+    // Called with targetLock held.
+    void publishFilter() {
+        std::set<std::string> classNames;
+        for (const auto& [name, methods] : targets) classNames.insert(name);
+        for (const auto& [name, methods] : nativeTargets) classNames.insert(name);
+        filters.push_back(std::make_unique<ClassFilter>(std::vector<std::string>(classNames.begin(), classNames.end())));
+        filter.store(filters.back().get(), std::memory_order_release);
+    }
+
+    // One <class>.<method> per line, "count <class>.<method>" for a counter; blank lines and # comments are skipped.
+    Targets readControlFile() {
+        Targets read;
+        std::ifstream in(controlPath);
+        std::string line;
+        while (std::getline(in, line)) {
+            line.erase(0, line.find_first_not_of(" \t"));
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (line.empty() || line[0] == '#') continue;
+            bool count = line.rfind("count ", 0) == 0;
+            addTarget(read, count ? line.substr(line.find_first_not_of(' ', 6)) : line, count);
+        }
+        return read;
+    }
+
+    void retransform(jvmtiEnv* jvmti, JNIEnv* env, const std::set<std::string>& classNames) {
+        jint count = 0;
+        jclass* classes = nullptr;
+        if (jvmti->GetLoadedClasses(&count, &classes) != JVMTI_ERROR_NONE) return;
+
+        std::vector<jclass> selected;
+        for (jint i = 0; i < count; i++) {
+            jboolean modifiable = JNI_FALSE;
+            if (jvmti->IsModifiableClass(classes[i], &modifiable) == JVMTI_ERROR_NONE && modifiable &&
+                classNames.count(Agent::className(jvmti, classes[i]))) {
+                selected.push_back(classes[i]);
+            }
+        }
+        if (!selected.empty()) {
+            jvmtiError error = jvmti->RetransformClasses(static_cast<jint>(selected.size()), selected.data());
+            if (error != JVMTI_ERROR_NONE) std::cerr << "[Rynox] Failed to retransform probed classes (JVMTI error " << error << ")." << std::endl;
+        }
+        for (jint i = 0; i < count; i++) env->DeleteLocalRef(classes[i]);
+        jvmti->Deallocate(reinterpret_cast<unsigned char*>(classes));
+    }
+
+    void* runControl(void*) {
+        JNIEnv* env = nullptr;
+        JavaVMAttachArgs args{JNI_VERSION_1_8, const_cast<char*>("Rynox Probes"), nullptr};
+        if (Agent::jvm->AttachCurrentThreadAsDaemon(reinterpret_cast<void**>(&env), &args) != JNI_OK || !env) {
+            std::cerr << "[Rynox] Failed to attach probe control thread to JVM." << std::endl;
+            return nullptr;
+        }
+        jvmtiEnv* jvmti = Agent::jvmti;
+
+        // Until the file first appears, the "probe" options stay in effect.
+        struct timespec lastChange{};
+        bool present = false;
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            struct stat info{};
+            bool exists = stat(controlPath.c_str(), &info) == 0;
+            if (exists == present && (!exists || (info.st_mtim.tv_sec == lastChange.tv_sec && info.st_mtim.tv_nsec == lastChange.tv_nsec))) continue;
+            present = exists;
+            lastChange = exists ? info.st_mtim : timespec{};
+
+            // A missing file detaches everything; the classes whose selection changed are retransformed.
+            Targets next = exists ? readControlFile() : Targets();
+            std::set<std::string> changed;
+            {
+                std::lock_guard guard(targetLock);
+                for (const auto& [name, methods] : targets) {
+                    auto it = next.find(name);
+                    if (it == next.end() || it->second != methods) changed.insert(name);
+                }
+                for (const auto& [name, methods] : next) {
+                    if (!targets.count(name)) changed.insert(name);
+                }
+                targets = std::move(next);
+                publishFilter();
+            }
+            if (changed.empty()) continue;
+            std::cerr << "[Rynox] Probes changed in " << changed.size() << " classes, retransforming." << std::endl;
+            retransform(jvmti, env, changed);
+        }
+        return nullptr;
+    }
+
+    uint64_t bucketMicros(const Stats& probeStats, double quantile) {
+        uint64_t calls = probeStats.calls.load();
+        uint64_t seen = 0;
+        for (size_t i = 0; i < Buckets; i++) {
+            seen += probeStats.histogram[i].load();
+            if (seen && seen >= quantile * calls) return 1ull << i;
+        }
+        return 1ull << (Buckets - 1);
+    }
+}
+
+bool Probes::enabled() {
+    return configured;
+}
+
+void Probes::configure() {
+    reportPath = Options::get("probe-report");
+    controlPath = Options::get("probe-control");
+    for (const auto& target : Options::getAll("probe")) addTarget(targets, target, false);
+    for (const auto& target : Options::getAll("count")) addTarget(targets, target, true);
+    for (const auto& target : Options::getAll("native")) addTarget(nativeTargets, target, false, true);
+    if (Options::has("native-gl")) {
+        for (const char* version : GlVersions) {
+            for (const char* suffix : {"", "C"}) nativeTargets[std::string("org/lwjgl/opengl/GL") + version + suffix].push_back({"*", false, true});
+        }
+    }
+    configured = !targets.empty() || !nativeTargets.empty() || !controlPath.empty();
+    if (!configured) return;
+    publishFilter();
+    TransformCache::configure();
+}
+
+void Probes::start(JNIEnv* env) {
+    if (!enabled() || defined) return;
+
+    std::vector<uint8_t> bytes = probeClass();
+    jclass klass = env->DefineClass(Instrumenter::ProbeClass, nullptr, reinterpret_cast<const jbyte*>(bytes.data()),
+                                    static_cast<jsize>(bytes.size()));
+    const JNINativeMethod natives[] = {
+        {const_cast<char*>(Instrumenter::EnterMethod), const_cast<char*>(Instrumenter::ProbeDescriptor), reinterpret_cast<void*>(&probeEnter)},
+        {const_cast<char*>(Instrumenter::ExitMethod), const_cast<char*>(Instrumenter::ProbeDescriptor), reinterpret_cast<void*>(&probeExit)},
+    };
+    if (!klass || env->RegisterNatives(klass, natives, 2) != JNI_OK || !publishHandle(env, klass) ||
+        !publishStripes(env, klass, Instrumenter::CounterField, counters) ||
+        (nativePrefix && !publishStripes(env, klass, Instrumenter::NanosField, nanos))) {
+        if (env->ExceptionCheck()) env->ExceptionClear();
+        std::cerr << "[Rynox] Failed to define " << Instrumenter::ProbeClass << ", method probes are disabled." << std::endl;
+        return;
+    }
+    env->DeleteLocalRef(klass);
+    defined = true;
+
+    if (controlPath.empty()) return;
+    jvmtiCapabilities capabilities{};
+    Agent::jvmti->GetCapabilities(&capabilities);
+    if (!capabilities.can_retransform_classes) {
+        std::cerr << "[Rynox] Classes cannot be retransformed, ignoring probe-control." << std::endl;
+        return;
+    }
+    running = true;
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, &runControl, nullptr) != 0) {
+        std::cerr << "[Rynox] Failed to create probe control thread." << std::endl;
+        running = false;
+        return;
+    }
+    pthread_detach(thread);
+}
+
+bool Probes::nativesEnabled() {
+    return !nativeTargets.empty();
+}
+
+void Probes::setNativePrefix(jvmtiEnv* jvmti) {
+    jvmtiCapabilities capabilities{};
+    jvmti->GetCapabilities(&capabilities);
+    jvmtiError error = capabilities.can_set_native_method_prefix ? jvmti->SetNativeMethodPrefix(Instrumenter::NativePrefix)
+                                                                 : JVMTI_ERROR_MUST_POSSESS_CAPABILITY;
+    if (error != JVMTI_ERROR_NONE) {
+        std::cerr << "[Rynox] Failed to set the native method prefix (JVMTI error " << error << "), natives are not wrapped." << std::endl;
+        return;
+    }
+    nativePrefix = true;
+}
+
+void Probes::onFrame(uint64_t nanoTime, uint64_t threadId) {
+    if (!nanos) return;
+    // Stripe by stripe over the natives' contiguous slots, rather than every stripe of one id at a time.
+    size_t registered = nativeCount.load(std::memory_order_acquire);
+    std::array<uint8_t, MaxNatives> categories;
+    for (size_t i = 0; i < registered; i++) categories[i] = nativeCategories[i].load(std::memory_order_relaxed);
+    NativeTotals now;
+    for (uint32_t stripe = 0; stripe < Instrumenter::CounterStripes; stripe++) {
+        int64_t* stripeCalls = counters + stripe * Instrumenter::MaxCounters + NativeBase;
+        int64_t* stripeNanos = nanos + stripe * Instrumenter::MaxCounters + NativeBase;
+        for (size_t i = 0; i < registered; i++) {
+            auto calls = static_cast<uint64_t>(std::atomic_ref<int64_t>(stripeCalls[i]).load(std::memory_order_relaxed));
+            now.calls += calls;
+            now.nanos += static_cast<uint64_t>(std::atomic_ref<int64_t>(stripeNanos[i]).load(std::memory_order_relaxed));
+            if (categories[i] == DrawCall) now.draws += calls;
+            else if (categories[i] == StateChange) now.stateChanges += calls;
+        }
+    }
+
+    std::lock_guard guard(frameLock);
+    NativeTotals frame{now.calls - lastFrame.calls, now.draws - lastFrame.draws, now.stateChanges - lastFrame.stateChanges,
+                       now.nanos - lastFrame.nanos};
+    // The first boundary only sets the baseline; everything before it was loading.
+    bool first = !frameStarted;
+    frameStarted = true;
+    lastFrame = now;
+    if (first) return;
+    frames++;
+    frameSums.calls += frame.calls;
+    frameSums.draws += frame.draws;
+    frameSums.stateChanges += frame.stateChanges;
+    frameSums.nanos += frame.nanos;
+    Trace::nativeFrame(nanoTime, threadId, frame.calls, frame.draws, frame.stateChanges, frame.nanos);
+}
+
+void Probes::stop() {
+    running = false;
+}
+
+void Probes::onClassFileLoadHook(jvmtiEnv* jvmti, jobject loader, const char* name, bool retransforming, jint classDataLength,
+                                 const unsigned char* classData, jint* newClassDataLength, unsigned char** newClassData) {
+    if (!defined.load(std::memory_order_acquire) || !name) return;
+    const ClassFilter* targeted = filter.load(std::memory_order_acquire);
+    bool target = targeted && targeted->contains(name);
+    if (!target && !retransforming) return;
+
+    std::vector<MethodTarget> methods;
+    if (target) {
+        std::lock_guard guard(targetLock);
+        auto it = targets.find(name);
+        if (it != targets.end()) methods = it->second;
+    }
+    auto natives = nativePrefix && target ? nativeTargets.find(name) : nativeTargets.end();
+    if (natives != nativeTargets.end()) methods.insert(methods.end(), natives->second.begin(), natives->second.end());
+
+    // Entries are never erased, so the cached bytes stay valid once the lock is released and loading
+    // threads rewrite their classes in parallel.
+    const Original* original = nullptr;
+    {
+        std::string key = std::string(name) + "@" + std::to_string(Agent::loaderHash(jvmti, loader));
+        std::lock_guard guard(originalLock);
+        auto it = originals.find(key);
+        if (it != originals.end()) original = &it->second;
+        else if (!methods.empty()) original = &originals.emplace(key, Original{{classData, classData + classDataLength}, !retransforming}).first->second;
+    }
+    if (!original) return;
+    // Natives are wrapped at every transformation of a class loaded with them selected, and never otherwise.
+    if (!original->loaded) std::erase_if(methods, [](const MethodTarget& selected) { return selected.native; });
+
+    // Reused per thread so steady-state loading does not allocate for the parse.
+    thread_local ClassFile classFile;
+    thread_local std::vector<uint8_t> rewritten;
+    thread_local std::vector<Instrumenter::ProbeSite> sites;
+    thread_local TransformCache::Entry entry;
+    rewritten.clear();
+    if (methods.empty()) {
+        // Detached: back to the exact original bytes, so the JIT recompiles without the probes.
+        rewritten = original->bytes;
+    } else {
+        std::string selection;
+        for (const auto& selected : methods) {
+            selection += (selected.native ? "native " : selected.count ? "count " : "") + selected.method + "\n";
+        }
+        uint64_t cacheKey = TransformCache::enabled() ? TransformCache::key(original->bytes.data(), original->bytes.size(), name, selection) : 0;
+
+        // Renumbers the cached id operands for this launch's probe ids, unless the registry is full.
+        auto fromCache = [&]() {
+            if (!cacheKey || !TransformCache::load(cacheKey, entry)) return false;
+            std::vector<int32_t> ids;
+            for (const auto& probe : entry.probes) ids.push_back(registerProbe(probe.name, probe.count, probe.native));
+            if (std::find(ids.begin(), ids.end(), -1) != ids.end()) return false;
+            rewritten.swap(entry.classData);
+            for (const auto& site : entry.sites) {
+                rewritten[site.offset] = static_cast<uint8_t>(ids[site.probe] >> 8);
+                rewritten[site.offset + 1] = static_cast<uint8_t>(ids[site.probe]);
+            }
+            return true;
+        };
+        if (!fromCache()) {
+            if (!classFile.parse(original->bytes.data(), original->bytes.size())) return;
+            rewritten.clear();
+            sites.clear();
+            std::vector<TransformCache::Probe> probes;
+            std::vector<int32_t> probeIds;
+            auto select = [&](std::string_view method, std::string_view descriptor, bool isNative) {
+                Instrumenter::Selection selection;
+                for (const auto& selected : methods) {
+                    if (selected.native != isNative || (selected.method != "*" && selected.method != method)) continue;
+                    std::string probe = Mappings::describe(name, method, descriptor);
+                    selection = {registerProbe(probe, selected.count, selected.native), selected.count};
+                    if (selection.id >= 0) probes.push_back({std::move(probe), selected.count, selected.native}), probeIds.push_back(selection.id);
+                    break;
+                }
+                return selection;
+            };
+            bool instrumented = Instrumenter::rewrite(classFile, select, rewritten, cacheKey ? &sites : nullptr);
+            if (!instrumented) {
+                std::cerr << "[Rynox] No probes inserted into " << name << "." << std::endl;
+                return;
+            }
+            if (cacheKey) {
+                entry.sites.clear();
+                for (const auto& site : sites) {
+                    auto index = std::find(probeIds.begin(), probeIds.end(), site.id) - probeIds.begin();
+                    entry.sites.push_back({site.offset, static_cast<uint32_t>(index)});
+                }
+                entry.probes = std::move(probes);
+                entry.classData = rewritten;
+                TransformCache::store(cacheKey, entry);
+            }
+        }
+    }
+
+    unsigned char* copy = nullptr;
+    if (jvmti->Allocate(static_cast<jlong>(rewritten.size()), &copy) != JVMTI_ERROR_NONE) return;
+    std::memcpy(copy, rewritten.data(), rewritten.size());
+    *newClassDataLength = static_cast<jint>(rewritten.size());
+    *newClassData = copy;
+}
+
+void Probes::writeReport() {
+    if (!enabled() || reportPath.empty()) return;
+
+    std::ofstream out(reportPath, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[Rynox] Failed to write probe report to " << reportPath << "." << std::endl;
+        return;
+    }
+
+    std::lock_guard guard(registryLock);
+    out << "# Rynox probe report\n";
+    out << "## Timed methods (calls, total ms, mean us, p50 us <=, p99 us <=, max us, method)\n";
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < names.size(); i++) {
+        const Stats& probeStats = stats[i];
+        if (probeStats.counted) continue;
+        uint64_t calls = probeStats.calls.load();
+        double total = static_cast<double>(probeStats.totalNanos.load());
+        out << calls << "\t" << total / 1e6 << "\t" << (calls ? total / 1e3 / static_cast<double>(calls) : 0.0) << "\t"
+            << bucketMicros(probeStats, 0.5) << "\t" << bucketMicros(probeStats, 0.99) << "\t"
+            << static_cast<double>(probeStats.maxNanos.load()) / 1e3 << "\t" << names[i] << "\n";
+    }
+
+    out << "\n## Counted methods (calls, method)\n";
+    for (size_t i = 0; i < names.size(); i++) {
+        if (stats[i].counted && counters) out << counterTotal(counters, static_cast<int32_t>(i)) << "\t" << names[i] << "\n";
+    }
+
+    if (!nanos) return;
+    constexpr const char* CategoryNames[] = {"other", "draw", "state"};
+    out << "\n## Native methods (calls, total ms, mean us, kind, method)\n";
+    for (size_t i = 0; i < nativeNames.size(); i++) {
+        auto id = static_cast<int32_t>(NativeBase + i);
+        uint64_t calls = counterTotal(counters, id);
+        double total = static_cast<double>(counterTotal(nanos, id));
+        out << calls << "\t" << total / 1e6 << "\t" << (calls ? total / 1e3 / static_cast<double>(calls) : 0.0) << "\t"
+            << CategoryNames[stats[id].category.load()] << "\t" << nativeNames[i] << "\n";
+    }
+
+    std::lock_guard frameGuard(frameLock);
+    if (!frames) return;
+    auto perFrame = [&](uint64_t total) { return static_cast<double>(total) / static_cast<double>(frames); };
+    out << "\n## Native calls per frame (frames, calls, draws, state changes, native ms)\n";
+    out << frames << "\t" << perFrame(frameSums.calls) << "\t" << perFrame(frameSums.draws) << "\t"
+        << perFrame(frameSums.stateChanges) << "\t" << perFrame(frameSums.nanos) / 1e6 << "\n";
+}
@@ -0,0 +1,46 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+#include <cstdint>
+#include <jni.h>
+#include <jvmti.h>
+
+// Exact per-call timing of selected methods, enabled with one "probe=<class>.<method>" per target
+// ("<class>.*" takes every method of the class). Target classes are rewritten by the Instrumenter as
+// they load to call rynox/Probes.enter and exit, natives this module defines in the bootstrap loader
+// at VMInit, so classes loaded before that are left alone. Calls are emitted as MethodCall events when
+// tracing; per-method counts, totals, maxima and a log2 latency histogram go to "probe-report=<path>".
+// "count=<class>.<method>" selects the cheaper counting mode instead: the method's entry bumps a slot
+// in an off-heap buffer striped by thread with an atomic add, with no native call, and the report sums
+// the stripes.
+// With "probe-control=<file>" the selection can change at runtime: the file is polled and its lines
+// (<class>.<method> or "count <class>.<method>", # comments) replace the probe set, and the affected classes are retransformed.
+// Detaching gives a class back its original bytes, so the JIT recompiles it without any probe left.
+// Non-target classes are rejected by a perfect-hash ClassFilter without locking, targets are rewritten
+// in parallel on their loading threads, and "probe-cache=<directory>" keeps rewritten classes across
+// launches (see TransformCache). Targets may use mapped names when "mappings" is loaded.
+// "native=<class>.<method>" wraps a native method instead (see Instrumenter), counting and timing every
+// call into a second set of stripes; "native-gl" selects every native of LWJGL's GLxx and GLxxC classes.
+// Natives are only wrapped in classes loaded after VMInit, and the selection cannot change at runtime.
+// At each frame boundary (see FrameClock) the wrapped calls since the last one are summed into a
+// NativeFrame event: calls, draw calls (glDraw*, glMultiDraw*), state changes (glBind*, glEnable*, ...)
+// and time spent in native code; the report gets per-method totals and per-frame means.
+namespace Probes {
+    bool enabled();
+    bool nativesEnabled();
+    void configure();
+    // Needs can_set_native_method_prefix; natives are not wrapped without it.
+    void setNativePrefix(jvmtiEnv* jvmti);
+
+    // Defines rynox/Probes and binds its natives, then starts watching the control file; needs a live JNIEnv.
+    void start(JNIEnv* env);
+    void stop();
+    void onClassFileLoadHook(jvmtiEnv* jvmti, jobject loader, const char* name, bool retransforming, jint classDataLength,
+                             const unsigned char* classData, jint* newClassDataLength, unsigned char** newClassData);
+
+    // Called on the frame boundary's thread.
+    void onFrame(uint64_t nanoTime, uint64_t threadId);
+    void writeReport();
+}
+
+#endif //PROBES_H
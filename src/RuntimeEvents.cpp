@@ -0,0 +1,77 @@
+#include "RuntimeEvents.h"
+#include "Agent.h"
+#include "FlightRecorder.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+namespace {
+    long monitorThresholdNanos = -1;
+    std::atomic<uint64_t> collectionStart = 0;
+
+    // Monitor events arrive on the waiting thread itself, so the start time can live in a TLS slot.
+    thread_local uint64_t waitStart = 0;
+    thread_local uint64_t enterStart = 0;
+
+    void finishWait(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object, uint64_t& start, bool contended) {
+        uint64_t now = Platform::nanoTime();
+        uint64_t began = start;
+        start = 0;
+        if (!began || now - began < static_cast<uint64_t>(monitorThresholdNanos)) return;
+
+        jclass klass = env->GetObjectClass(object);
+        std::string name = Agent::className(jvmti, klass);
+        env->DeleteLocalRef(klass);
+        Trace::monitorWait(began, Trace::threadId(jvmti, env, thread), name, now - began, contended);
+    }
+}
+
+bool RuntimeEvents::enabled() {
+    return Trace::enabled();
+}
+
+bool RuntimeEvents::monitorsEnabled() {
+    return monitorThresholdNanos >= 0;
+}
+
+void RuntimeEvents::configure() {
+    if (!enabled() || !Options::has("trace-monitors")) return;
+    monitorThresholdNanos = std::max(0L, Options::getLong("trace-monitors", 1)) * 1000000L;
+}
+
+void RuntimeEvents::onGarbageCollectionStart() {
+    collectionStart.store(Platform::nanoTime(), std::memory_order_relaxed);
+}
+
+void RuntimeEvents::onGarbageCollectionFinish() {
+    uint64_t start = collectionStart.exchange(0, std::memory_order_relaxed);
+    if (!start) return;
+    uint64_t duration = Platform::nanoTime() - start;
+    Trace::garbageCollection(start, Platform::currentThreadId(), duration);
+    if (FlightRecorder::enabled()) FlightRecorder::onGarbageCollection(duration);
+}
+
+void RuntimeEvents::onCompiledMethodLoad(jvmtiEnv* jvmti, jmethodID method, jint codeSize) {
+    JNIEnv* env = nullptr;
+    if (Agent::jvm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_8) != JNI_OK || !env) return;
+    Trace::compiledMethod(jvmti, env, Platform::nanoTime(), Platform::currentThreadId(), method, static_cast<uint64_t>(codeSize));
+}
+
+void RuntimeEvents::onMonitorWait(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object) {
+    waitStart = Platform::nanoTime();
+}
+
+void RuntimeEvents::onMonitorWaited(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object) {
+    finishWait(jvmti, env, thread, object, waitStart, false);
+}
+
+void RuntimeEvents::onMonitorContendedEnter(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object) {
+    enterStart = Platform::nanoTime();
+}
+
+void RuntimeEvents::onMonitorContendedEntered(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object) {
+    finishWait(jvmti, env, thread, object, enterStart, true);
+}
@@ -0,0 +1,25 @@
+#ifndef RUNTIME_EVENTS_H
+#define RUNTIME_EVENTS_H
+
+#include <jvmti.h>
+
+// JVM runtime activity for the trace timeline, active whenever "trace" is set: GC pauses (start to
+// finish) and JIT-compiled method installs. "trace-monitors=<ms>" also records Object.wait calls and
+// contended monitor enters lasting at least that long (1 ms when no value is given); monitor events
+// cost a callback per wait, so they are opt-in.
+namespace RuntimeEvents {
+    bool enabled();
+    bool monitorsEnabled();
+    void configure();
+
+    void onGarbageCollectionStart();
+    void onGarbageCollectionFinish();
+    void onCompiledMethodLoad(jvmtiEnv* jvmti, jmethodID method, jint codeSize);
+
+    void onMonitorWait(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object);
+    void onMonitorWaited(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object);
+    void onMonitorContendedEnter(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object);
+    void onMonitorContendedEntered(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object);
+}
+
+#endif //RUNTIME_EVENTS_H
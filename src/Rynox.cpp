@@ -1,4 +1,6 @@
 #include "Rynox.h"
+#include "Agent.h"
+#include "Prewarm.h"
 #include <thread>
 #include <chrono>
 
@@ -20,6 +22,8 @@ void shutdownRynoxClient() {
 }
 
 void* runClient(void* arg) {
+    Agent::awaitLive();
+
     jint attachResult = Client::jvm->AttachCurrentThreadAsDaemon(reinterpret_cast<void**>(&Client::env), nullptr);
     if (attachResult != JNI_OK || !Client::env) {
         std::cerr << "[Rynox] Failed to attach thread to JVM." << std::endl;
@@ -27,6 +31,8 @@ void* runClient(void* arg) {
         return nullptr;
     }
 
+    Prewarm::start();
+
     // Hook Minecraft internal Log4j
     jclass logManagerClass = Client::env->FindClass("org/apache/logging/log4j/LogManager");
     if (!logManagerClass) {
@@ -88,17 +94,20 @@ void* runClient(void* arg) {
 // Agent entry points
 extern "C" JNIEXPORT jint JNICALL Agent_OnLoad(JavaVM* vm, char* options, void* reserved) {
     Client::jvm = vm;
+    Agent::initialize(vm, options, true);
     initializeRynoxClient();
     return JNI_OK;
 }
 
 extern "C" JNIEXPORT void JNICALL Agent_OnUnload(JavaVM* vm) {
     shutdownRynoxClient();
+    Agent::shutdown();
 }
 
 // Agent_OnAttach for dynamic attachment via jattach
 extern "C" JNIEXPORT jint JNICALL Agent_OnAttach(JavaVM* vm, char* options, void* reserved) {
     Client::jvm = vm;
+    Agent::initialize(vm, options, false);
     initializeRynoxClient();
     return JNI_OK;
 }
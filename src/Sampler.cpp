@@ -0,0 +1,129 @@
+#include "Sampler.h"
+#include "Agent.h"
+#include "ContinuousProfiler.h"
+#include "FlightRecorder.h"
+#include "Options.h"
+#include "Pprof.h"
+#include "StackTrie.h"
+#include "SymbolCache.h"
+#include "Platform.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    long intervalMillis = 0;
+    long maxDepth = 128;
+    long allocBytes = 0;
+    std::string stacksPath;
+    std::atomic_bool running = false;
+
+    void* runSampler(void*) {
+        Agent::awaitLive();
+        JNIEnv* env = nullptr;
+        JavaVMAttachArgs args{JNI_VERSION_1_8, const_cast<char*>("Rynox Sampler"), nullptr};
+        if (Agent::jvm->AttachCurrentThreadAsDaemon(reinterpret_cast<void**>(&env), &args) != JNI_OK || !env) {
+            std::cerr << "[Rynox] Failed to attach sampler thread to JVM." << std::endl;
+            return nullptr;
+        }
+        jvmtiEnv* jvmti = Agent::jvmti;
+
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMillis));
+
+            jvmtiStackInfo* stacks = nullptr;
+            jint threadCount = 0;
+            if (jvmti->GetAllStackTraces(static_cast<jint>(maxDepth), &stacks, &threadCount) != JVMTI_ERROR_NONE) continue;
+
+            uint64_t now = Platform::nanoTime();
+            for (jint i = 0; i < threadCount; i++) {
+                const jvmtiStackInfo& stack = stacks[i];
+                if (stack.frame_count > 0) {
+                    bool runnable = stack.state & JVMTI_THREAD_STATE_RUNNABLE;
+                    StackTrie::NodeId leaf;
+                    if (Trace::enabled()) {
+                        leaf = static_cast<StackTrie::NodeId>(Trace::stack(jvmti, env, stack.frame_buffer, stack.frame_count));
+                        Trace::sample(now, Trace::threadId(jvmti, env, stack.thread), leaf, runnable);
+                    } else {
+                        for (jint f = 0; f < stack.frame_count; f++) SymbolCache::lookup(jvmti, env, stack.frame_buffer[f].method);
+                        leaf = StackTrie::insert(stack.frame_buffer, stack.frame_count);
+                    }
+                    StackTrie::record(leaf, StackTrie::WallSamples);
+                    if (runnable) StackTrie::record(leaf, StackTrie::CpuSamples);
+                }
+                env->DeleteLocalRef(stack.thread);
+            }
+            jvmti->Deallocate(reinterpret_cast<unsigned char*>(stacks));
+        }
+
+        Agent::jvm->DetachCurrentThread();
+        return nullptr;
+    }
+}
+
+bool Sampler::enabled() {
+    return intervalMillis > 0;
+}
+
+bool Sampler::allocEnabled() {
+    return allocBytes > 0;
+}
+
+void Sampler::configure() {
+    // The flight recorder, continuous mode and a pprof export without "alloc" are only useful with
+    // stacks, so they imply a default rate.
+    bool needsStacks = FlightRecorder::enabled() || ContinuousProfiler::enabled() || (Pprof::enabled() && !Options::has("alloc"));
+    intervalMillis = Options::getLong("sample", needsStacks ? 20 : 0);
+    maxDepth = std::clamp(Options::getLong("sample-depth", maxDepth), 1L, 2048L);
+    allocBytes = std::clamp(Options::getLong("alloc", 0), 0L, static_cast<long>(INT32_MAX));
+    stacksPath = Options::get("stacks");
+    if (enabled() || allocEnabled()) StackTrie::configure();
+}
+
+long Sampler::intervalNanos() {
+    return intervalMillis * 1000000L;
+}
+
+long Sampler::allocInterval() {
+    return allocBytes;
+}
+
+void Sampler::onSampledObjectAlloc(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jlong size) {
+    thread_local std::vector<jvmtiFrameInfo> frames;
+    frames.resize(static_cast<size_t>(maxDepth));
+    jint count = 0;
+    if (jvmti->GetStackTrace(thread, 0, static_cast<jint>(maxDepth), frames.data(), &count) != JVMTI_ERROR_NONE || count == 0) return;
+
+    for (jint f = 0; f < count; f++) SymbolCache::lookup(jvmti, env, frames[f].method);
+    StackTrie::NodeId leaf = StackTrie::insert(frames.data(), count);
+    // A sample stands for roughly one interval of allocation; objects larger than that for themselves.
+    StackTrie::record(leaf, StackTrie::AllocSamples);
+    StackTrie::record(leaf, StackTrie::AllocBytes, static_cast<uint64_t>(std::max<jlong>(size, allocBytes)));
+}
+
+void Sampler::start() {
+    if (!enabled() || running.exchange(true)) return;
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, &runSampler, nullptr) != 0) {
+        std::cerr << "[Rynox] Failed to create sampler thread." << std::endl;
+        running = false;
+        return;
+    }
+    pthread_detach(thread);
+}
+
+void Sampler::stop() {
+    running = false;
+    if (stacksPath.empty()) return;
+
+    std::vector<uint8_t> data = StackTrie::serialize();
+    std::ofstream out(stacksPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    std::cerr << "[Rynox] Wrote " << StackTrie::size() << " stack nodes (" << data.size() << " bytes) to " << stacksPath << "." << std::endl;
+}
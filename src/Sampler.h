@@ -0,0 +1,24 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <jvmti.h>
+
+// Periodic stack sampler, enabled with "sample=<interval ms>". A daemon thread takes
+// GetAllStackTraces snapshots (up to "sample-depth" frames) and records one wall sample per thread
+// and one CPU sample per runnable thread into the StackTrie. "stacks=<path>" writes the serialized
+// trie on shutdown. "alloc=<bytes>" additionally records SampledObjectAlloc stacks, one sample per
+// that many allocated bytes on average, as allocation counts and estimated bytes.
+namespace Sampler {
+    bool enabled();
+    bool allocEnabled();
+    void configure();
+
+    long intervalNanos();
+    long allocInterval();
+    void onSampledObjectAlloc(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jlong size);
+
+    void start();
+    void stop();
+}
+
+#endif //SAMPLER_H
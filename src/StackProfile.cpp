@@ -0,0 +1,119 @@
+#include "StackProfile.h"
+#include "Varint.h"
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+    struct NodeKey {
+        uint32_t parent;
+        uint32_t method;
+        int64_t location;
+
+        bool operator==(const NodeKey& other) const {
+            return parent == other.parent && method == other.method && location == other.location;
+        }
+    };
+
+    struct NodeKeyHash {
+        size_t operator()(const NodeKey& key) const {
+            uint64_t value = (static_cast<uint64_t>(key.parent) << 32 | key.method) * 0x9e3779b97f4a7c15ull;
+            return static_cast<size_t>(value ^ static_cast<uint64_t>(key.location));
+        }
+    };
+}
+
+bool StackProfile::parse(const uint8_t* data, size_t size) {
+    const uint8_t* cursor = data;
+    const uint8_t* end = data + size;
+    uint64_t version = 0, metricValue = 0, nodeCount = 0, methodCount = 0;
+    if (size < 4 || std::memcmp(data, "RSTK", 4) != 0) return false;
+    cursor += 4;
+    if (!Varint::read(cursor, end, version) || version != 2 || !Varint::read(cursor, end, metricValue) || metricValue > 64) return false;
+    if (!Varint::read(cursor, end, nodeCount) || nodeCount > size) return false;
+
+    metrics = static_cast<size_t>(metricValue);
+    nodeList.clear();
+    counts.assign(static_cast<size_t>(nodeCount) * metrics, 0);
+    methodNames.clear();
+    for (uint64_t i = 0; i < nodeCount; i++) {
+        uint64_t parent = 0, method = 0, location = 0, line = 0;
+        if (!Varint::read(cursor, end, parent) || !Varint::read(cursor, end, method) || !Varint::read(cursor, end, location) ||
+            !Varint::read(cursor, end, line) || parent > i) {
+            return false;
+        }
+        nodeList.push_back({static_cast<uint32_t>(parent), static_cast<uint32_t>(method), Varint::unzigzag(location), Varint::unzigzag(line)});
+        for (size_t m = 0; m < metrics; m++) {
+            if (!Varint::read(cursor, end, counts[i * metrics + m])) return false;
+        }
+    }
+
+    if (!Varint::read(cursor, end, methodCount) || methodCount > size) return false;
+    for (uint64_t i = 0; i < methodCount; i++) {
+        uint64_t length = 0;
+        if (!Varint::read(cursor, end, length) || length > static_cast<uint64_t>(end - cursor)) return false;
+        methodNames.emplace_back(reinterpret_cast<const char*>(cursor), length);
+        cursor += length;
+    }
+    for (const auto& node : nodeList) {
+        if (node.method >= methodNames.size()) return false;
+    }
+    truncated = 0;
+    if (cursor < end && !Varint::read(cursor, end, truncated)) return false;
+    return true;
+}
+
+uint32_t StackProfile::addNode(uint32_t parent, uint32_t method, int64_t location, int64_t line) {
+    nodeList.push_back({parent, method, location, line});
+    counts.resize(nodeList.size() * metrics, 0);
+    return static_cast<uint32_t>(nodeList.size());
+}
+
+void StackProfile::merge(const StackProfile& other) {
+    if (nodeList.empty() && methodNames.empty()) metrics = other.metrics;
+    truncated += other.truncated;
+
+    std::unordered_map<std::string, uint32_t> methodIds;
+    for (size_t i = 0; i < methodNames.size(); i++) methodIds.emplace(methodNames[i], static_cast<uint32_t>(i));
+    std::vector<uint32_t> methodMap(other.methodNames.size());
+    for (size_t i = 0; i < other.methodNames.size(); i++) {
+        auto [it, inserted] = methodIds.emplace(other.methodNames[i], static_cast<uint32_t>(methodNames.size()));
+        if (inserted) methodNames.push_back(other.methodNames[i]);
+        methodMap[i] = it->second;
+    }
+
+    std::unordered_map<NodeKey, uint32_t, NodeKeyHash> nodeIds;
+    for (size_t i = 0; i < nodeList.size(); i++) {
+        nodeIds.emplace(NodeKey{nodeList[i].parent, nodeList[i].method, nodeList[i].location}, static_cast<uint32_t>(i + 1));
+    }
+
+    // Parents come first in both profiles, so a node's parent is always mapped before the node.
+    std::vector<uint32_t> nodeMap(other.nodeList.size() + 1, 0);
+    for (size_t i = 0; i < other.nodeList.size(); i++) {
+        const Node& node = other.nodeList[i];
+        NodeKey key{nodeMap[node.parent], methodMap[node.method], node.location};
+        auto it = nodeIds.find(key);
+        uint32_t id = it != nodeIds.end() ? it->second : addNode(key.parent, key.method, key.location, node.line);
+        if (it == nodeIds.end()) nodeIds.emplace(key, id);
+        nodeMap[i + 1] = id;
+        for (size_t m = 0; m < metrics && m < other.metrics; m++) counts[(id - 1) * metrics + m] += other.count(i, m);
+    }
+}
+
+std::vector<uint8_t> StackProfile::serialize() const {
+    std::vector<uint8_t> out = {'R', 'S', 'T', 'K'};
+    Varint::write(out, 2);
+    Varint::write(out, metrics);
+    Varint::write(out, nodeList.size());
+    for (size_t i = 0; i < nodeList.size(); i++) {
+        const Node& node = nodeList[i];
+        Varint::write(out, node.parent);
+        Varint::write(out, node.method);
+        Varint::writeSigned(out, node.location);
+        Varint::writeSigned(out, node.line);
+        for (size_t m = 0; m < metrics; m++) Varint::write(out, counts[i * metrics + m]);
+    }
+    Varint::write(out, methodNames.size());
+    for (const auto& name : methodNames) Varint::writeString(out, name);
+    Varint::write(out, truncated);
+    return out;
+}
@@ -0,0 +1,41 @@
+#ifndef STACK_PROFILE_H
+#define STACK_PROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Offline form of a serialized StackTrie ("RSTK" v2), with no JVM dependency: parse, merge profiles
+// by method name and location, and serialize again in the same format.
+class StackProfile {
+public:
+    struct Node {
+        uint32_t parent; // 0 for outermost frames, otherwise a 1-based index into nodes()
+        uint32_t method;
+        int64_t location;
+        int64_t line;
+    };
+
+    bool parse(const uint8_t* data, size_t size);
+    void merge(const StackProfile& other);
+    std::vector<uint8_t> serialize() const;
+
+    const std::vector<Node>& nodes() const { return nodeList; }
+    const std::vector<std::string>& methods() const { return methodNames; }
+    uint64_t count(size_t node, size_t metric) const { return metric < metrics ? counts[node * metrics + metric] : 0; }
+    size_t metricCount() const { return metrics; }
+    // Stacks the agent had to cut short (its StackTrie was full); absent in older files.
+    uint64_t truncatedStacks() const { return truncated; }
+
+private:
+    uint32_t addNode(uint32_t parent, uint32_t method, int64_t location, int64_t line);
+
+    size_t metrics = 0;
+    std::vector<Node> nodeList;
+    std::vector<uint64_t> counts;
+    std::vector<std::string> methodNames;
+    uint64_t truncated = 0;
+};
+
+#endif //STACK_PROFILE_H
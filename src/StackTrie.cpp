@@ -0,0 +1,213 @@
+#include "StackTrie.h"
+#include "Options.h"
+#include "SymbolCache.h"
+#include "Varint.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace {
+    enum SlotState : uint32_t { Empty, Busy, Ready };
+
+    struct Slot {
+        std::atomic<uint32_t> state = Empty;
+        StackTrie::NodeId parent = StackTrie::Root;
+        jmethodID method = nullptr;
+        jlocation location = 0;
+        std::atomic<uint64_t> counts[StackTrie::MetricCount] = {};
+    };
+
+    size_t slotCount = 1 << 18;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> usedSlots = 0;
+    std::atomic<uint64_t> truncatedStacks = 0;
+
+    uint64_t hashNode(StackTrie::NodeId parent, jmethodID method, jlocation location) {
+        uint64_t value = reinterpret_cast<uintptr_t>(method) * 0x9e3779b97f4a7c15ull;
+        value ^= (static_cast<uint64_t>(parent) << 32) ^ static_cast<uint64_t>(location);
+        value ^= value >> 31;
+        value *= 0xbf58476d1ce4e5b9ull;
+        value ^= value >> 29;
+        return value;
+    }
+
+    StackTrie::NodeId insertNode(StackTrie::NodeId parent, jmethodID method, jlocation location) {
+        size_t index = hashNode(parent, method, location) & (slotCount - 1);
+        for (size_t probe = 0; probe < slotCount; probe++) {
+            size_t position = (index + probe) & (slotCount - 1);
+            Slot& slot = slots[position];
+            uint32_t state = slot.state.load(std::memory_order_acquire);
+
+            if (state == Empty) {
+                // Leave headroom so probe chains stay short once the table is nearly full.
+                if (usedSlots.load(std::memory_order_relaxed) * 8 >= slotCount * 7) return StackTrie::Root;
+                if (slot.state.compare_exchange_strong(state, Busy, std::memory_order_acquire)) {
+                    slot.parent = parent;
+                    slot.method = method;
+                    slot.location = location;
+                    slot.state.store(Ready, std::memory_order_release);
+                    usedSlots.fetch_add(1, std::memory_order_relaxed);
+                    return static_cast<StackTrie::NodeId>(position + 1);
+                }
+            }
+            // Another thread is filling the slot; its key is only readable once it is Ready.
+            while (state == Busy) state = slot.state.load(std::memory_order_acquire);
+
+            if (slot.parent == parent && slot.method == method && slot.location == location) {
+                return static_cast<StackTrie::NodeId>(position + 1);
+            }
+        }
+        return StackTrie::Root;
+    }
+
+    Slot* slotOf(StackTrie::NodeId id) {
+        if (!slots || id == StackTrie::Root || id > slotCount) return nullptr;
+        Slot& slot = slots[id - 1];
+        return slot.state.load(std::memory_order_acquire) == Ready ? &slot : nullptr;
+    }
+}
+
+void StackTrie::configure() {
+    if (slots) return;
+    size_t requested = static_cast<size_t>(std::max(1024L, Options::getLong("stack-nodes", static_cast<long>(slotCount))));
+    slotCount = 1;
+    while (slotCount < requested) slotCount <<= 1;
+    slots.reset(new Slot[slotCount]);
+}
+
+StackTrie::NodeId StackTrie::insert(const jvmtiFrameInfo* frames, jint count) {
+    if (!slots) return Root;
+    NodeId node = Root;
+    for (jint i = count; i-- > 0;) {
+        NodeId child = insertNode(node, frames[i].method, frames[i].location);
+        if (child == Root) {
+            truncatedStacks.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        node = child;
+    }
+    return node;
+}
+
+void StackTrie::record(NodeId leaf, Metric metric, uint64_t amount) {
+    if (Slot* slot = slotOf(leaf)) slot->counts[metric].fetch_add(amount, std::memory_order_relaxed);
+}
+
+bool StackTrie::node(NodeId id, Node& out) {
+    Slot* slot = slotOf(id);
+    if (!slot) return false;
+    out = {slot->parent, slot->method, slot->location};
+    return true;
+}
+
+uint64_t StackTrie::count(NodeId id, Metric metric) {
+    Slot* slot = slotOf(id);
+    return slot ? slot->counts[metric].load(std::memory_order_relaxed) : 0;
+}
+
+size_t StackTrie::size() {
+    return usedSlots.load(std::memory_order_relaxed);
+}
+
+size_t StackTrie::capacity() {
+    return slotCount;
+}
+
+uint64_t StackTrie::truncated() {
+    return truncatedStacks.load(std::memory_order_relaxed);
+}
+
+void StackTrie::forEachSampled(const std::function<void(NodeId, const Node&)>& visitor) {
+    if (!slots) return;
+    for (size_t i = 0; i < slotCount; i++) {
+        Slot& slot = slots[i];
+        if (slot.state.load(std::memory_order_acquire) != Ready) continue;
+        bool sampled = false;
+        for (const auto& counter : slot.counts) sampled |= counter.load(std::memory_order_relaxed) != 0;
+        if (sampled) visitor(static_cast<NodeId>(i + 1), {slot.parent, slot.method, slot.location});
+    }
+}
+
+std::vector<uint8_t> StackTrie::serialize(CountSnapshot* previous) {
+    std::vector<uint8_t> out = {'R', 'S', 'T', 'K'};
+    Varint::write(out, 2);
+    Varint::write(out, MetricCount);
+    if (!slots) {
+        Varint::write(out, 0);
+        Varint::write(out, 0);
+        Varint::write(out, 0);
+        return out;
+    }
+    uint64_t truncatedCount = truncatedStacks.load(std::memory_order_relaxed);
+    if (previous) {
+        uint64_t& before = (*previous)[Root][0];
+        uint64_t now = truncatedCount;
+        truncatedCount -= std::min(before, truncatedCount);
+        before = now;
+    }
+
+    // Counts to write per node: totals, or growth since the previous snapshot. Nodes are read once so
+    // concurrent sampling cannot make the written delta disagree with the stored snapshot.
+    std::unordered_map<NodeId, std::array<uint64_t, MetricCount>> written;
+    for (size_t i = 0; i < slotCount; i++) {
+        if (slots[i].state.load(std::memory_order_acquire) != Ready) continue;
+        NodeId id = static_cast<NodeId>(i + 1);
+        std::array<uint64_t, MetricCount> counts{};
+        bool any = false;
+        for (size_t m = 0; m < MetricCount; m++) {
+            counts[m] = slots[i].counts[m].load(std::memory_order_relaxed);
+            if (previous) {
+                auto it = previous->find(id);
+                uint64_t before = it == previous->end() ? 0 : it->second[m];
+                if (counts[m] != before) (*previous)[id][m] = counts[m];
+                counts[m] -= before;
+            }
+            any |= counts[m] != 0;
+        }
+        if (any || !previous) written.emplace(id, counts);
+    }
+
+    // Renumber parents before children so a reader can rebuild the tree in one pass.
+    std::vector<NodeId> order;
+    std::unordered_map<NodeId, uint32_t> newIds;
+    std::vector<NodeId> pending;
+    for (size_t i = 0; i < slotCount; i++) {
+        if (!written.count(static_cast<NodeId>(i + 1))) continue;
+        for (NodeId id = static_cast<NodeId>(i + 1); id != Root && !newIds.count(id); id = slots[id - 1].parent) pending.push_back(id);
+        while (!pending.empty()) {
+            newIds.emplace(pending.back(), static_cast<uint32_t>(order.size() + 1));
+            order.push_back(pending.back());
+            pending.pop_back();
+        }
+    }
+
+    std::vector<jmethodID> methods;
+    std::unordered_map<jmethodID, uint32_t> methodIds;
+    Varint::write(out, order.size());
+    for (NodeId id : order) {
+        const Slot& slot = slots[id - 1];
+        auto [it, inserted] = methodIds.emplace(slot.method, static_cast<uint32_t>(methods.size()));
+        if (inserted) methods.push_back(slot.method);
+
+        const SymbolCache::Symbol* symbol = SymbolCache::find(slot.method);
+        jint line = symbol ? symbol->lineAt(slot.location) : -1;
+        Varint::write(out, slot.parent == Root ? 0 : newIds[slot.parent]);
+        Varint::write(out, it->second);
+        Varint::writeSigned(out, slot.location);
+        Varint::writeSigned(out, line);
+        auto counts = written.find(id);
+        for (size_t m = 0; m < MetricCount; m++) Varint::write(out, counts == written.end() ? 0 : counts->second[m]);
+    }
+
+    Varint::write(out, methods.size());
+    for (jmethodID method : methods) {
+        const SymbolCache::Symbol* symbol = SymbolCache::find(method);
+        std::string name = symbol ? std::string(symbol->className) + "." + symbol->name + symbol->signature : "<unknown>";
+        Varint::writeString(out, name);
+    }
+    Varint::write(out, truncatedCount);
+    return out;
+}
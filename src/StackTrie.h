@@ -0,0 +1,53 @@
+#ifndef STACK_TRIE_H
+#define STACK_TRIE_H
+
+#include <jvmti.h>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Hash-consed call tree: a node is (parent, method, location), so every distinct stack prefix is
+// stored once and a whole stack is identified by its leaf node id. Nodes live in a fixed
+// open-addressing table ("stack-nodes", 256K by default) and are inserted lock-free; each node keeps
+// self counts per metric for the samples whose stack ends there.
+namespace StackTrie {
+    using NodeId = uint32_t;
+    // Parent of outermost frames; also returned when the table is full.
+    inline constexpr NodeId Root = 0;
+
+    // AllocBytes holds the estimated bytes behind each allocation sample, not the sampled object size.
+    enum Metric : uint32_t { CpuSamples, WallSamples, AllocSamples, AllocBytes, MetricCount };
+
+    struct Node {
+        NodeId parent;
+        jmethodID method;
+        jlocation location;
+    };
+
+    void configure();
+
+    // Frames as returned by GetStackTrace, innermost first. Returns the leaf node id.
+    NodeId insert(const jvmtiFrameInfo* frames, jint count);
+    void record(NodeId leaf, Metric metric, uint64_t amount = 1);
+
+    bool node(NodeId id, Node& out);
+    uint64_t count(NodeId id, Metric metric);
+    size_t size();
+    size_t capacity();
+    // Stacks cut short since the start because the table was full; their samples land on the deepest stored prefix.
+    uint64_t truncated();
+    // Visits every node with a non-zero count in some metric.
+    void forEachSampled(const std::function<void(NodeId, const Node&)>& visitor);
+
+    // Compact form (v2): metric count, then parents before children with varint fields, then method
+    // names resolved from SymbolCache. With "previous", only counts added since the last call with
+    // the same snapshot are written (nodes without any are left out unless they are ancestors), and
+    // the snapshot is advanced. A trailing varint holds the truncated stacks, since the last call
+    // with "previous" (kept in the snapshot under Root).
+    using CountSnapshot = std::unordered_map<NodeId, std::array<uint64_t, MetricCount>>;
+    std::vector<uint8_t> serialize(CountSnapshot* previous = nullptr);
+}
+
+#endif //STACK_TRIE_H
@@ -0,0 +1,198 @@
+#include "SymbolCache.h"
+#include "Agent.h"
+#include "Mappings.h"
+#include "Options.h"
+#include "Platform.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    constexpr size_t ArenaChunk = 64 * 1024;
+    constexpr uint64_t SweepIntervalNanos = 5000000000ull;
+
+    struct Slot {
+        std::atomic<jmethodID> method = nullptr;
+        std::atomic<const SymbolCache::Symbol*> symbol = nullptr;
+    };
+
+    // Bump allocator; symbols live until the agent unloads so readers never see freed memory.
+    class Arena {
+    public:
+        void* allocate(size_t size, size_t align) {
+            size_t offset = (used + align - 1) & ~(align - 1);
+            if (chunks.empty() || offset + size > capacity) {
+                capacity = std::max(ArenaChunk, size);
+                chunks.emplace_back(new char[capacity]);
+                offset = 0;
+            }
+            used = offset + size;
+            return chunks.back().get() + offset;
+        }
+
+        const char* copy(std::string_view text) {
+            char* out = static_cast<char*>(allocate(text.size() + 1, 1));
+            std::memcpy(out, text.data(), text.size());
+            out[text.size()] = '\0';
+            return out;
+        }
+
+    private:
+        std::vector<std::unique_ptr<char[]>> chunks;
+        size_t used = 0;
+        size_t capacity = 0;
+    };
+
+    size_t slotCount = 1 << 17;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> usedSlots = 0;
+
+    std::mutex writeLock;
+    Arena arena;
+    std::unordered_set<std::string_view> interned;
+
+    std::atomic_bool sweepPending = false;
+    std::atomic<uint64_t> lastSweep = 0;
+
+    size_t slotIndex(jmethodID method) {
+        uint64_t value = reinterpret_cast<uintptr_t>(method);
+        value ^= value >> 29;
+        value *= 0xbf58476d1ce4e5b9ull;
+        value ^= value >> 32;
+        return value & (slotCount - 1);
+    }
+
+    const char* intern(std::string_view text) {
+        auto it = interned.find(text);
+        if (it != interned.end()) return it->data();
+        const char* copy = arena.copy(text);
+        interned.emplace(copy, text.size());
+        return copy;
+    }
+
+    std::string takeString(jvmtiEnv* jvmti, char* text) {
+        if (!text) return {};
+        std::string result(text);
+        jvmti->Deallocate(reinterpret_cast<unsigned char*>(text));
+        return result;
+    }
+}
+
+jint SymbolCache::Symbol::lineAt(jlocation location) const {
+    const LineEntry* end = lines + lineCount;
+    const LineEntry* it = std::upper_bound(lines, end, location, [](jlocation value, const LineEntry& entry) { return value < entry.start; });
+    return it == lines ? -1 : (it - 1)->line;
+}
+
+void SymbolCache::configure() {
+    size_t requested = static_cast<size_t>(std::max(1024L, Options::getLong("symbol-cache", static_cast<long>(slotCount))));
+    slotCount = 1;
+    while (slotCount < requested) slotCount <<= 1;
+    slots.reset(new Slot[slotCount]);
+}
+
+const SymbolCache::Symbol* SymbolCache::find(jmethodID method) {
+    if (!slots || !method) return nullptr;
+    size_t index = slotIndex(method);
+    for (size_t probe = 0; probe < slotCount; probe++) {
+        Slot& slot = slots[(index + probe) & (slotCount - 1)];
+        jmethodID key = slot.method.load(std::memory_order_acquire);
+        if (key == method) return slot.symbol.load(std::memory_order_acquire);
+        if (!key) return nullptr;
+    }
+    return nullptr;
+}
+
+const SymbolCache::Symbol* SymbolCache::lookup(jvmtiEnv* jvmti, JNIEnv* env, jmethodID method) {
+    if (sweepPending.load(std::memory_order_relaxed)) sweep(env);
+    if (const Symbol* symbol = find(method)) return symbol;
+    if (!slots || !method) return nullptr;
+
+    // Resolve outside the lock; JVMTI calls are the expensive part and may run concurrently.
+    jclass declaringClass = nullptr;
+    if (jvmti->GetMethodDeclaringClass(method, &declaringClass) != JVMTI_ERROR_NONE) return nullptr;
+    std::string className = Agent::className(jvmti, declaringClass);
+    char* rawName = nullptr;
+    char* rawSignature = nullptr;
+    if (jvmti->GetMethodName(method, &rawName, &rawSignature, nullptr) != JVMTI_ERROR_NONE) {
+        env->DeleteLocalRef(declaringClass);
+        return nullptr;
+    }
+    std::string name = takeString(jvmti, rawName);
+    std::string signature = takeString(jvmti, rawSignature);
+    Mappings::Method mapped;
+    if (Mappings::enabled() && Mappings::deobfuscateMethod(className, name, signature, mapped)) {
+        className = std::move(mapped.owner);
+        name = std::move(mapped.name);
+        signature = std::move(mapped.descriptor);
+    }
+
+    std::vector<LineEntry> lines;
+    jint entryCount = 0;
+    jvmtiLineNumberEntry* table = nullptr;
+    if (jvmti->GetLineNumberTable(method, &entryCount, &table) == JVMTI_ERROR_NONE) {
+        lines.reserve(static_cast<size_t>(entryCount));
+        for (jint i = 0; i < entryCount; i++) lines.push_back({table[i].start_location, table[i].line_number});
+        jvmti->Deallocate(reinterpret_cast<unsigned char*>(table));
+        std::sort(lines.begin(), lines.end(), [](const LineEntry& a, const LineEntry& b) { return a.start < b.start; });
+    }
+
+    std::lock_guard guard(writeLock);
+    size_t index = slotIndex(method);
+    for (size_t probe = 0; probe < slotCount; probe++) {
+        Slot& slot = slots[(index + probe) & (slotCount - 1)];
+        jmethodID key = slot.method.load(std::memory_order_acquire);
+        if (key == method) {
+            env->DeleteLocalRef(declaringClass);
+            return slot.symbol.load(std::memory_order_acquire);
+        }
+        if (key) continue;
+        // Keep a quarter of the table free so probe chains stay short; beyond that resolve uncached.
+        if (usedSlots.load(std::memory_order_relaxed) * 4 >= slotCount * 3) break;
+
+        auto* symbol = static_cast<Symbol*>(arena.allocate(sizeof(Symbol), alignof(Symbol)));
+        auto* lineTable = static_cast<LineEntry*>(arena.allocate(sizeof(LineEntry) * std::max<size_t>(lines.size(), 1), alignof(LineEntry)));
+        std::copy(lines.begin(), lines.end(), lineTable);
+        *symbol = {method, intern(className), intern(name), intern(signature), lineTable, static_cast<uint32_t>(lines.size()),
+                   env->NewWeakGlobalRef(declaringClass)};
+        env->DeleteLocalRef(declaringClass);
+
+        slot.symbol.store(symbol, std::memory_order_release);
+        slot.method.store(method, std::memory_order_release);
+        usedSlots.fetch_add(1, std::memory_order_relaxed);
+        return symbol;
+    }
+    env->DeleteLocalRef(declaringClass);
+    return nullptr;
+}
+
+std::string SymbolCache::describe(const Symbol* symbol, jlocation location) {
+    if (!symbol) return "<unknown>";
+    std::string result = std::string(symbol->className) + "." + symbol->name + symbol->signature;
+    jint line = location >= 0 ? symbol->lineAt(location) : -1;
+    return line >= 0 ? result + ":" + std::to_string(line) : result + "@" + std::to_string(location);
+}
+
+void SymbolCache::onGarbageCollectionFinish() {
+    // No JNI inside GC callbacks; the next lookup with a JNIEnv performs the sweep.
+    if (Platform::nanoTime() - lastSweep.load(std::memory_order_relaxed) >= SweepIntervalNanos) sweepPending = true;
+}
+
+void SymbolCache::sweep(JNIEnv* env) {
+    if (!sweepPending.exchange(false) || !slots) return;
+    lastSweep = Platform::nanoTime();
+
+    std::lock_guard guard(writeLock);
+    for (size_t i = 0; i < slotCount; i++) {
+        const Symbol* symbol = slots[i].symbol.load(std::memory_order_acquire);
+        if (!symbol || !env->IsSameObject(symbol->declaringClass, nullptr)) continue;
+        // The key stays as a tombstone: jmethodIDs of unloaded classes are never handed out again.
+        slots[i].symbol.store(nullptr, std::memory_order_release);
+        env->DeleteWeakGlobalRef(symbol->declaringClass);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef SYMBOL_CACHE_H
+#define SYMBOL_CACHE_H
+
+#include <jvmti.h>
+#include <cstdint>
+#include <string>
+
+// Concurrent jmethodID -> symbol cache. Lookups are a lock-free probe of an open-addressing table;
+// a miss resolves the method with JVMTI once and publishes it under a writer lock. Names are interned
+// into an arena and line tables are stored sorted by bci for binary search. Entries of unloaded
+// classes are invalidated by a sweep that runs after garbage collections, at most every few seconds.
+namespace SymbolCache {
+    struct LineEntry {
+        jlocation start;
+        jint line;
+    };
+
+    struct Symbol {
+        jmethodID method;
+        const char* className;
+        const char* name;
+        const char* signature;
+        const LineEntry* lines;
+        uint32_t lineCount;
+        jweak declaringClass;
+
+        // -1 when the method has no line table or the location precedes it.
+        jint lineAt(jlocation location) const;
+    };
+
+    void configure();
+
+    const Symbol* lookup(jvmtiEnv* jvmti, JNIEnv* env, jmethodID method);
+    // Cached symbol only, never calls into the VM; safe where JVMTI is unavailable.
+    const Symbol* find(jmethodID method);
+
+    // "java/lang/String.valueOf(I)Ljava/lang/String;:123"
+    std::string describe(const Symbol* symbol, jlocation location);
+
+    void onGarbageCollectionFinish();
+    void sweep(JNIEnv* env);
+}
+
+#endif //SYMBOL_CACHE_H
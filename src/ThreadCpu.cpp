@@ -0,0 +1,398 @@
+#include "ThreadCpu.h"
+#include "Agent.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    struct JavaThread {
+        std::string name;
+        jweak thread = nullptr;
+        jint hash = 0;
+    };
+
+    struct TaskCounters {
+        // Only set while the tid is mapped to a Java thread.
+        uint64_t javaCpuNanos = 0;
+        bool hasJavaCpu = false;
+        uint64_t userTicks = 0;
+        uint64_t systemTicks = 0;
+        uint64_t waitNanos = 0;
+        uint64_t voluntarySwitches = 0;
+        uint64_t involuntarySwitches = 0;
+    };
+
+    struct TaskSample {
+        uint64_t tid;
+        std::string name;
+        double cpuPercent;
+        double userPercent;
+        double systemPercent;
+        double runQueueMillis;
+        uint64_t voluntarySwitches;
+        uint64_t involuntarySwitches;
+    };
+
+    std::string reportPath;
+    long intervalMillis = 1000;
+    std::atomic_bool running = false;
+    pthread_t samplerThread;
+
+    // Threads whose CPU time identifies their task only when above this, and within the larger of
+    // CpuMatchTicks and CpuMatchShare of it.
+    constexpr uint64_t CpuMatchMinimumNanos = 100000000;
+    constexpr uint64_t CpuMatchTicks = 2;
+    constexpr double CpuMatchShare = 0.05;
+
+    std::mutex lock;
+    std::unordered_map<uint64_t, JavaThread> javaThreads;
+    // Identity hash of the thread object -> tid, verified with IsSameObject.
+    std::unordered_multimap<jint, uint64_t> tidsByHash;
+
+    std::string threadName(jvmtiEnv* jvmti, JNIEnv* env, jthread thread) {
+        jvmtiThreadInfo info{};
+        std::string name;
+        if (jvmti->GetThreadInfo(thread, &info) != JVMTI_ERROR_NONE) return name;
+        if (info.name) {
+            name = info.name;
+            jvmti->Deallocate(reinterpret_cast<unsigned char*>(info.name));
+        }
+        if (info.thread_group) env->DeleteLocalRef(info.thread_group);
+        if (info.context_class_loader) env->DeleteLocalRef(info.context_class_loader);
+        return name;
+    }
+
+    std::string readFile(const std::string& path) {
+        std::ifstream in(path);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    std::string taskPath(uint64_t tid, const char* file) {
+        return "/proc/self/task/" + std::to_string(tid) + "/" + file;
+    }
+
+    std::vector<uint64_t> listTasks() {
+        std::vector<uint64_t> tids;
+        DIR* dir = opendir("/proc/self/task");
+        if (!dir) return tids;
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] >= '0' && entry->d_name[0] <= '9') tids.push_back(std::strtoull(entry->d_name, nullptr, 10));
+        }
+        closedir(dir);
+        return tids;
+    }
+
+    std::string taskComm(uint64_t tid) {
+        std::string comm = readFile(taskPath(tid, "comm"));
+        while (!comm.empty() && comm.back() == '\n') comm.pop_back();
+        return comm;
+    }
+
+    void readTask(uint64_t tid, TaskCounters& counters) {
+        // Fields after the parenthesised comm, which may itself contain spaces.
+        std::string stat = readFile(taskPath(tid, "stat"));
+        size_t close = stat.rfind(')');
+        if (close != std::string::npos) {
+            unsigned long long user = 0, system = 0;
+            if (std::sscanf(stat.c_str() + close + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &user, &system) == 2) {
+                counters.userTicks = user;
+                counters.systemTicks = system;
+            }
+        }
+
+        unsigned long long run = 0, wait = 0;
+        if (std::sscanf(readFile(taskPath(tid, "schedstat")).c_str(), "%llu %llu", &run, &wait) == 2) counters.waitNanos = wait;
+
+        std::string status = readFile(taskPath(tid, "status"));
+        if (size_t at = status.find("voluntary_ctxt_switches:"); at != std::string::npos) {
+            counters.voluntarySwitches = std::strtoull(status.c_str() + at + 24, nullptr, 10);
+        }
+        if (size_t at = status.find("nonvoluntary_ctxt_switches:"); at != std::string::npos) {
+            counters.involuntarySwitches = std::strtoull(status.c_str() + at + 27, nullptr, 10);
+        }
+    }
+
+    // Under the lock.
+    uint64_t mappedTid(JNIEnv* env, jint hash, jthread thread) {
+        auto [first, last] = tidsByHash.equal_range(hash);
+        for (auto it = first; it != last; ++it) {
+            if (env->IsSameObject(javaThreads[it->second].thread, thread)) return it->second;
+        }
+        return 0;
+    }
+
+    // Under the lock.
+    void unmap(JNIEnv* env, uint64_t tid) {
+        auto it = javaThreads.find(tid);
+        if (it == javaThreads.end()) return;
+        auto [first, last] = tidsByHash.equal_range(it->second.hash);
+        for (auto link = first; link != last; ++link) {
+            if (link->second == tid) {
+                tidsByHash.erase(link);
+                break;
+            }
+        }
+        env->DeleteWeakGlobalRef(it->second.thread);
+        javaThreads.erase(it);
+    }
+
+    // Under the lock.
+    void map(JNIEnv* env, uint64_t tid, std::string name, jint hash, jthread thread) {
+        unmap(env, tid);
+        javaThreads[tid] = {std::move(name), env->NewWeakGlobalRef(thread), hash};
+        tidsByHash.emplace(hash, tid);
+    }
+
+    uint64_t taskCpuNanos(uint64_t tid, double ticksPerSecond) {
+        TaskCounters counters;
+        readTask(tid, counters);
+        return static_cast<uint64_t>(static_cast<double>(counters.userTicks + counters.systemTicks) / ticksPerSecond * 1e9);
+    }
+
+    // Refreshes the names of mapped threads, which Thread.setName changes after the start, and maps
+    // the threads started before the agent saw ThreadStart (attach, pre-VMInit). Those are matched
+    // first by their native name, which the JVM sets to the first 15 characters of the Java name
+    // when it starts the thread, where that prefix is unique, and otherwise by their CPU time against
+    // the task's: the launcher's main thread keeps "java" as its native name whatever it is renamed
+    // to, but it is also the busiest thread of a client.
+    void refreshThreads(jvmtiEnv* jvmti, JNIEnv* env) {
+        jint count = 0;
+        jthread* threads = nullptr;
+        if (jvmti->GetAllThreads(&count, &threads) != JVMTI_ERROR_NONE) return;
+
+        struct Unmapped {
+            jthread thread;
+            std::string name;
+            jint hash;
+        };
+        std::vector<Unmapped> all;
+        for (jint i = 0; i < count; i++) {
+            jint hash = 0;
+            jvmti->GetObjectHashCode(threads[i], &hash);
+            all.push_back({threads[i], threadName(jvmti, env, threads[i]), hash});
+        }
+        jvmti->Deallocate(reinterpret_cast<unsigned char*>(threads));
+
+        std::vector<Unmapped> unmapped;
+        {
+            std::lock_guard guard(lock);
+            for (auto& thread : all) {
+                if (uint64_t tid = mappedTid(env, thread.hash, thread.thread)) {
+                    javaThreads[tid].name = std::move(thread.name);
+                    env->DeleteLocalRef(thread.thread);
+                } else {
+                    unmapped.push_back(std::move(thread));
+                }
+            }
+        }
+        if (unmapped.empty()) return;
+
+        std::vector<uint64_t> tasks;
+        {
+            std::lock_guard guard(lock);
+            for (uint64_t tid : listTasks()) {
+                if (!javaThreads.count(tid)) tasks.push_back(tid);
+            }
+        }
+        std::unordered_map<std::string, size_t> commCounts;
+        std::unordered_map<std::string, uint64_t> tidsByComm;
+        for (uint64_t tid : tasks) {
+            std::string comm = taskComm(tid);
+            commCounts[comm]++;
+            tidsByComm[comm] = tid;
+        }
+        std::unordered_map<std::string, size_t> prefixCounts;
+        for (const auto& thread : unmapped) prefixCounts[thread.name.substr(0, 15)]++;
+
+        std::vector<uint64_t> matched;
+        std::vector<Unmapped*> remaining;
+        {
+            std::lock_guard guard(lock);
+            for (auto& thread : unmapped) {
+                std::string prefix = thread.name.substr(0, 15);
+                auto it = tidsByComm.find(prefix);
+                if (it != tidsByComm.end() && commCounts[prefix] == 1 && prefixCounts[prefix] == 1) {
+                    map(env, it->second, thread.name, thread.hash, thread.thread);
+                    matched.push_back(it->second);
+                } else {
+                    remaining.push_back(&thread);
+                }
+            }
+        }
+
+        if (!remaining.empty()) {
+            const double ticksPerSecond = static_cast<double>(sysconf(_SC_CLK_TCK));
+            const uint64_t tickNanos = static_cast<uint64_t>(1e9 / ticksPerSecond);
+            std::vector<std::pair<uint64_t, uint64_t>> taskCpu;
+            for (uint64_t tid : tasks) {
+                if (std::find(matched.begin(), matched.end(), tid) == matched.end()) taskCpu.emplace_back(tid, taskCpuNanos(tid, ticksPerSecond));
+            }
+            for (Unmapped* thread : remaining) {
+                jlong cpu = 0;
+                if (jvmti->GetThreadCpuTime(thread->thread, &cpu) != JVMTI_ERROR_NONE || static_cast<uint64_t>(cpu) < CpuMatchMinimumNanos) continue;
+                uint64_t tolerance = std::max(CpuMatchTicks * tickNanos, static_cast<uint64_t>(static_cast<double>(cpu) * CpuMatchShare));
+                size_t best = taskCpu.size();
+                size_t candidates = 0;
+                for (size_t i = 0; i < taskCpu.size(); i++) {
+                    uint64_t task = taskCpu[i].second;
+                    uint64_t difference = task > static_cast<uint64_t>(cpu) ? task - cpu : cpu - task;
+                    if (difference > tolerance) continue;
+                    candidates++;
+                    best = i;
+                }
+                // An ambiguous match is left for a later pass, when the CPU times have drifted apart.
+                if (candidates != 1) continue;
+                std::lock_guard guard(lock);
+                map(env, taskCpu[best].first, thread->name, thread->hash, thread->thread);
+                taskCpu.erase(taskCpu.begin() + static_cast<std::ptrdiff_t>(best));
+            }
+        }
+        for (auto& thread : unmapped) env->DeleteLocalRef(thread.thread);
+    }
+
+    void* runSampler(void*) {
+        Agent::awaitLive();
+        JNIEnv* env = nullptr;
+        JavaVMAttachArgs args{JNI_VERSION_1_8, const_cast<char*>("Rynox ThreadCpu"), nullptr};
+        if (Agent::jvm->AttachCurrentThreadAsDaemon(reinterpret_cast<void**>(&env), &args) != JNI_OK || !env) {
+            std::cerr << "[Rynox] Failed to attach thread CPU sampler to JVM." << std::endl;
+            return nullptr;
+        }
+        jvmtiEnv* jvmti = Agent::jvmti;
+        refreshThreads(jvmti, env);
+
+        std::ofstream out(reportPath, std::ios::trunc);
+        out << "# offset_ms tid cpu% user% sys% runq_ms vcsw ivcsw name\n";
+        const double ticksPerSecond = static_cast<double>(sysconf(_SC_CLK_TCK));
+        std::unordered_map<uint64_t, TaskCounters> previous;
+        uint64_t previousNanos = Platform::nanoTime();
+
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMillis));
+            uint64_t now = Platform::nanoTime();
+            double wallSeconds = static_cast<double>(now - previousNanos) / 1e9;
+            previousNanos = now;
+            refreshThreads(jvmti, env);
+
+            std::vector<TaskSample> samples;
+            std::unordered_map<uint64_t, TaskCounters> current;
+            for (uint64_t tid : listTasks()) {
+                TaskCounters counters;
+                readTask(tid, counters);
+
+                std::string name;
+                {
+                    std::lock_guard guard(lock);
+                    auto it = javaThreads.find(tid);
+                    if (it != javaThreads.end()) {
+                        name = it->second.name;
+                        jthread thread = env->NewLocalRef(it->second.thread);
+                        jlong cpuNanos = 0;
+                        if (thread && jvmti->GetThreadCpuTime(thread, &cpuNanos) == JVMTI_ERROR_NONE) {
+                            counters.javaCpuNanos = static_cast<uint64_t>(cpuNanos);
+                            counters.hasJavaCpu = true;
+                        }
+                        if (thread) env->DeleteLocalRef(thread);
+                    }
+                }
+                if (name.empty()) name = taskComm(tid);
+                current[tid] = counters;
+
+                auto before = previous.find(tid);
+                if (before == previous.end()) continue;
+                const TaskCounters& last = before->second;
+                double user = static_cast<double>(counters.userTicks - last.userTicks) / ticksPerSecond;
+                double system = static_cast<double>(counters.systemTicks - last.systemTicks) / ticksPerSecond;
+                // The Java clock only differences against itself: a thread mapped since the last pass, or
+                // a tid reused by a new thread, falls back to the task's ticks for this pass.
+                bool javaDelta = counters.hasJavaCpu && last.hasJavaCpu && counters.javaCpuNanos >= last.javaCpuNanos;
+                double cpu = javaDelta ? static_cast<double>(counters.javaCpuNanos - last.javaCpuNanos) / 1e9 : user + system;
+                double runQueue = static_cast<double>(counters.waitNanos - last.waitNanos) / 1e6;
+                uint64_t voluntary = counters.voluntarySwitches - last.voluntarySwitches;
+                uint64_t involuntary = counters.involuntarySwitches - last.involuntarySwitches;
+                if (cpu <= 0 && runQueue <= 0 && voluntary == 0 && involuntary == 0) continue;
+
+                samples.push_back({tid, name, cpu / wallSeconds * 100, user / wallSeconds * 100, system / wallSeconds * 100,
+                                   runQueue, voluntary, involuntary});
+                Trace::threadCpu(now, tid, name, static_cast<uint64_t>(cpu * 1e9), counters.waitNanos - last.waitNanos, voluntary, involuntary);
+            }
+            previous = std::move(current);
+
+            std::sort(samples.begin(), samples.end(), [](const TaskSample& a, const TaskSample& b) { return a.cpuPercent > b.cpuPercent; });
+            double offset = static_cast<double>(now - Agent::startNanos) / 1e6;
+            for (const auto& sample : samples) {
+                char line[160];
+                std::snprintf(line, sizeof(line), "%.0f %llu %.1f %.1f %.1f %.2f %llu %llu ", offset, static_cast<unsigned long long>(sample.tid),
+                              sample.cpuPercent, sample.userPercent, sample.systemPercent, sample.runQueueMillis,
+                              static_cast<unsigned long long>(sample.voluntarySwitches), static_cast<unsigned long long>(sample.involuntarySwitches));
+                out << line << sample.name << "\n";
+            }
+            out.flush();
+        }
+
+        std::lock_guard guard(lock);
+        for (auto& [tid, thread] : javaThreads) env->DeleteWeakGlobalRef(thread.thread);
+        javaThreads.clear();
+        tidsByHash.clear();
+        Agent::jvm->DetachCurrentThread();
+        return nullptr;
+    }
+}
+
+bool ThreadCpu::enabled() {
+    return !reportPath.empty();
+}
+
+void ThreadCpu::configure() {
+    reportPath = Options::get("threadcpu");
+    intervalMillis = std::max(10L, Options::getLong("threadcpu-interval", intervalMillis));
+}
+
+void ThreadCpu::onThreadStart(jvmtiEnv* jvmti, JNIEnv* env, jthread thread) {
+    // ThreadStart (and VMInit, for the main thread) runs on the thread itself, so the current native tid is its own.
+    std::string name = threadName(jvmti, env, thread);
+    jint hash = 0;
+    jvmti->GetObjectHashCode(thread, &hash);
+    std::lock_guard guard(lock);
+    map(env, Platform::currentThreadId(), std::move(name), hash, thread);
+}
+
+void ThreadCpu::onThreadEnd(jvmtiEnv* jvmti, JNIEnv* env, jthread thread) {
+    std::lock_guard guard(lock);
+    unmap(env, Platform::currentThreadId());
+}
+
+uint64_t ThreadCpu::nativeId(jvmtiEnv* jvmti, JNIEnv* env, jthread thread) {
+    if (!enabled() || !env) return 0;
+    jint hash = 0;
+    if (jvmti->GetObjectHashCode(thread, &hash) != JVMTI_ERROR_NONE) return 0;
+    std::lock_guard guard(lock);
+    return mappedTid(env, hash, thread);
+}
+
+void ThreadCpu::start() {
+    if (!enabled() || running.exchange(true)) return;
+    if (pthread_create(&samplerThread, nullptr, &runSampler, nullptr) != 0) {
+        std::cerr << "[Rynox] Failed to create thread CPU sampler." << std::endl;
+        running = false;
+        return;
+    }
+    pthread_detach(samplerThread);
+}
+
+void ThreadCpu::stop() {
+    running = false;
+}
@@ -0,0 +1,27 @@
+#ifndef THREAD_CPU_H
+#define THREAD_CPU_H
+
+#include <jvmti.h>
+#include <cstdint>
+
+// Per-thread CPU accounting, enabled with "threadcpu=<report path>". ThreadStart records the native
+// tid of every Java thread, and VMInit that of the main thread (the client's render thread). Every
+// "threadcpu-interval" ms (1000 by default) a daemon thread refreshes the Java names, maps threads
+// that were already running, joins GetThreadCpuTime with /proc/self/task/<tid>/{stat,schedstat,status}
+// and appends CPU %, run-queue delay and context switches for each task, Java or JVM-internal.
+namespace ThreadCpu {
+    bool enabled();
+    void configure();
+
+    // Also called from VMInit for the main thread, which has no ThreadStart.
+    void onThreadStart(jvmtiEnv* jvmti, JNIEnv* env, jthread thread);
+    void onThreadEnd(jvmtiEnv* jvmti, JNIEnv* env, jthread thread);
+
+    // Native tid of a mapped thread, or 0.
+    uint64_t nativeId(jvmtiEnv* jvmti, JNIEnv* env, jthread thread);
+
+    void start();
+    void stop();
+}
+
+#endif //THREAD_CPU_H
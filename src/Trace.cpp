@@ -0,0 +1,454 @@
+#include "Trace.h"
+#include "Agent.h"
+#include "FlightRecorder.h"
+#include "Options.h"
+#include "Platform.h"
+#include "StackTrie.h"
+#include "SymbolCache.h"
+#include "ThreadCpu.h"
+#include "TraceWriter.h"
+#include "Varint.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    // Event payloads are a handful of varints; they are encoded on the stack.
+    class Fields {
+    public:
+        Fields& add(uint64_t value) {
+            if (size + Varint::MaxBytes <= sizeof(data)) size += Varint::encode(data + size, value);
+            return *this;
+        }
+
+        Fields& addSigned(int64_t value) {
+            return add(Varint::zigzag(value));
+        }
+
+        uint8_t data[128];
+        size_t size = 0;
+    };
+
+    // The trace file gets dictionary records as they are defined; the recorder ring only gets events
+    // and its dumps rebuild the dictionary from the maps below. The ring's file-backed twin for crash
+    // recovery keeps its dictionary in "ringDictionary".
+    TraceWriter writer;
+    TraceWriter ring;
+    TraceWriter ringDictionary;
+    // Read by every emitting thread while close() runs at VMDeath.
+    std::atomic_bool tracing = false;
+
+    std::mutex stringLock;
+    std::unordered_map<std::string, uint64_t> strings;
+    std::unordered_map<jmethodID, uint64_t> methods;
+    std::unordered_map<uint64_t, uint64_t> threadNames;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> emittedNodes;
+
+    void emit(uint8_t type, uint64_t nanos, const Fields& fields) {
+        if (writer.isOpen()) writer.appendEvent(type, nanos, fields.data, fields.size);
+        if (ring.isOpen()) ring.appendEvent(type, nanos, fields.data, fields.size);
+    }
+
+    void define(uint8_t type, const uint8_t* payload, size_t size) {
+        if (writer.isOpen()) writer.append(type, payload, size);
+        if (ringDictionary.isOpen()) ringDictionary.append(type, payload, size);
+    }
+
+    // Keeps the previous run's ring, so a crash can still be recovered after a restart.
+    void keepPrevious(const std::string& path) {
+        std::rename(path.c_str(), (path + ".prev").c_str());
+    }
+
+    void forEachMetadata(const std::function<void(const std::vector<uint8_t>&)>& fn) {
+        for (const auto& event : TraceFormat::EventTypes) {
+            std::vector<uint8_t> payload;
+            Varint::write(payload, event.type);
+            Varint::writeString(payload, event.name);
+            Varint::write(payload, event.fieldCount);
+            for (size_t i = 0; i < event.fieldCount; i++) {
+                Varint::writeString(payload, event.fields[i].name);
+                payload.push_back(static_cast<uint8_t>(event.fields[i].kind));
+            }
+            fn(payload);
+        }
+    }
+
+    void stackNodeFields(Fields& fields, StackTrie::NodeId id, const StackTrie::Node& node, uint64_t method) {
+        const SymbolCache::Symbol* symbol = SymbolCache::find(node.method);
+        fields.add(id).add(node.parent).add(method);
+        fields.addSigned(symbol ? symbol->lineAt(node.location) : -1).addSigned(node.location);
+    }
+
+    // Segment-structured output for recorder dumps: records are packed into segments of the ring's
+    // size, padded with zeros, so the copied ring segments follow with their own headers.
+    class DumpBuilder {
+    public:
+        explicit DumpBuilder(uint32_t segmentSize) : segmentSize(segmentSize) {}
+
+        void start(uint64_t startNanos) {
+            TraceFormat::FileHeader header{};
+            std::memcpy(header.magic, TraceFormat::FileMagic, sizeof(header.magic));
+            header.version = TraceFormat::Version;
+            header.segmentSize = segmentSize;
+            header.startNanos = startNanos;
+            header.startEpochMillis = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+            header.pid = static_cast<uint32_t>(getpid());
+            raw(&header, sizeof(header));
+            segmentHeader(startNanos);
+        }
+
+        void record(uint8_t type, const uint8_t* payload, size_t size) {
+            size_t span = TraceFormat::recordSpan(size);
+            if (out.size() % segmentSize + span > segmentSize) {
+                pad();
+                segmentHeader(baseNanos);
+            }
+            uint32_t header = TraceFormat::recordHeader(type, static_cast<uint32_t>(size));
+            raw(&header, sizeof(header));
+            raw(payload, size);
+            out.resize(out.size() + span - sizeof(header) - size, 0);
+        }
+
+        void segment(std::vector<uint8_t>& data) {
+            pad();
+            // Renumber the copied header; the base time stays, record times are relative to it.
+            reinterpret_cast<TraceFormat::SegmentHeader*>(data.data())->index = static_cast<uint32_t>(out.size() / segmentSize);
+            out.insert(out.end(), data.begin(), data.end());
+        }
+
+        std::vector<uint8_t> out;
+
+    private:
+        void raw(const void* data, size_t size) {
+            out.insert(out.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+        }
+
+        void pad() {
+            if (out.size() % segmentSize) out.resize((out.size() / segmentSize + 1) * segmentSize, 0);
+        }
+
+        void segmentHeader(uint64_t nanos) {
+            baseNanos = nanos;
+            TraceFormat::SegmentHeader header{};
+            std::memcpy(header.magic, TraceFormat::SegmentMagic, sizeof(header.magic));
+            header.index = static_cast<uint32_t>(out.size() / segmentSize);
+            header.baseNanos = nanos;
+            raw(&header, sizeof(header));
+        }
+
+        uint32_t segmentSize;
+        uint64_t baseNanos = 0;
+    };
+
+    uint64_t methodString(jvmtiEnv* jvmti, JNIEnv* env, jmethodID method) {
+        {
+            std::lock_guard guard(stringLock);
+            auto it = methods.find(method);
+            if (it != methods.end()) return it->second;
+        }
+        const SymbolCache::Symbol* symbol = SymbolCache::lookup(jvmti, env, method);
+        std::string name = symbol ? std::string(symbol->className) + "." + symbol->name + symbol->signature : "<unknown>";
+        uint64_t id = Trace::string(name);
+
+        std::lock_guard guard(stringLock);
+        methods.emplace(method, id);
+        return id;
+    }
+
+    void emitThread(uint64_t nanos, uint64_t threadId, std::string_view name) {
+        Fields fields;
+        uint64_t nameId = Trace::string(name);
+        fields.add(threadId).add(nameId);
+        emit(TraceFormat::ThreadStart, nanos, fields);
+        if (ringDictionary.isOpen()) ringDictionary.appendEvent(TraceFormat::ThreadStart, nanos, fields.data, fields.size);
+
+        std::lock_guard guard(stringLock);
+        threadNames[threadId] = nameId;
+    }
+
+    std::string threadName(jvmtiEnv* jvmti, JNIEnv* env, jthread thread) {
+        jvmtiThreadInfo info{};
+        std::string name;
+        if (jvmti->GetThreadInfo(thread, &info) != JVMTI_ERROR_NONE) return name;
+        if (info.name) {
+            name = info.name;
+            jvmti->Deallocate(reinterpret_cast<unsigned char*>(info.name));
+        }
+        if (info.thread_group) env->DeleteLocalRef(info.thread_group);
+        if (info.context_class_loader) env->DeleteLocalRef(info.context_class_loader);
+        return name;
+    }
+}
+
+bool Trace::enabled() {
+    return tracing;
+}
+
+void Trace::configure() {
+    std::string path = Options::get("trace");
+    if (!path.empty()) {
+        uint32_t segmentSize = static_cast<uint32_t>(std::clamp(Options::getLong("trace-segment", 8), 1L, 1024L)) << 20;
+        writer.open(path, segmentSize, Agent::startNanos);
+    }
+    if (FlightRecorder::enabled()) {
+        // 1 MiB segments bound the granularity of what a dump keeps and what the ring recycles.
+        uint32_t segmentCount = static_cast<uint32_t>(std::clamp(Options::getLong("recorder-size", 32), 2L, 4096L));
+        std::string ringPath = FlightRecorder::directory() + "/ring.data";
+        std::string dictionaryPath = FlightRecorder::directory() + "/ring.dict";
+        keepPrevious(ringPath);
+        keepPrevious(dictionaryPath);
+        if (ring.openRing(1u << 20, segmentCount, Agent::startNanos, ringPath)) ringDictionary.open(dictionaryPath, 1u << 20, Agent::startNanos);
+    }
+    if (!writer.isOpen() && !ring.isOpen()) return;
+
+    StackTrie::configure();
+    emittedNodes.reset(new std::atomic<uint64_t>[StackTrie::capacity() / 64 + 1]());
+    tracing = true;
+    forEachMetadata([](const std::vector<uint8_t>& payload) {
+        define(TraceFormat::Metadata, payload.data(), payload.size());
+    });
+}
+
+void Trace::close() {
+    if (!tracing.exchange(false)) return;
+    writer.close();
+    ring.close();
+    ringDictionary.close();
+}
+
+void Trace::seal(uint64_t threadId, int signal, uint64_t address) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(static_cast<uint64_t>(signal)).add(address);
+    uint64_t now = Platform::nanoTime();
+    for (TraceWriter* target : {&writer, &ring}) {
+        if (!target->isOpen()) continue;
+        target->appendEventNow(TraceFormat::Crash, now, fields.data, fields.size);
+        target->seal(signal);
+    }
+    if (ringDictionary.isOpen()) ringDictionary.seal(signal);
+}
+
+bool Trace::recording() {
+    return ring.isOpen();
+}
+
+bool Trace::dumpRecording(const std::string& path, uint64_t fromNanos) {
+    if (!ring.isOpen()) return false;
+    // Freeze first, so the dictionary below covers every id the copied events reference.
+    std::vector<TraceWriter::SegmentCopy> copies = ring.snapshot(fromNanos);
+    DumpBuilder dump(ring.segmentBytes());
+    dump.start(Agent::startNanos);
+    forEachMetadata([&](const std::vector<uint8_t>& payload) { dump.record(TraceFormat::Metadata, payload.data(), payload.size()); });
+
+    std::vector<std::pair<uint64_t, std::string>> stringList;
+    std::unordered_map<jmethodID, uint64_t> methodIds;
+    std::vector<std::pair<uint64_t, uint64_t>> threadList;
+    {
+        std::lock_guard guard(stringLock);
+        for (const auto& [text, id] : strings) stringList.emplace_back(id, text);
+        methodIds = methods;
+        threadList.assign(threadNames.begin(), threadNames.end());
+    }
+    std::sort(stringList.begin(), stringList.end());
+    for (const auto& [id, text] : stringList) {
+        std::vector<uint8_t> payload;
+        Varint::write(payload, id);
+        payload.insert(payload.end(), text.begin(), text.end());
+        dump.record(TraceFormat::String, payload.data(), payload.size());
+    }
+
+    size_t words = StackTrie::capacity() / 64 + 1;
+    for (size_t word = 0; word < words; word++) {
+        uint64_t bits = emittedNodes[word].load(std::memory_order_relaxed);
+        for (; bits; bits &= bits - 1) {
+            StackTrie::NodeId id = static_cast<StackTrie::NodeId>(word * 64 + static_cast<size_t>(__builtin_ctzll(bits)));
+            StackTrie::Node node{};
+            if (!StackTrie::node(id, node)) continue;
+            auto method = methodIds.find(node.method);
+            Fields fields;
+            stackNodeFields(fields, id, node, method == methodIds.end() ? 0 : method->second);
+            dump.record(TraceFormat::StackNode, fields.data, fields.size);
+        }
+    }
+
+    // Thread names, since their ThreadStart events have usually left the ring long ago.
+    for (const auto& [threadId, name] : threadList) {
+        uint8_t payload[2 * Varint::MaxBytes + 1];
+        size_t size = Varint::encode(payload, Varint::zigzag(0));
+        size += Varint::encode(payload + size, threadId);
+        size += Varint::encode(payload + size, name);
+        dump.record(TraceFormat::ThreadStart, payload, size);
+    }
+    for (auto& copy : copies) dump.segment(copy.data);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(dump.out.data()), static_cast<std::streamsize>(dump.out.size()));
+    if (!out) {
+        std::cerr << "[Rynox] Failed to write recording to " << path << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+uint64_t Trace::string(std::string_view text) {
+    if (!tracing) return 0;
+    std::lock_guard guard(stringLock);
+    auto it = strings.find(std::string(text));
+    if (it != strings.end()) return it->second;
+
+    uint64_t id = strings.size() + 1;
+    strings.emplace(std::string(text), id);
+    // Appended under the lock, so any event using this id is written after the definition.
+    if (writer.isOpen() || ringDictionary.isOpen()) {
+        std::vector<uint8_t> payload;
+        Varint::write(payload, id);
+        payload.insert(payload.end(), text.begin(), text.end());
+        define(TraceFormat::String, payload.data(), payload.size());
+    }
+    return id;
+}
+
+uint64_t Trace::stack(jvmtiEnv* jvmti, JNIEnv* env, const jvmtiFrameInfo* frames, jint count) {
+    if (!tracing || count <= 0) return 0;
+    StackTrie::NodeId leaf = StackTrie::insert(frames, count);
+
+    StackTrie::Node node{};
+    for (StackTrie::NodeId id = leaf; id != StackTrie::Root && StackTrie::node(id, node); id = node.parent) {
+        uint64_t bit = 1ull << (id % 64);
+        if (emittedNodes[id / 64].fetch_or(bit, std::memory_order_relaxed) & bit) break;
+
+        SymbolCache::lookup(jvmti, env, node.method);
+        Fields fields;
+        stackNodeFields(fields, id, node, methodString(jvmti, env, node.method));
+        define(TraceFormat::StackNode, fields.data, fields.size);
+    }
+    return leaf;
+}
+
+uint64_t Trace::threadId(jvmtiEnv* jvmti, JNIEnv* env, jthread thread) {
+    void* stored = nullptr;
+    if (jvmti->GetThreadLocalStorage(thread, &stored) == JVMTI_ERROR_NONE && stored) return reinterpret_cast<uintptr_t>(stored);
+
+    // Thread started before we saw ThreadStart. Its own tid when called on it or known to ThreadCpu,
+    // so its events share a track with its CPU counters; otherwise a stable synthetic id above the tid range.
+    uint64_t id = 0;
+    jthread current = nullptr;
+    if (env && jvmti->GetCurrentThread(&current) == JVMTI_ERROR_NONE && current) {
+        if (env->IsSameObject(current, thread)) id = Platform::currentThreadId();
+        env->DeleteLocalRef(current);
+    }
+    if (!id) id = ThreadCpu::nativeId(jvmti, env, thread);
+    if (!id) {
+        jint hash = 0;
+        jvmti->GetObjectHashCode(thread, &hash);
+        id = (1ull << 32) | static_cast<uint32_t>(hash);
+    }
+    jvmti->SetThreadLocalStorage(thread, reinterpret_cast<void*>(static_cast<uintptr_t>(id)));
+    if (tracing) emitThread(Platform::nanoTime(), id, threadName(jvmti, env, thread));
+    return id;
+}
+
+void Trace::onThreadStart(jvmtiEnv* jvmti, JNIEnv* env, jthread thread) {
+    uint64_t id = Platform::currentThreadId();
+    jvmti->SetThreadLocalStorage(thread, reinterpret_cast<void*>(static_cast<uintptr_t>(id)));
+    if (tracing) emitThread(Platform::nanoTime(), id, threadName(jvmti, env, thread));
+}
+
+void Trace::classLoad(uint64_t nanos, uint64_t threadId, std::string_view className, std::string_view loader, uint64_t duration) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(string(className)).add(string(loader)).add(duration);
+    emit(TraceFormat::ClassLoad, nanos, fields);
+}
+
+void Trace::exception(uint64_t nanos, uint64_t threadId, std::string_view className, std::string_view site, uint64_t stack) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(string(className)).add(string(site)).add(stack);
+    emit(TraceFormat::Exception, nanos, fields);
+}
+
+void Trace::threadCpu(uint64_t nanos, uint64_t threadId, std::string_view name, uint64_t cpuNanos, uint64_t runQueueNanos,
+                      uint64_t voluntarySwitches, uint64_t involuntarySwitches) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(string(name)).add(cpuNanos).add(runQueueNanos).add(voluntarySwitches).add(involuntarySwitches);
+    emit(TraceFormat::ThreadCpu, nanos, fields);
+}
+
+void Trace::sample(uint64_t nanos, uint64_t threadId, uint64_t stack, bool runnable) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(stack).add(runnable ? 1 : 0);
+    emit(TraceFormat::Sample, nanos, fields);
+}
+
+void Trace::milestone(uint64_t nanos, uint64_t threadId, std::string_view name) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(string(name));
+    emit(TraceFormat::Milestone, nanos, fields);
+}
+
+void Trace::garbageCollection(uint64_t nanos, uint64_t threadId, uint64_t duration) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(duration);
+    emit(TraceFormat::GarbageCollection, nanos, fields);
+}
+
+void Trace::compiledMethod(jvmtiEnv* jvmti, JNIEnv* env, uint64_t nanos, uint64_t threadId, jmethodID method, uint64_t codeSize) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(methodString(jvmti, env, method)).add(codeSize);
+    emit(TraceFormat::CompiledMethod, nanos, fields);
+}
+
+void Trace::monitorWait(uint64_t nanos, uint64_t threadId, std::string_view className, uint64_t duration, bool contended) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(string(className)).add(duration).add(contended ? 1 : 0);
+    emit(TraceFormat::MonitorWait, nanos, fields);
+}
+
+void Trace::frame(uint64_t nanos, uint64_t threadId, std::string_view kind, uint64_t duration) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(string(kind)).add(duration);
+    emit(TraceFormat::Frame, nanos, fields);
+}
+
+void Trace::methodCall(uint64_t nanos, uint64_t threadId, uint64_t method, uint64_t duration) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(method).add(duration);
+    emit(TraceFormat::MethodCall, nanos, fields);
+}
+
+void Trace::nativeFrame(uint64_t nanos, uint64_t threadId, uint64_t calls, uint64_t draws, uint64_t stateChanges, uint64_t nativeNanos) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(calls).add(draws).add(stateChanges).add(nativeNanos);
+    emit(TraceFormat::NativeFrame, nanos, fields);
+}
+
+void Trace::breakpointHit(uint64_t nanos, uint64_t threadId, uint64_t name, uint64_t bci) {
+    if (!tracing) return;
+    Fields fields;
+    fields.add(threadId).add(name).add(bci);
+    emit(TraceFormat::BreakpointHit, nanos, fields);
+}
@@ -0,0 +1,52 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <jvmti.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Typed event API over the binary trace, enabled with "trace=<path>" ("trace-segment=<MiB>", 8 by
+// default). Strings, methods and stack nodes are written once as dictionary records and referenced
+// by id; events carry the native thread id, which ThreadStart stores in JVMTI thread-local storage.
+// "recorder" additionally keeps events in a ring of "recorder-size" 1 MiB segments (32 by default) for
+// the FlightRecorder, whose dumps are ordinary trace files. The ring is mapped from ring.data in the
+// recorder directory, with its dictionary in ring.dict, so "rynox-report recover" can rebuild a trace
+// after a crash; the previous run's pair is kept with a .prev suffix.
+namespace Trace {
+    bool enabled();
+    void configure();
+    void close();
+
+    // Async-signal-safe: appends a Crash event without rotating and seals every open writer.
+    void seal(uint64_t threadId, int signal, uint64_t address);
+
+    bool recording();
+    // Writes the ring's events from "fromNanos" on, with the dictionary they need, as a trace file.
+    bool dumpRecording(const std::string& path, uint64_t fromNanos);
+
+    uint64_t string(std::string_view text);
+    uint64_t stack(jvmtiEnv* jvmti, JNIEnv* env, const jvmtiFrameInfo* frames, jint count);
+    uint64_t threadId(jvmtiEnv* jvmti, JNIEnv* env, jthread thread);
+
+    void onThreadStart(jvmtiEnv* jvmti, JNIEnv* env, jthread thread);
+
+    void classLoad(uint64_t nanos, uint64_t threadId, std::string_view className, std::string_view loader, uint64_t duration);
+    void exception(uint64_t nanos, uint64_t threadId, std::string_view className, std::string_view site, uint64_t stack);
+    void threadCpu(uint64_t nanos, uint64_t threadId, std::string_view name, uint64_t cpuNanos, uint64_t runQueueNanos,
+                   uint64_t voluntarySwitches, uint64_t involuntarySwitches);
+    void sample(uint64_t nanos, uint64_t threadId, uint64_t stack, bool runnable);
+    void milestone(uint64_t nanos, uint64_t threadId, std::string_view name);
+    // Safe inside GarbageCollectionStart/Finish: no JNI, no JVMTI, no allocation on the fast path.
+    void garbageCollection(uint64_t nanos, uint64_t threadId, uint64_t duration);
+    void compiledMethod(jvmtiEnv* jvmti, JNIEnv* env, uint64_t nanos, uint64_t threadId, jmethodID method, uint64_t codeSize);
+    void monitorWait(uint64_t nanos, uint64_t threadId, std::string_view className, uint64_t duration, bool contended);
+    void frame(uint64_t nanos, uint64_t threadId, std::string_view kind, uint64_t duration);
+    // "method" is an id from string(), interned once by the caller so the hot path takes no lock.
+    void methodCall(uint64_t nanos, uint64_t threadId, uint64_t method, uint64_t duration);
+    void nativeFrame(uint64_t nanos, uint64_t threadId, uint64_t calls, uint64_t draws, uint64_t stateChanges, uint64_t nativeNanos);
+    // "name" is an id from string(), as for methodCall.
+    void breakpointHit(uint64_t nanos, uint64_t threadId, uint64_t name, uint64_t bci);
+}
+
+#endif //TRACE_H
@@ -0,0 +1,163 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+// Rynox binary trace format, shared by the agent's writer and the offline tools.
+//
+// A trace is a sequence of fixed-size segments (the last one may be shorter). Segment 0 starts with
+// the FileHeader; every segment then has a SegmentHeader followed by records. A record is a 32-bit
+// little-endian header, (payload size << 8) | type, followed by the payload and padding to a multiple
+// of 4 bytes. A zero header ends the segment's data, a Pending header marks a record whose writer died
+// mid-copy and is skipped by size.
+//
+// Payloads are sequences of fields whose kinds are described by Metadata records at the start of the
+// file, so a reader can decode event types it does not know. Time fields are nanosecond deltas from
+// the segment's base time; strings and stack nodes are dictionary ids defined once by String and
+// StackNode records. Concurrent writers may land a StackNode just after its first use, so readers
+// resolve ids once the records have been read.
+namespace TraceFormat {
+    inline constexpr char FileMagic[8] = {'R', 'Y', 'N', 'X', 'T', 'R', 'C', '1'};
+    inline constexpr char SegmentMagic[4] = {'R', 'S', 'E', 'G'};
+    inline constexpr uint32_t Version = 1;
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t segmentSize;
+        uint64_t startNanos;
+        uint64_t startEpochMillis;
+        uint32_t pid;
+        uint32_t reserved;
+    };
+
+    struct SegmentHeader {
+        char magic[4];
+        uint32_t index;
+        uint64_t baseNanos;
+    };
+
+    // A file-backed ring (the flight recorder's) starts with this header in a segment-sized slot;
+    // ring slot i follows at (i + 1) * segmentSize. Its dictionary records live in a companion trace
+    // file, and the two are stitched into a regular trace after a crash. "sealedSignal" is set by the
+    // crash handler, "closed" on a clean shutdown.
+    inline constexpr char RingMagic[4] = {'R', 'R', 'N', 'G'};
+
+    struct RingHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t segmentSize;
+        uint32_t segmentCount;
+        uint64_t startNanos;
+        uint64_t sealedNanos;
+        uint32_t sealedSignal;
+        uint32_t closed;
+    };
+
+    enum RecordType : uint8_t {
+        End = 0,
+        Metadata = 1,
+        String = 2,
+        StackNode = 3,
+        Checkpoint = 4,
+        FirstEvent = 16,
+        ThreadStart = 16,
+        ClassLoad = 17,
+        Exception = 18,
+        ThreadCpu = 19,
+        Sample = 20,
+        Milestone = 21,
+        GarbageCollection = 22,
+        CompiledMethod = 23,
+        MonitorWait = 24,
+        Frame = 25,
+        Crash = 26,
+        MethodCall = 27,
+        NativeFrame = 28,
+        BreakpointHit = 29,
+        Pending = 0xff,
+    };
+
+    inline constexpr uint32_t MaxPayload = (1u << 24) - 1;
+
+    inline constexpr uint32_t recordHeader(uint8_t type, uint32_t size) {
+        return (size << 8) | type;
+    }
+
+    // Bytes a record with this payload occupies, header and padding included.
+    inline constexpr size_t recordSpan(size_t payloadSize) {
+        return (sizeof(uint32_t) + payloadSize + 3) & ~static_cast<size_t>(3);
+    }
+
+    // Field kinds of event payloads.
+    enum FieldKind : char {
+        Time = 'T',      // zigzag varint delta from the segment base time
+        Duration = 'D',  // varint nanoseconds
+        Unsigned = 'U',  // varint
+        Signed = 'S',    // zigzag varint
+        StringRef = 's', // varint String id
+        StackRef = 'k',  // varint StackNode id of the innermost frame, 0 for none
+        ThreadRef = 't', // varint native thread id
+    };
+
+    struct Field {
+        const char* name;
+        FieldKind kind;
+    };
+
+    struct EventType {
+        uint8_t type;
+        const char* name;
+        const Field* fields;
+        size_t fieldCount;
+    };
+
+    // String:    varint id, bytes (rest of payload)
+    // StackNode: varint id, varint parent id (0 for outermost), varint method String id, signed line, signed bci
+    // Checkpoint: varint absolute nanos, varint records written so far
+    // Metadata:  varint type, name, varint field count, per field: name, kind byte (names are varint length + bytes)
+
+    inline constexpr Field ThreadStartFields[] = {{"time", Time}, {"thread", ThreadRef}, {"name", StringRef}};
+    inline constexpr Field ClassLoadFields[] = {{"time", Time}, {"thread", ThreadRef}, {"class", StringRef},
+                                                {"loader", StringRef}, {"duration", Duration}};
+    inline constexpr Field ExceptionFields[] = {{"time", Time}, {"thread", ThreadRef}, {"class", StringRef},
+                                                {"site", StringRef}, {"stack", StackRef}};
+    inline constexpr Field ThreadCpuFields[] = {{"time", Time}, {"thread", ThreadRef}, {"name", StringRef}, {"cpu", Duration},
+                                                {"runQueue", Duration}, {"voluntarySwitches", Unsigned},
+                                                {"involuntarySwitches", Unsigned}};
+    inline constexpr Field SampleFields[] = {{"time", Time}, {"thread", ThreadRef}, {"stack", StackRef}, {"runnable", Unsigned}};
+    inline constexpr Field MilestoneFields[] = {{"time", Time}, {"thread", ThreadRef}, {"name", StringRef}};
+    // Events with a duration are stamped with their start time.
+    inline constexpr Field GarbageCollectionFields[] = {{"time", Time}, {"thread", ThreadRef}, {"duration", Duration}};
+    inline constexpr Field CompiledMethodFields[] = {{"time", Time}, {"thread", ThreadRef}, {"method", StringRef}, {"codeSize", Unsigned}};
+    inline constexpr Field MonitorWaitFields[] = {{"time", Time}, {"thread", ThreadRef}, {"class", StringRef},
+                                                  {"duration", Duration}, {"contended", Unsigned}};
+    inline constexpr Field FrameFields[] = {{"time", Time}, {"thread", ThreadRef}, {"kind", StringRef}, {"duration", Duration}};
+    inline constexpr Field MethodCallFields[] = {{"time", Time}, {"thread", ThreadRef}, {"method", StringRef}, {"duration", Duration}};
+    // Totals of the wrapped native methods over one frame, stamped at its end.
+    inline constexpr Field NativeFrameFields[] = {{"time", Time}, {"thread", ThreadRef}, {"calls", Unsigned}, {"draws", Unsigned},
+                                                  {"stateChanges", Unsigned}, {"nativeTime", Duration}};
+    inline constexpr Field BreakpointHitFields[] = {{"time", Time}, {"thread", ThreadRef}, {"name", StringRef}, {"bci", Unsigned}};
+    inline constexpr Field CrashFields[] = {{"time", Time}, {"thread", ThreadRef}, {"signal", Unsigned}, {"address", Unsigned}};
+
+    inline constexpr EventType EventTypes[] = {
+        {ThreadStart, "ThreadStart", ThreadStartFields, std::size(ThreadStartFields)},
+        {ClassLoad, "ClassLoad", ClassLoadFields, std::size(ClassLoadFields)},
+        {Exception, "Exception", ExceptionFields, std::size(ExceptionFields)},
+        {ThreadCpu, "ThreadCpu", ThreadCpuFields, std::size(ThreadCpuFields)},
+        {Sample, "Sample", SampleFields, std::size(SampleFields)},
+        {Milestone, "Milestone", MilestoneFields, std::size(MilestoneFields)},
+        {GarbageCollection, "GarbageCollection", GarbageCollectionFields, std::size(GarbageCollectionFields)},
+        {CompiledMethod, "CompiledMethod", CompiledMethodFields, std::size(CompiledMethodFields)},
+        {MonitorWait, "MonitorWait", MonitorWaitFields, std::size(MonitorWaitFields)},
+        {Frame, "Frame", FrameFields, std::size(FrameFields)},
+        {Crash, "Crash", CrashFields, std::size(CrashFields)},
+        {MethodCall, "MethodCall", MethodCallFields, std::size(MethodCallFields)},
+        {NativeFrame, "NativeFrame", NativeFrameFields, std::size(NativeFrameFields)},
+        {BreakpointHit, "BreakpointHit", BreakpointHitFields, std::size(BreakpointHitFields)},
+    };
+}
+
+#endif //TRACE_FORMAT_H
@@ -0,0 +1,200 @@
+#include "TraceReader.h"
+#include "Varint.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    bool readString(const uint8_t*& cursor, const uint8_t* end, std::string_view& out) {
+        uint64_t length = 0;
+        if (!Varint::read(cursor, end, length) || length > static_cast<uint64_t>(end - cursor)) return false;
+        out = std::string_view(reinterpret_cast<const char*>(cursor), length);
+        cursor += length;
+        return true;
+    }
+}
+
+TraceReader::~TraceReader() {
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+}
+
+bool TraceReader::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat info{};
+    fstat(fd, &info);
+    size = static_cast<size_t>(info.st_size);
+    void* mapped = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        error = "cannot map " + path;
+        size = 0;
+        return false;
+    }
+    data = static_cast<const uint8_t*>(mapped);
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    if (size < sizeof(fileHeader) + sizeof(TraceFormat::SegmentHeader)) {
+        error = path + " is too short to be a trace";
+        return false;
+    }
+    std::memcpy(&fileHeader, data, sizeof(fileHeader));
+    if (std::memcmp(fileHeader.magic, TraceFormat::FileMagic, sizeof(fileHeader.magic)) != 0 || fileHeader.segmentSize == 0) {
+        error = path + " is not a Rynox trace";
+        return false;
+    }
+    if (fileHeader.version != TraceFormat::Version) {
+        error = path + " has unsupported trace version " + std::to_string(fileHeader.version);
+        return false;
+    }
+    segments = (size + fileHeader.segmentSize - 1) / fileHeader.segmentSize;
+
+    // Metadata is written first, so segment 0 describes every event type.
+    scanSegment(0, [this](uint8_t type, const uint8_t* payload, size_t length, uint64_t) {
+        if (type != TraceFormat::Metadata) return;
+        const uint8_t* cursor = payload;
+        const uint8_t* end = payload + length;
+        uint64_t eventType = 0, fieldCount = 0;
+        Schema schema;
+        if (!Varint::read(cursor, end, eventType) || !readString(cursor, end, schema.name) || !Varint::read(cursor, end, fieldCount)) return;
+        for (uint64_t i = 0; i < fieldCount; i++) {
+            Field field{};
+            if (!readString(cursor, end, field.name) || cursor >= end) return;
+            field.kind = static_cast<TraceFormat::FieldKind>(*cursor++);
+            schema.fields.push_back(field);
+        }
+        if (schema.fields.size() <= Event::MaxFields) schemas[static_cast<uint8_t>(eventType)] = std::move(schema);
+    });
+    return true;
+}
+
+void TraceReader::scanSegment(size_t index, const RecordVisitor& visitor) const {
+    size_t start = index * fileHeader.segmentSize;
+    size_t end = std::min(size, start + fileHeader.segmentSize);
+    size_t offset = start + (index == 0 ? sizeof(TraceFormat::FileHeader) : 0);
+    if (offset + sizeof(TraceFormat::SegmentHeader) > end) return;
+
+    TraceFormat::SegmentHeader segment{};
+    std::memcpy(&segment, data + offset, sizeof(segment));
+    if (std::memcmp(segment.magic, TraceFormat::SegmentMagic, sizeof(segment.magic)) != 0) return;
+    offset += sizeof(segment);
+
+    while (offset + sizeof(uint32_t) <= end) {
+        uint32_t header = 0;
+        std::memcpy(&header, data + offset, sizeof(header));
+        if (header == 0) break;
+        uint8_t type = static_cast<uint8_t>(header & 0xff);
+        size_t payloadSize = header >> 8;
+        size_t span = TraceFormat::recordSpan(payloadSize);
+        if (offset + span > end) break;
+        if (type != TraceFormat::Pending) visitor(type, data + offset + sizeof(header), payloadSize, segment.baseNanos);
+        offset += span;
+    }
+}
+
+void TraceReader::forEachSegment(unsigned threads, const std::function<void(size_t, unsigned)>& fn) const {
+    threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(segments)));
+    std::atomic<size_t> next = 0;
+    auto work = [&](unsigned worker) {
+        for (size_t index = next++; index < segments; index = next++) fn(index, worker);
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++) workers.emplace_back(work, i);
+    work(0);
+    for (auto& worker : workers) worker.join();
+}
+
+void TraceReader::loadDictionary(unsigned threads) {
+    std::mutex lock;
+    std::vector<std::pair<uint64_t, std::string_view>> allStrings;
+    forEachSegment(threads, [&](size_t index, unsigned) {
+        std::vector<std::pair<uint64_t, std::string_view>> localStrings;
+        std::vector<std::pair<uint64_t, StackNode>> localNodes;
+        scanSegment(index, [&](uint8_t type, const uint8_t* payload, size_t length, uint64_t) {
+            const uint8_t* cursor = payload;
+            const uint8_t* end = payload + length;
+            uint64_t id = 0;
+            if (type == TraceFormat::String && Varint::read(cursor, end, id)) {
+                localStrings.emplace_back(id, std::string_view(reinterpret_cast<const char*>(cursor), static_cast<size_t>(end - cursor)));
+            } else if (type == TraceFormat::StackNode && Varint::read(cursor, end, id)) {
+                StackNode node{};
+                uint64_t line = 0, bci = 0;
+                if (Varint::read(cursor, end, node.parent) && Varint::read(cursor, end, node.method) && Varint::read(cursor, end, line) &&
+                    Varint::read(cursor, end, bci)) {
+                    node.line = Varint::unzigzag(line);
+                    node.bci = Varint::unzigzag(bci);
+                    localNodes.emplace_back(id, node);
+                }
+            }
+        });
+
+        std::lock_guard guard(lock);
+        allStrings.insert(allStrings.end(), localStrings.begin(), localStrings.end());
+        for (const auto& [id, node] : localNodes) nodes.emplace(id, node);
+    });
+
+    strings.assign(allStrings.size() + 1, std::string_view());
+    for (const auto& [id, text] : allStrings) {
+        if (id < strings.size()) strings[id] = text;
+        else strayStrings[id] = text;
+    }
+}
+
+const TraceReader::Schema* TraceReader::schema(uint8_t type) const {
+    auto it = schemas.find(type);
+    return it == schemas.end() ? nullptr : &it->second;
+}
+
+int TraceReader::fieldIndex(uint8_t type, std::string_view name) const {
+    const Schema* found = schema(type);
+    if (!found) return -1;
+    for (size_t i = 0; i < found->fields.size(); i++) {
+        if (found->fields[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool TraceReader::decode(uint8_t type, const uint8_t* payload, size_t length, uint64_t baseNanos, Event& event) const {
+    const Schema* found = schema(type);
+    if (!found) return false;
+
+    const uint8_t* cursor = payload;
+    const uint8_t* end = payload + length;
+    event.type = type;
+    event.fieldCount = found->fields.size();
+    for (size_t i = 0; i < event.fieldCount; i++) {
+        uint64_t value = 0;
+        if (!Varint::read(cursor, end, value)) return false;
+        if (found->fields[i].kind == TraceFormat::Time) {
+            value = baseNanos + static_cast<uint64_t>(Varint::unzigzag(value));
+            if (i == 0) event.nanos = value;
+        }
+        event.values[i] = value;
+    }
+    return true;
+}
+
+std::string_view TraceReader::string(uint64_t id) const {
+    if (id < strings.size()) return strings[id];
+    auto it = strayStrings.find(id);
+    return it == strayStrings.end() ? std::string_view() : it->second;
+}
+
+const TraceReader::StackNode* TraceReader::node(uint64_t id) const {
+    auto it = nodes.find(id);
+    return it == nodes.end() ? nullptr : &it->second;
+}
+
+void TraceReader::frames(uint64_t leaf, std::vector<const StackNode*>& out) const {
+    out.clear();
+    for (const StackNode* current = node(leaf); current && out.size() < 4096; current = node(current->parent)) out.push_back(current);
+}
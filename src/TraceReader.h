@@ -0,0 +1,81 @@
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include "TraceFormat.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Zero-copy reader over a memory-mapped TraceFormat file. Segments are independent, so callers scan
+// them in parallel with forEachSegment; dictionary strings are views into the mapping.
+class TraceReader {
+public:
+    struct Field {
+        std::string_view name;
+        TraceFormat::FieldKind kind;
+    };
+
+    struct Schema {
+        std::string_view name;
+        std::vector<Field> fields;
+    };
+
+    struct StackNode {
+        uint64_t parent;
+        uint64_t method;
+        int64_t line;
+        int64_t bci;
+    };
+
+    // A decoded event: values in schema field order, with the time field already made absolute.
+    struct Event {
+        static constexpr size_t MaxFields = 16;
+        uint8_t type = 0;
+        uint64_t nanos = 0;
+        size_t fieldCount = 0;
+        uint64_t values[MaxFields] = {};
+    };
+
+    using RecordVisitor = std::function<void(uint8_t type, const uint8_t* payload, size_t size, uint64_t baseNanos)>;
+
+    ~TraceReader();
+
+    bool open(const std::string& path, std::string& error);
+
+    const TraceFormat::FileHeader& header() const { return fileHeader; }
+    size_t segmentCount() const { return segments; }
+
+    void scanSegment(size_t index, const RecordVisitor& visitor) const;
+    // Runs fn(segment index, worker index) over all segments on up to "threads" workers.
+    void forEachSegment(unsigned threads, const std::function<void(size_t, unsigned)>& fn) const;
+
+    // Reads String and StackNode records from every segment.
+    void loadDictionary(unsigned threads);
+
+    const Schema* schema(uint8_t type) const;
+    // Index of a field in Event::values, or -1.
+    int fieldIndex(uint8_t type, std::string_view name) const;
+    bool decode(uint8_t type, const uint8_t* payload, size_t size, uint64_t baseNanos, Event& event) const;
+
+    std::string_view string(uint64_t id) const;
+    const StackNode* node(uint64_t id) const;
+    // Frames of a stack, innermost first.
+    void frames(uint64_t leaf, std::vector<const StackNode*>& out) const;
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    size_t segments = 0;
+    TraceFormat::FileHeader fileHeader{};
+    std::unordered_map<uint8_t, Schema> schemas;
+    // Writers number strings densely from 1, so ids up to the count of String records index the
+    // vector; larger ones only come from damaged files and are kept aside rather than sized for.
+    std::vector<std::string_view> strings;
+    std::unordered_map<uint64_t, std::string_view> strayStrings;
+    std::unordered_map<uint64_t, StackNode> nodes;
+};
+
+#endif //TRACE_READER_H
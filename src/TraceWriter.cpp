@@ -0,0 +1,305 @@
+#include "TraceWriter.h"
+#include "Platform.h"
+#include "Varint.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const std::string& path, uint32_t size, uint64_t startNanos) {
+    std::lock_guard guard(rotateLock);
+    if (fd >= 0 || !segments.empty()) return false;
+
+    long page = sysconf(_SC_PAGESIZE);
+    segmentSize = static_cast<uint32_t>((size + page - 1) / page * page);
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "[Rynox] Failed to open trace file " << path << "." << std::endl;
+        return false;
+    }
+
+    Segment* first = mapSegment(0, startNanos);
+    if (!first) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    TraceFormat::FileHeader header{};
+    std::memcpy(header.magic, TraceFormat::FileMagic, sizeof(header.magic));
+    header.version = TraceFormat::Version;
+    header.segmentSize = segmentSize;
+    header.startNanos = startNanos;
+    header.startEpochMillis = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    header.pid = static_cast<uint32_t>(getpid());
+    std::memcpy(first->data, &header, sizeof(header));
+
+    // mapSegment put the segment header at offset 0; segment 0 keeps it right after the file header.
+    TraceFormat::SegmentHeader segmentHeader{};
+    std::memcpy(segmentHeader.magic, TraceFormat::SegmentMagic, sizeof(segmentHeader.magic));
+    segmentHeader.baseNanos = startNanos;
+    std::memcpy(first->data + sizeof(header), &segmentHeader, sizeof(segmentHeader));
+    first->used = sizeof(header) + sizeof(segmentHeader);
+
+    current.store(first, std::memory_order_release);
+    return true;
+}
+
+bool TraceWriter::openRing(uint32_t size, uint32_t segmentCount, uint64_t startNanos, const std::string& path) {
+    std::lock_guard guard(rotateLock);
+    if (fd >= 0 || ring || !segments.empty()) return false;
+
+    long page = sysconf(_SC_PAGESIZE);
+    segmentSize = static_cast<uint32_t>((size + page - 1) / page * page);
+    segmentCount = std::max(segmentCount, 2u);
+    auto fail = [this](const char* message) {
+        std::cerr << "[Rynox] " << message << std::endl;
+        for (auto& segment : segments) munmap(segment.data, segment.capacity);
+        segments.clear();
+        if (ringHeader) munmap(ringHeader, segmentSize);
+        ringHeader = nullptr;
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        return false;
+    };
+
+    if (!path.empty()) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(segmentCount + 1) * segmentSize) != 0) return fail("Failed to create trace ring file.");
+        void* header = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (header == MAP_FAILED) return fail("Failed to map trace ring file.");
+        ringHeader = static_cast<TraceFormat::RingHeader*>(header);
+        std::memcpy(ringHeader->magic, TraceFormat::RingMagic, sizeof(ringHeader->magic));
+        ringHeader->version = TraceFormat::Version;
+        ringHeader->segmentSize = segmentSize;
+        ringHeader->segmentCount = segmentCount;
+        ringHeader->startNanos = startNanos;
+    }
+
+    for (uint32_t i = 0; i < segmentCount; i++) {
+        void* data = fd >= 0 ? mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(i + 1) * segmentSize)
+                             : mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) return fail("Failed to allocate trace ring.");
+        Segment& segment = segments.emplace_back();
+        segment.data = static_cast<uint8_t*>(data);
+        segment.capacity = segmentSize;
+        segment.mapped = true;
+    }
+
+    ring = true;
+    initSegment(segments.front(), 0, startNanos);
+    current.store(&segments.front(), std::memory_order_release);
+    return true;
+}
+
+void TraceWriter::initSegment(Segment& segment, uint32_t index, uint64_t nanos) {
+    segment.index = index;
+    segment.baseNanos = nanos;
+
+    TraceFormat::SegmentHeader header{};
+    std::memcpy(header.magic, TraceFormat::SegmentMagic, sizeof(header.magic));
+    header.index = index;
+    header.baseNanos = nanos;
+    std::memcpy(segment.data, &header, sizeof(header));
+    segment.used = sizeof(header);
+}
+
+TraceWriter::Segment* TraceWriter::mapSegment(uint32_t index, uint64_t nanos) {
+    if (ring) return recycleSegment(index, nanos);
+
+    off_t offset = static_cast<off_t>(index) * segmentSize;
+    if (ftruncate(fd, offset + segmentSize) != 0) return nullptr;
+    void* data = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+    if (data == MAP_FAILED) return nullptr;
+
+    Segment& segment = segments.emplace_back();
+    segment.data = static_cast<uint8_t*>(data);
+    segment.capacity = segmentSize;
+    segment.mapped = true;
+    initSegment(segment, index, nanos);
+    return &segment;
+}
+
+TraceWriter::Segment* TraceWriter::recycleSegment(uint32_t index, uint64_t nanos) {
+    // Slots are used round robin, so the slot for this index holds the oldest segment. A writer that
+    // registered just before its retirement may still be copying; it is done within microseconds.
+    Segment& segment = segments[index % segments.size()];
+    while (segment.writers.load() != 0) std::this_thread::yield();
+    std::memset(segment.data, 0, segment.capacity);
+    initSegment(segment, index, nanos);
+    return &segment;
+}
+
+bool TraceWriter::append(uint8_t type, const uint8_t* payload, size_t size) {
+    return write(type, false, 0, payload, size);
+}
+
+bool TraceWriter::appendEvent(uint8_t type, uint64_t nanos, const uint8_t* fields, size_t size) {
+    return write(type, true, nanos, fields, size);
+}
+
+bool TraceWriter::appendEventNow(uint8_t type, uint64_t nanos, const uint8_t* fields, size_t size) {
+    return write(type, true, nanos, fields, size, false);
+}
+
+bool TraceWriter::write(uint8_t type, bool event, uint64_t nanos, const uint8_t* payload, size_t size, bool mayRotate) {
+    for (;;) {
+        Segment* segment = current.load();
+        if (!segment) return false;
+
+        // Publish ourselves as a writer, then make sure the segment was not retired in between.
+        segment->writers.fetch_add(1);
+        if (current.load() != segment) {
+            segment->writers.fetch_sub(1);
+            continue;
+        }
+
+        uint8_t time[Varint::MaxBytes];
+        size_t timeSize = event ? Varint::encode(time, Varint::zigzag(static_cast<int64_t>(nanos - segment->baseNanos))) : 0;
+        size_t payloadSize = timeSize + size;
+        size_t total = TraceFormat::recordSpan(payloadSize);
+        if (payloadSize > TraceFormat::MaxPayload || total + sizeof(TraceFormat::FileHeader) + sizeof(TraceFormat::SegmentHeader) > segmentSize) {
+            segment->writers.fetch_sub(1);
+            return false;
+        }
+
+        size_t offset = segment->used.fetch_add(total, std::memory_order_relaxed);
+        if (offset + total > segment->capacity) {
+            segment->writers.fetch_sub(1);
+            if (!mayRotate) return false;
+            rotate(segment);
+            continue;
+        }
+
+        uint8_t* record = segment->data + offset;
+        auto* header = reinterpret_cast<std::atomic<uint32_t>*>(record);
+        header->store(TraceFormat::recordHeader(TraceFormat::Pending, static_cast<uint32_t>(payloadSize)), std::memory_order_relaxed);
+        std::memcpy(record + sizeof(uint32_t), time, timeSize);
+        std::memcpy(record + sizeof(uint32_t) + timeSize, payload, size);
+        header->store(TraceFormat::recordHeader(type, static_cast<uint32_t>(payloadSize)), std::memory_order_release);
+
+        segment->writers.fetch_sub(1);
+        recordCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+}
+
+void TraceWriter::rotate(Segment* full) {
+    std::lock_guard guard(rotateLock);
+    if (current.load() != full) return;
+
+    uint64_t now = Platform::nanoTime();
+    Segment* next = mapSegment(full->index + 1, now);
+    if (!next) {
+        std::cerr << "[Rynox] Failed to extend trace file, tracing stopped." << std::endl;
+        current.store(nullptr);
+        return;
+    }
+    writeCheckpoint(next, now);
+    current.store(next);
+    unmapRetired();
+}
+
+void TraceWriter::writeCheckpoint(Segment* segment, uint64_t nanos) {
+    std::vector<uint8_t> payload;
+    Varint::write(payload, nanos);
+    Varint::write(payload, recordCount.load(std::memory_order_relaxed));
+    size_t offset = segment->used.load();
+    size_t span = TraceFormat::recordSpan(payload.size());
+    if (offset + span > segment->capacity) return;
+    std::memcpy(segment->data + offset + sizeof(uint32_t), payload.data(), payload.size());
+    uint32_t header = TraceFormat::recordHeader(TraceFormat::Checkpoint, static_cast<uint32_t>(payload.size()));
+    reinterpret_cast<std::atomic<uint32_t>*>(segment->data + offset)->store(header, std::memory_order_release);
+    segment->used = offset + span;
+}
+
+void TraceWriter::seal(int signal) {
+    uint8_t payload[2 * Varint::MaxBytes];
+    uint64_t now = Platform::nanoTime();
+    size_t size = Varint::encode(payload, now);
+    size += Varint::encode(payload + size, recordCount.load(std::memory_order_relaxed));
+    write(TraceFormat::Checkpoint, false, 0, payload, size, false);
+
+    if (!ringHeader) return;
+    ringHeader->sealedNanos = now;
+    ringHeader->sealedSignal = static_cast<uint32_t>(signal);
+}
+
+void TraceWriter::unmapRetired() {
+    if (ring) return;
+    Segment* live = current.load();
+    for (auto& segment : segments) {
+        if (&segment == live || !segment.mapped || segment.writers.load() != 0) continue;
+        munmap(segment.data, segment.capacity);
+        segment.mapped = false;
+    }
+}
+
+std::vector<TraceWriter::SegmentCopy> TraceWriter::snapshot(uint64_t fromNanos) {
+    std::lock_guard guard(rotateLock);
+    std::vector<Segment*> live;
+    for (auto& segment : segments) {
+        if (segment.mapped && segment.used.load() > 0) live.push_back(&segment);
+    }
+    std::sort(live.begin(), live.end(), [](const Segment* a, const Segment* b) { return a->index < b->index; });
+
+    std::vector<SegmentCopy> copies;
+    for (size_t i = 0; i < live.size(); i++) {
+        // A segment's records end where the next one begins.
+        if (i + 1 < live.size() && live[i + 1]->baseNanos < fromNanos) continue;
+        size_t used = std::min(live[i]->used.load(), live[i]->capacity);
+        copies.push_back({live[i]->index, live[i]->baseNanos, std::vector<uint8_t>(live[i]->data, live[i]->data + used)});
+    }
+    return copies;
+}
+
+// Only unmaps: a writer that loaded "current" just before the exchange still registers on its
+// Segment and then backs off, so the structs must outlive the writer, which is not reopened.
+void TraceWriter::close() {
+    std::lock_guard guard(rotateLock);
+    Segment* last = current.exchange(nullptr);
+    if (ring) {
+        for (auto& segment : segments) {
+            while (segment.writers.load() != 0) std::this_thread::yield();
+            if (segment.mapped) munmap(segment.data, segment.capacity);
+        }
+        for (auto& segment : segments) segment.mapped = false;
+        ring = false;
+        if (ringHeader) {
+            ringHeader->closed = 1;
+            munmap(ringHeader, segmentSize);
+            ringHeader = nullptr;
+        }
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        return;
+    }
+    if (fd < 0) return;
+
+    if (last) {
+        while (last->writers.load() != 0) std::this_thread::yield();
+        writeCheckpoint(last, Platform::nanoTime());
+    }
+    for (auto& segment : segments) {
+        while (segment.writers.load() != 0) std::this_thread::yield();
+        if (segment.mapped) munmap(segment.data, segment.capacity);
+        segment.mapped = false;
+    }
+    if (last) {
+        size_t used = std::min(last->used.load(), last->capacity);
+        if (ftruncate(fd, static_cast<off_t>(last->index) * segmentSize + static_cast<off_t>(used)) != 0) {
+            std::cerr << "[Rynox] Failed to trim trace file." << std::endl;
+        }
+    }
+    ::close(fd);
+    fd = -1;
+}
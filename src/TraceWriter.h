@@ -0,0 +1,83 @@
+#ifndef TRACE_WRITER_H
+#define TRACE_WRITER_H
+
+#include "TraceFormat.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Appends TraceFormat records into mmap-ed segments of a trace file. Writers reserve space with one
+// atomic add and copy the record into the mapping, so there is no syscall per event; only switching to
+// a new segment (ftruncate + mmap) takes a lock. Pages are MAP_SHARED, so everything written before a
+// crash is in the page cache and stays readable.
+//
+// In ring mode the segments are a fixed pool that rotation recycles oldest first, so memory stays
+// bounded and only the most recent records are kept; snapshot() copies them out. With a path the pool
+// is mapped from a file laid out as TraceFormat::RingHeader describes, so it outlives a crash.
+class TraceWriter {
+public:
+    // A copied segment: SegmentHeader at offset 0, cut after the last reserved record.
+    struct SegmentCopy {
+        uint32_t index;
+        uint64_t baseNanos;
+        std::vector<uint8_t> data;
+    };
+
+    ~TraceWriter();
+
+    bool open(const std::string& path, uint32_t segmentSize, uint64_t startNanos);
+    bool openRing(uint32_t segmentSize, uint32_t segmentCount, uint64_t startNanos, const std::string& path = {});
+    // Unmaps the segments but keeps their bookkeeping for racing writers; a closed writer is not reopened.
+    void close();
+    bool isOpen() const { return current.load(std::memory_order_acquire) != nullptr; }
+
+    // Dictionary and metadata records.
+    bool append(uint8_t type, const uint8_t* payload, size_t size);
+    // Events: the time field is encoded against the base of the segment the record lands in.
+    bool appendEvent(uint8_t type, uint64_t nanos, const uint8_t* fields, size_t size);
+
+    // Async-signal-safe variant for crash handlers: never rotates or locks, drops the record instead.
+    bool appendEventNow(uint8_t type, uint64_t nanos, const uint8_t* fields, size_t size);
+    // Async-signal-safe: ends the live segment with a checkpoint and marks a ring file as sealed.
+    void seal(int signal);
+
+    uint64_t records() const { return recordCount.load(std::memory_order_relaxed); }
+    uint32_t segmentBytes() const { return segmentSize; }
+
+    // Segments holding records from "fromNanos" on, oldest first. Rotation waits while copying, so
+    // the copy is a consistent freeze of the ring; records still being written read as padding.
+    std::vector<SegmentCopy> snapshot(uint64_t fromNanos);
+
+private:
+    struct Segment {
+        uint32_t index = 0;
+        uint64_t baseNanos = 0;
+        uint8_t* data = nullptr;
+        size_t capacity = 0;
+        std::atomic<size_t> used = 0;
+        std::atomic<uint32_t> writers = 0;
+        bool mapped = false;
+    };
+
+    bool write(uint8_t type, bool event, uint64_t nanos, const uint8_t* payload, size_t size, bool mayRotate = true);
+    Segment* mapSegment(uint32_t index, uint64_t nanos);
+    Segment* recycleSegment(uint32_t index, uint64_t nanos);
+    static void initSegment(Segment& segment, uint32_t index, uint64_t nanos);
+    void rotate(Segment* full);
+    void unmapRetired();
+    void writeCheckpoint(Segment* segment, uint64_t nanos);
+
+    int fd = -1;
+    bool ring = false;
+    TraceFormat::RingHeader* ringHeader = nullptr;
+    uint32_t segmentSize = 0;
+    std::atomic<Segment*> current = nullptr;
+    std::atomic<uint64_t> recordCount = 0;
+    std::mutex rotateLock;
+    std::deque<Segment> segments;
+};
+
+#endif //TRACE_WRITER_H
@@ -0,0 +1,102 @@
+#include "TransformCache.h"
+#include "ClassFilter.h"
+#include "Options.h"
+#include "Platform.h"
+#include "Varint.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+
+namespace {
+    constexpr char Magic[4] = {'R', 'P', 'C', 'C'};
+
+    std::string directory;
+
+    std::string pathOf(uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.class", static_cast<unsigned long long>(key));
+        return directory + name;
+    }
+}
+
+bool TransformCache::enabled() {
+    return !directory.empty();
+}
+
+void TransformCache::configure() {
+    directory = Options::get("probe-cache");
+    if (enabled()) mkdir(directory.c_str(), 0755);
+}
+
+uint64_t TransformCache::key(const uint8_t* classData, size_t length, std::string_view className, std::string_view selection) {
+    uint64_t key = ClassFilter::hash(className.data(), className.size(), Version);
+    key = ClassFilter::hash(selection.data(), selection.size(), key);
+    return ClassFilter::hash(classData, length, key);
+}
+
+// Magic, varint version, probe count, (name, flags) per probe, site count, (offset, probe) pairs, then the class.
+bool TransformCache::load(uint64_t key, Entry& entry) {
+    std::ifstream in(pathOf(key), std::ios::binary);
+    if (!in) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    const uint8_t* position = data.data();
+    const uint8_t* end = position + data.size();
+    if (data.size() < sizeof(Magic) || std::memcmp(position, Magic, sizeof(Magic)) != 0) return false;
+    position += sizeof(Magic);
+
+    uint64_t version = 0, probes = 0, sites = 0;
+    if (!Varint::read(position, end, version) || version != Version || !Varint::read(position, end, probes)) return false;
+    entry.probes.clear();
+    for (uint64_t i = 0; i < probes; i++) {
+        uint64_t length = 0, flags = 0;
+        if (!Varint::read(position, end, length) || length > static_cast<uint64_t>(end - position)) return false;
+        std::string name(reinterpret_cast<const char*>(position), length);
+        position += length;
+        if (!Varint::read(position, end, flags)) return false;
+        entry.probes.push_back({std::move(name), (flags & 1) != 0, (flags & 2) != 0});
+    }
+    if (!Varint::read(position, end, sites)) return false;
+    entry.sites.clear();
+    for (uint64_t i = 0; i < sites; i++) {
+        uint64_t offset = 0, probe = 0;
+        if (!Varint::read(position, end, offset) || !Varint::read(position, end, probe) || probe >= probes) return false;
+        entry.sites.push_back({static_cast<uint32_t>(offset), static_cast<uint32_t>(probe)});
+    }
+    entry.classData.assign(position, end);
+    for (const auto& site : entry.sites) {
+        if (site.offset + 2 > entry.classData.size()) return false;
+    }
+    return true;
+}
+
+void TransformCache::store(uint64_t key, const Entry& entry) {
+    std::vector<uint8_t> data(Magic, Magic + sizeof(Magic));
+    Varint::write(data, Version);
+    Varint::write(data, entry.probes.size());
+    for (const auto& probe : entry.probes) {
+        Varint::writeString(data, probe.name);
+        Varint::write(data, (probe.count ? 1 : 0) | (probe.native ? 2 : 0));
+    }
+    Varint::write(data, entry.sites.size());
+    for (const auto& site : entry.sites) {
+        Varint::write(data, site.offset);
+        Varint::write(data, site.probe);
+    }
+    data.insert(data.end(), entry.classData.begin(), entry.classData.end());
+
+    // Written under a per-thread temporary name and renamed, so concurrent loads never see half a file.
+    std::string path = pathOf(key);
+    std::string temporary = path + "." + std::to_string(Platform::currentThreadId()) + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    std::rename(temporary.c_str(), path.c_str());
+}
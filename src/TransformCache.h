@@ -0,0 +1,47 @@
+#ifndef TRANSFORM_CACHE_H
+#define TRANSFORM_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Instrumented classes persisted across launches in "probe-cache=<directory>", one file per class
+// named by a hash of its original bytes, its method selection and the rewriter version, so a class
+// that has not changed since the last launch is taken from disk instead of being parsed and rewritten.
+// Probe ids are assigned per launch, so an entry stores the probe names and the offsets of their id
+// operands; the loader renumbers those in place.
+namespace TransformCache {
+    // Bump whenever the Instrumenter's output changes.
+    inline constexpr uint32_t Version = 5;
+
+    struct Site {
+        uint32_t offset;
+        // Index into Entry::probes.
+        uint32_t probe;
+    };
+
+    struct Probe {
+        std::string name;
+        bool count;
+        // A wrapped native, counted and timed.
+        bool native = false;
+    };
+
+    struct Entry {
+        std::vector<Probe> probes;
+        std::vector<Site> sites;
+        std::vector<uint8_t> classData;
+    };
+
+    bool enabled();
+    void configure();
+
+    // "selection" is any canonical text for what the class's methods get.
+    uint64_t key(const uint8_t* classData, size_t length, std::string_view className, std::string_view selection);
+    bool load(uint64_t key, Entry& entry);
+    void store(uint64_t key, const Entry& entry);
+}
+
+#endif //TRANSFORM_CACHE_H
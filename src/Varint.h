@@ -0,0 +1,57 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// LEB128 varints with zigzag for signed values, shared by every compact format the agent writes.
+namespace Varint {
+    inline constexpr size_t MaxBytes = 10;
+
+    inline size_t encode(uint8_t* out, uint64_t value) {
+        size_t size = 0;
+        while (value >= 0x80) {
+            out[size++] = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        out[size++] = static_cast<uint8_t>(value);
+        return size;
+    }
+
+    inline uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    inline int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    inline void write(std::vector<uint8_t>& out, uint64_t value) {
+        uint8_t buffer[MaxBytes];
+        out.insert(out.end(), buffer, buffer + encode(buffer, value));
+    }
+
+    inline void writeSigned(std::vector<uint8_t>& out, int64_t value) {
+        write(out, zigzag(value));
+    }
+
+    inline void writeString(std::vector<uint8_t>& out, std::string_view text) {
+        write(out, text.size());
+        out.insert(out.end(), text.begin(), text.end());
+    }
+
+    // Returns false on truncated or overlong input; "data" advances past the value.
+    inline bool read(const uint8_t*& data, const uint8_t* end, uint64_t& value) {
+        value = 0;
+        for (unsigned shift = 0; shift < 64 && data < end; shift += 7) {
+            uint8_t byte = *data++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+}
+
+#endif //VARINT_H
@@ -0,0 +1,138 @@
+#include "Capture.h"
+#include <algorithm>
+
+namespace {
+    struct Partial {
+        uint64_t firstNanos = UINT64_MAX;
+        uint64_t lastNanos = 0;
+        std::unordered_map<uint8_t, uint64_t> eventCounts;
+        std::unordered_map<uint64_t, uint64_t> wallSamples;
+        std::unordered_map<uint64_t, uint64_t> cpuSamples;
+        std::vector<Report::ClassLoad> classLoads;
+        std::unordered_map<uint64_t, uint64_t> exceptionSites;
+        std::unordered_map<uint64_t, Report::ThreadTotals> threads;
+    };
+
+    // Field positions looked up by name, so older or newer traces with extra fields still decode.
+    struct Layout {
+        int sampleThread, sampleStack, sampleRunnable;
+        int loadThread, loadClass, loadLoader, loadDuration;
+        int exceptionSite;
+        int cpuThread, cpuName, cpuTime, cpuRunQueue, cpuVoluntary, cpuInvoluntary;
+        int startThread, startName;
+    };
+
+    uint64_t value(const TraceReader::Event& event, int index) {
+        return index >= 0 ? event.values[index] : 0;
+    }
+
+    template <typename Map>
+    void mergeCounts(Map& into, const Map& from) {
+        for (const auto& [key, count] : from) into[key] += count;
+    }
+}
+
+std::string Report::frameName(std::string_view method) {
+    std::string name(method.substr(0, method.find('(')));
+    std::replace(name.begin(), name.end(), '/', '.');
+    return name;
+}
+
+std::string Report::collapsedStack(const TraceReader& reader, uint64_t leaf) {
+    std::vector<const TraceReader::StackNode*> frames;
+    reader.frames(leaf, frames);
+    std::string stack;
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+        if (!stack.empty()) stack += ';';
+        stack += frameName(reader.string((*it)->method));
+    }
+    return stack.empty() ? "[unknown]" : stack;
+}
+
+bool Report::load(const std::string& path, const LoadOptions& options, Capture& capture, std::string& error) {
+    TraceReader& reader = capture.reader;
+    if (!reader.open(path, error)) return false;
+    reader.loadDictionary(options.threads);
+
+    using TraceFormat::RecordType;
+    Layout layout{
+        reader.fieldIndex(RecordType::Sample, "thread"), reader.fieldIndex(RecordType::Sample, "stack"),
+        reader.fieldIndex(RecordType::Sample, "runnable"),
+        reader.fieldIndex(RecordType::ClassLoad, "thread"), reader.fieldIndex(RecordType::ClassLoad, "class"),
+        reader.fieldIndex(RecordType::ClassLoad, "loader"), reader.fieldIndex(RecordType::ClassLoad, "duration"),
+        reader.fieldIndex(RecordType::Exception, "site"),
+        reader.fieldIndex(RecordType::ThreadCpu, "thread"), reader.fieldIndex(RecordType::ThreadCpu, "name"),
+        reader.fieldIndex(RecordType::ThreadCpu, "cpu"), reader.fieldIndex(RecordType::ThreadCpu, "runQueue"),
+        reader.fieldIndex(RecordType::ThreadCpu, "voluntarySwitches"), reader.fieldIndex(RecordType::ThreadCpu, "involuntarySwitches"),
+        reader.fieldIndex(RecordType::ThreadStart, "thread"), reader.fieldIndex(RecordType::ThreadStart, "name"),
+    };
+
+    uint64_t start = reader.header().startNanos;
+    uint64_t from = start + options.fromNanos;
+    uint64_t to = options.toNanos == UINT64_MAX ? UINT64_MAX : start + options.toNanos;
+
+    std::vector<Partial> partials(std::max(1u, options.threads));
+    reader.forEachSegment(options.threads, [&](size_t index, unsigned worker) {
+        Partial& partial = partials[worker];
+        TraceReader::Event event;
+        reader.scanSegment(index, [&](uint8_t type, const uint8_t* payload, size_t size, uint64_t base) {
+            if (type < TraceFormat::FirstEvent || !reader.decode(type, payload, size, base, event)) return;
+            // Thread names are kept regardless of the window so every sampled thread has one.
+            if (type == RecordType::ThreadStart) {
+                partial.threads[value(event, layout.startThread)].name = value(event, layout.startName);
+                return;
+            }
+            if (event.nanos < from || event.nanos > to) return;
+
+            partial.firstNanos = std::min(partial.firstNanos, event.nanos);
+            partial.lastNanos = std::max(partial.lastNanos, event.nanos);
+            partial.eventCounts[type]++;
+            switch (type) {
+                case RecordType::Sample: {
+                    uint64_t stack = value(event, layout.sampleStack);
+                    partial.wallSamples[stack]++;
+                    if (value(event, layout.sampleRunnable)) partial.cpuSamples[stack]++;
+                    partial.threads[value(event, layout.sampleThread)].samples++;
+                    break;
+                }
+                case RecordType::ClassLoad:
+                    partial.classLoads.push_back({event.nanos, value(event, layout.loadDuration), value(event, layout.loadThread),
+                                                  value(event, layout.loadClass), value(event, layout.loadLoader)});
+                    break;
+                case RecordType::Exception:
+                    partial.exceptionSites[value(event, layout.exceptionSite)]++;
+                    break;
+                case RecordType::ThreadCpu: {
+                    ThreadTotals& thread = partial.threads[value(event, layout.cpuThread)];
+                    if (!thread.name) thread.name = value(event, layout.cpuName);
+                    thread.cpuNanos += value(event, layout.cpuTime);
+                    thread.runQueueNanos += value(event, layout.cpuRunQueue);
+                    thread.switches += value(event, layout.cpuVoluntary) + value(event, layout.cpuInvoluntary);
+                    break;
+                }
+                default:
+                    break;
+            }
+        });
+    });
+
+    for (auto& partial : partials) {
+        capture.firstNanos = std::min(capture.firstNanos, partial.firstNanos);
+        capture.lastNanos = std::max(capture.lastNanos, partial.lastNanos);
+        mergeCounts(capture.eventCounts, partial.eventCounts);
+        mergeCounts(capture.wallSamples, partial.wallSamples);
+        mergeCounts(capture.cpuSamples, partial.cpuSamples);
+        mergeCounts(capture.exceptionSites, partial.exceptionSites);
+        capture.classLoads.insert(capture.classLoads.end(), partial.classLoads.begin(), partial.classLoads.end());
+        for (const auto& [id, totals] : partial.threads) {
+            ThreadTotals& thread = capture.threads[id];
+            if (!thread.name) thread.name = totals.name;
+            thread.cpuNanos += totals.cpuNanos;
+            thread.runQueueNanos += totals.runQueueNanos;
+            thread.switches += totals.switches;
+            thread.samples += totals.samples;
+        }
+    }
+    if (capture.firstNanos > capture.lastNanos) capture.firstNanos = capture.lastNanos = start;
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef REPORT_CAPTURE_H
+#define REPORT_CAPTURE_H
+
+#include "TraceReader.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Report {
+    struct LoadOptions {
+        // Time window relative to the trace start, in nanoseconds.
+        uint64_t fromNanos = 0;
+        uint64_t toNanos = UINT64_MAX;
+        unsigned threads = 1;
+    };
+
+    struct ClassLoad {
+        uint64_t nanos;
+        uint64_t duration;
+        uint64_t thread;
+        uint64_t className;
+        uint64_t loader;
+    };
+
+    struct ThreadTotals {
+        uint64_t name = 0;
+        uint64_t cpuNanos = 0;
+        uint64_t runQueueNanos = 0;
+        uint64_t switches = 0;
+        uint64_t samples = 0;
+    };
+
+    // Per-capture aggregates, built by scanning segments in parallel and merging the partial results.
+    struct Capture {
+        TraceReader reader;
+        uint64_t firstNanos = UINT64_MAX;
+        uint64_t lastNanos = 0;
+        std::unordered_map<uint8_t, uint64_t> eventCounts;
+        std::unordered_map<uint64_t, uint64_t> wallSamples;
+        std::unordered_map<uint64_t, uint64_t> cpuSamples;
+        std::vector<ClassLoad> classLoads;
+        std::unordered_map<uint64_t, uint64_t> exceptionSites;
+        std::unordered_map<uint64_t, ThreadTotals> threads;
+    };
+
+    bool load(const std::string& path, const LoadOptions& options, Capture& capture, std::string& error);
+
+    // "net.minecraft.client.Minecraft.tick" from a method String of the trace.
+    std::string frameName(std::string_view method);
+    // Root-first frame names joined with ';', the collapsed-stack format of flame graph tools.
+    std::string collapsedStack(const TraceReader& reader, uint64_t leaf);
+}
+
+#endif //REPORT_CAPTURE_H
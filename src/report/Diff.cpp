@@ -0,0 +1,116 @@
+#include "Diff.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+    using Counts = std::unordered_map<std::string, uint64_t>;
+
+    std::string_view className(std::string_view frame) {
+        size_t dot = frame.rfind('.');
+        return dot == std::string_view::npos ? frame : frame.substr(0, dot);
+    }
+
+    // Keys of one stack at the requested level, each counted once per stack.
+    void keys(const TraceReader& reader, uint64_t leaf, Report::DiffLevel level, std::vector<std::string>& out) {
+        out.clear();
+        if (level == Report::DiffLevel::Stack) {
+            out.push_back(Report::collapsedStack(reader, leaf));
+            return;
+        }
+
+        std::vector<const TraceReader::StackNode*> frames;
+        reader.frames(leaf, frames);
+        if (frames.empty()) {
+            out.emplace_back("[unknown]");
+            return;
+        }
+        std::string self = Report::frameName(reader.string(frames.front()->method));
+        if (level == Report::DiffLevel::Method) out.push_back(self);
+        else if (level == Report::DiffLevel::Class) out.emplace_back(className(self));
+        else {
+            std::unordered_set<std::string> seen;
+            for (const auto* frame : frames) {
+                std::string name = Report::frameName(reader.string(frame->method));
+                if (seen.insert(name).second) out.push_back(std::move(name));
+            }
+        }
+    }
+
+    // Splits the sampled leaves across workers and merges their partial maps.
+    Counts aggregate(const Report::Capture& capture, const Report::DiffOptions& options, uint64_t& total) {
+        const auto& samples = options.cpu ? capture.cpuSamples : capture.wallSamples;
+        std::vector<std::pair<uint64_t, uint64_t>> leaves(samples.begin(), samples.end());
+        total = 0;
+        for (const auto& [leaf, count] : leaves) total += count;
+
+        unsigned workers = std::max(1u, std::min<unsigned>(options.threads, static_cast<unsigned>(leaves.size() / 256 + 1)));
+        std::vector<Counts> partials(workers);
+        std::vector<std::thread> threads;
+        for (unsigned worker = 0; worker < workers; worker++) {
+            threads.emplace_back([&, worker] {
+                std::vector<std::string> rowKeys;
+                for (size_t i = worker; i < leaves.size(); i += workers) {
+                    keys(capture.reader, leaves[i].first, options.level, rowKeys);
+                    for (auto& key : rowKeys) partials[worker][std::move(key)] += leaves[i].second;
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+
+        Counts merged = std::move(partials.front());
+        for (size_t i = 1; i < partials.size(); i++) {
+            for (auto& [key, count] : partials[i]) merged[key] += count;
+        }
+        return merged;
+    }
+
+    double zScore(uint64_t a, uint64_t n1, uint64_t b, uint64_t n2) {
+        if (!n1 || !n2) return 0;
+        double p1 = static_cast<double>(a) / static_cast<double>(n1);
+        double p2 = static_cast<double>(b) / static_cast<double>(n2);
+        double pooled = static_cast<double>(a + b) / static_cast<double>(n1 + n2);
+        double error = std::sqrt(pooled * (1 - pooled) * (1.0 / static_cast<double>(n1) + 1.0 / static_cast<double>(n2)));
+        return error > 0 ? (p2 - p1) / error : 0;
+    }
+}
+
+std::vector<Report::DiffRow> Report::diff(const Capture& baseline, const Capture& candidate, const DiffOptions& options,
+                                          uint64_t& baselineTotal, uint64_t& candidateTotal) {
+    Counts before = aggregate(baseline, options, baselineTotal);
+    Counts after = aggregate(candidate, options, candidateTotal);
+    for (const auto& [key, count] : before) after.try_emplace(key, 0);
+
+    auto share = [](uint64_t count, uint64_t total) { return total ? 100.0 * static_cast<double>(count) / static_cast<double>(total) : 0.0; };
+    std::vector<DiffRow> rows;
+    for (const auto& [key, count] : after) {
+        auto it = before.find(key);
+        DiffRow row{key, it == before.end() ? 0 : it->second, count};
+        row.baselineShare = share(row.baseline, baselineTotal);
+        row.candidateShare = share(row.candidate, candidateTotal);
+        row.delta = row.candidateShare - row.baselineShare;
+        row.z = zScore(row.baseline, baselineTotal, row.candidate, candidateTotal);
+        if (std::abs(row.z) >= options.minZ && std::abs(row.delta) >= options.minDelta) rows.push_back(std::move(row));
+    }
+    std::sort(rows.begin(), rows.end(), [](const DiffRow& a, const DiffRow& b) { return a.delta > b.delta; });
+    return rows;
+}
+
+void Report::writeDiffFlame(const Capture& baseline, const Capture& candidate, const DiffOptions& options, std::ostream& out) {
+    DiffOptions stacks = options;
+    stacks.level = DiffLevel::Stack;
+    uint64_t baselineTotal = 0;
+    uint64_t candidateTotal = 0;
+    Counts before = aggregate(baseline, stacks, baselineTotal);
+    Counts after = aggregate(candidate, stacks, candidateTotal);
+    for (const auto& [key, count] : before) after.try_emplace(key, 0);
+
+    double scale = candidateTotal ? static_cast<double>(baselineTotal) / static_cast<double>(candidateTotal) : 0.0;
+    for (const auto& [stack, count] : after) {
+        auto it = before.find(stack);
+        out << stack << ' ' << (it == before.end() ? 0 : it->second) << ' '
+            << static_cast<uint64_t>(std::llround(static_cast<double>(count) * scale)) << '\n';
+    }
+}
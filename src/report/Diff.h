@@ -0,0 +1,42 @@
+#ifndef REPORT_DIFF_H
+#define REPORT_DIFF_H
+
+#include "Capture.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Report {
+    enum class DiffLevel { Stack, Method, MethodTotal, Class };
+
+    struct DiffOptions {
+        DiffLevel level = DiffLevel::Method;
+        bool cpu = false;
+        // Rows must pass both: |z| of a two-proportion test and the share change in percentage points.
+        double minZ = 3.0;
+        double minDelta = 0.1;
+        unsigned threads = 1;
+    };
+
+    struct DiffRow {
+        std::string key;
+        uint64_t baseline = 0;
+        uint64_t candidate = 0;
+        // Shares of each capture's sample total, in percent; delta is candidate minus baseline.
+        double baselineShare = 0;
+        double candidateShare = 0;
+        double delta = 0;
+        double z = 0;
+    };
+
+    // Compares sample shares rather than raw counts, so captures of different length or sampling
+    // rate line up. Rows are significant changes, sorted by delta, largest regression first.
+    std::vector<DiffRow> diff(const Capture& baseline, const Capture& candidate, const DiffOptions& options,
+                              uint64_t& baselineTotal, uint64_t& candidateTotal);
+
+    // "stack baseline candidate" lines with the candidate scaled to the baseline total, the input of
+    // flamegraph.pl for a differential flame graph (red grew, blue shrank).
+    void writeDiffFlame(const Capture& baseline, const Capture& candidate, const DiffOptions& options, std::ostream& out);
+}
+
+#endif //REPORT_DIFF_H
@@ -0,0 +1,84 @@
+#include "History.h"
+#include "Capture.h"
+#include <algorithm>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+    bool readFile(const std::string& path, std::vector<uint8_t>& data) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // Named by ContinuousProfiler as window-<start>-<length>.rstk and hour-<start>-<length>.rstk.
+    bool parseName(const char* name, Report::HistoryFile& file) {
+        unsigned long long start = 0, length = 0;
+        char suffix[8] = {};
+        if (std::sscanf(name, "window-%llu-%llu.%7s", &start, &length, suffix) == 3) file.compacted = false;
+        else if (std::sscanf(name, "hour-%llu-%llu.%7s", &start, &length, suffix) == 3) file.compacted = true;
+        else return false;
+        if (std::string(suffix) != "rstk") return false;
+        file.name = name;
+        file.start = start;
+        file.length = length;
+        return true;
+    }
+}
+
+bool Report::loadHistory(const std::string& directory, const HistoryOptions& options, History& history, std::string& error) {
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        error = "cannot open " + directory;
+        return false;
+    }
+    while (dirent* entry = readdir(dir)) {
+        HistoryFile file;
+        if (parseName(entry->d_name, file)) history.files.push_back(std::move(file));
+    }
+    closedir(dir);
+    std::sort(history.files.begin(), history.files.end(), [](const HistoryFile& a, const HistoryFile& b) { return a.start < b.start; });
+    if (history.files.empty()) {
+        error = "no profile windows in " + directory;
+        return false;
+    }
+
+    uint64_t first = history.files.front().start;
+    uint64_t last = 0;
+    for (const auto& file : history.files) last = std::max(last, file.start + file.length);
+    if (options.lastMillis) {
+        history.fromMillis = last - std::min(options.lastMillis, last);
+        history.toMillis = last;
+    } else {
+        history.fromMillis = first + options.fromMillis;
+        history.toMillis = options.toMillis == UINT64_MAX ? last : std::min(last, first + options.toMillis);
+    }
+
+    std::vector<uint8_t> data;
+    for (const auto& file : history.files) {
+        if (file.start + file.length <= history.fromMillis || file.start >= history.toMillis) continue;
+        StackProfile profile;
+        if (!readFile(directory + "/" + file.name, data) || !profile.parse(data.data(), data.size())) {
+            std::cerr << "rynox-report: skipping unreadable " << file.name << std::endl;
+            continue;
+        }
+        history.profile.merge(profile);
+        history.merged.push_back(file);
+    }
+    return true;
+}
+
+std::string Report::collapsedStack(const StackProfile& profile, size_t node) {
+    std::vector<uint32_t> frames;
+    for (uint32_t id = static_cast<uint32_t>(node) + 1; id != 0; id = profile.nodes()[id - 1].parent) frames.push_back(id - 1);
+    std::string stack;
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+        if (!stack.empty()) stack += ';';
+        stack += frameName(profile.methods()[profile.nodes()[*it].method]);
+    }
+    return stack.empty() ? "[unknown]" : stack;
+}
@@ -0,0 +1,48 @@
+#ifndef REPORT_HISTORY_H
+#define REPORT_HISTORY_H
+
+#include "StackProfile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Report {
+    // Metrics of a serialized StackTrie, in its order.
+    enum HistoryMetric : size_t { CpuSamples, WallSamples, AllocSamples, AllocBytes };
+
+    struct HistoryFile {
+        std::string name;
+        bool compacted;
+        // Epoch milliseconds, from the file name.
+        uint64_t start;
+        uint64_t length;
+    };
+
+    struct HistoryOptions {
+        // Range relative to the start of the oldest file, in milliseconds.
+        uint64_t fromMillis = 0;
+        uint64_t toMillis = UINT64_MAX;
+        // When set, the last lastMillis before the end of the newest file instead.
+        uint64_t lastMillis = 0;
+    };
+
+    struct History {
+        // Every window-*.rstk and hour-*.rstk of the directory, oldest first.
+        std::vector<HistoryFile> files;
+        // The files overlapping the requested range, merged whole.
+        std::vector<HistoryFile> merged;
+        // The requested range in epoch milliseconds.
+        uint64_t fromMillis = 0;
+        uint64_t toMillis = 0;
+        StackProfile profile;
+    };
+
+    // Reads a continuous profiler directory and merges the files overlapping the range. Unreadable
+    // files are skipped with a warning on stderr.
+    bool loadHistory(const std::string& directory, const HistoryOptions& options, History& history, std::string& error);
+
+    // Root-first frame names of a profile node joined with ';'.
+    std::string collapsedStack(const StackProfile& profile, size_t node);
+}
+
+#endif //REPORT_HISTORY_H
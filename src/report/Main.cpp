@@ -0,0 +1,306 @@
+#include "Capture.h"
+#include "Diff.h"
+#include "History.h"
+#include "Recover.h"
+#include "Timeline.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+namespace {
+    struct Arguments {
+        std::string command;
+        std::vector<std::string> traces;
+        Report::LoadOptions load;
+        bool cpu = false;
+        size_t top = 20;
+        Report::DiffOptions diff;
+        Report::HistoryOptions history;
+    };
+
+    void usage() {
+        std::cerr << "usage: rynox-report <summary|flame|top|timeline> [options] <trace>\n"
+                     "       rynox-report <diff|diff-flame> [options] <baseline trace> <candidate trace>\n"
+                     "       rynox-report recover <recorder dir>/ring.data[.prev] <output trace>\n"
+                     "       rynox-report <history|history-flame> [options] <continuous dir>\n"
+                     "  timeline writes Chrome trace JSON (Perfetto UI, chrome://tracing) to stdout\n"
+                     "  diff-flame writes two-column collapsed stacks for flamegraph.pl\n"
+                     "  history merges the profile windows in the range; history-flame writes them as collapsed stacks\n"
+                     "  --from <s>      only events at or after s seconds from the trace start (history: oldest window)\n"
+                     "  --to <s>        only events up to s seconds from the trace start (history: oldest window)\n"
+                     "  --last <s>      history: only the last s seconds of the directory\n"
+                     "  --cpu           use runnable samples instead of wall samples\n"
+                     "  --top <n>       rows per table (default 20)\n"
+                     "  --threads <n>   worker threads (default: all cores)\n"
+                     "  --level <l>     diff by stack, method (self), total (inclusive) or class (default method)\n"
+                     "  --min-z <z>     diff rows need |z| of at least z (default 3)\n"
+                     "  --min-delta <p> diff rows need a share change of at least p points (default 0.1)\n";
+    }
+
+    bool parseArguments(int argc, char** argv, Arguments& args) {
+        if (argc < 2) return false;
+        args.command = argv[1];
+        args.load.threads = std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--from" && hasValue) args.load.fromNanos = static_cast<uint64_t>(std::atof(argv[++i]) * 1e9);
+            else if (arg == "--to" && hasValue) args.load.toNanos = static_cast<uint64_t>(std::atof(argv[++i]) * 1e9);
+            else if (arg == "--last" && hasValue) args.history.lastMillis = static_cast<uint64_t>(std::atof(argv[++i]) * 1e3);
+            else if (arg == "--top" && hasValue) args.top = std::strtoul(argv[++i], nullptr, 10);
+            else if (arg == "--threads" && hasValue) args.load.threads = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+            else if (arg == "--min-z" && hasValue) args.diff.minZ = std::atof(argv[++i]);
+            else if (arg == "--min-delta" && hasValue) args.diff.minDelta = std::atof(argv[++i]);
+            else if (arg == "--level" && hasValue) {
+                std::string level = argv[++i];
+                if (level == "stack") args.diff.level = Report::DiffLevel::Stack;
+                else if (level == "method") args.diff.level = Report::DiffLevel::Method;
+                else if (level == "total") args.diff.level = Report::DiffLevel::MethodTotal;
+                else if (level == "class") args.diff.level = Report::DiffLevel::Class;
+                else return false;
+            }
+            else if (arg == "--cpu") args.cpu = true;
+            else if (!arg.empty() && arg[0] == '-') return false;
+            else args.traces.push_back(arg);
+        }
+        args.diff.cpu = args.cpu;
+        args.history.fromMillis = args.load.fromNanos / 1000000;
+        args.history.toMillis = args.load.toNanos == UINT64_MAX ? UINT64_MAX : args.load.toNanos / 1000000;
+        args.diff.threads = args.load.threads;
+        return !args.traces.empty();
+    }
+
+    template <typename T>
+    std::vector<std::pair<T, uint64_t>> ranked(const std::unordered_map<T, uint64_t>& counts, size_t top) {
+        std::vector<std::pair<T, uint64_t>> rows(counts.begin(), counts.end());
+        size_t limit = std::min(top, rows.size());
+        std::partial_sort(rows.begin(), rows.begin() + static_cast<long>(limit), rows.end(),
+                          [](const auto& a, const auto& b) { return a.second > b.second; });
+        rows.resize(limit);
+        return rows;
+    }
+
+    double seconds(uint64_t nanos) {
+        return static_cast<double>(nanos) / 1e9;
+    }
+
+    std::string threadName(const Report::Capture& capture, uint64_t id) {
+        auto it = capture.threads.find(id);
+        std::string_view name = it == capture.threads.end() ? std::string_view() : capture.reader.string(it->second.name);
+        return name.empty() ? "tid " + std::to_string(id) : std::string(name);
+    }
+
+    void printSummary(const Report::Capture& capture, const Arguments& args) {
+        const auto& header = capture.reader.header();
+        std::printf("trace: pid %u, %zu segments of %u KiB\n", header.pid, capture.reader.segmentCount(), header.segmentSize / 1024);
+        std::printf("window: %.3f s .. %.3f s\n", seconds(capture.firstNanos - header.startNanos), seconds(capture.lastNanos - header.startNanos));
+
+        std::printf("\nevents:\n");
+        for (const auto& [type, count] : capture.eventCounts) {
+            const TraceReader::Schema* schema = capture.reader.schema(type);
+            std::printf("  %-14s %12llu\n", schema ? std::string(schema->name).c_str() : "?", static_cast<unsigned long long>(count));
+        }
+
+        std::unordered_map<uint64_t, uint64_t> cpu;
+        for (const auto& [id, thread] : capture.threads) {
+            if (thread.cpuNanos) cpu[id] = thread.cpuNanos;
+        }
+        if (cpu.empty()) return;
+        std::printf("\nthreads by CPU (s, run-queue s, switches):\n");
+        for (const auto& [id, nanos] : ranked(cpu, args.top)) {
+            const auto& thread = capture.threads.at(id);
+            std::printf("  %10.3f %10.3f %10llu  %s\n", seconds(nanos), seconds(thread.runQueueNanos),
+                        static_cast<unsigned long long>(thread.switches), threadName(capture, id).c_str());
+        }
+    }
+
+    void printFlame(const Report::Capture& capture, const Arguments& args) {
+        std::unordered_map<std::string, uint64_t> collapsed;
+        for (const auto& [leaf, count] : args.cpu ? capture.cpuSamples : capture.wallSamples) {
+            collapsed[Report::collapsedStack(capture.reader, leaf)] += count;
+        }
+        for (const auto& [stack, count] : collapsed) std::printf("%s %llu\n", stack.c_str(), static_cast<unsigned long long>(count));
+    }
+
+    void printTop(const Report::Capture& capture, const Arguments& args) {
+        const auto& samples = args.cpu ? capture.cpuSamples : capture.wallSamples;
+        std::unordered_map<std::string, uint64_t> self;
+        std::unordered_map<std::string, uint64_t> total;
+        uint64_t sampleCount = 0;
+        std::vector<const TraceReader::StackNode*> frames;
+        std::unordered_set<std::string> seen;
+        for (const auto& [leaf, count] : samples) {
+            sampleCount += count;
+            capture.reader.frames(leaf, frames);
+            if (frames.empty()) continue;
+            self[Report::frameName(capture.reader.string(frames.front()->method))] += count;
+            seen.clear();
+            for (const auto* frame : frames) {
+                std::string name = Report::frameName(capture.reader.string(frame->method));
+                if (seen.insert(name).second) total[name] += count;
+            }
+        }
+
+        auto percent = [sampleCount](uint64_t count) { return sampleCount ? 100.0 * static_cast<double>(count) / static_cast<double>(sampleCount) : 0.0; };
+        std::printf("%s samples: %llu\n", args.cpu ? "cpu" : "wall", static_cast<unsigned long long>(sampleCount));
+        std::printf("\ntop methods by self samples:\n");
+        for (const auto& [name, count] : ranked(self, args.top)) std::printf("  %6.2f%% %10llu  %s\n", percent(count), static_cast<unsigned long long>(count), name.c_str());
+        std::printf("\ntop methods by total samples:\n");
+        for (const auto& [name, count] : ranked(total, args.top)) std::printf("  %6.2f%% %10llu  %s\n", percent(count), static_cast<unsigned long long>(count), name.c_str());
+
+        std::vector<Report::ClassLoad> loads = capture.classLoads;
+        size_t limit = std::min(args.top, loads.size());
+        std::partial_sort(loads.begin(), loads.begin() + static_cast<long>(limit), loads.end(),
+                          [](const auto& a, const auto& b) { return a.duration > b.duration; });
+        if (limit) std::printf("\nslowest class loads (ms):\n");
+        for (size_t i = 0; i < limit; i++) {
+            std::printf("  %10.3f  %s [%s]\n", static_cast<double>(loads[i].duration) / 1e6, std::string(capture.reader.string(loads[i].className)).c_str(),
+                        std::string(capture.reader.string(loads[i].loader)).c_str());
+        }
+
+        if (!capture.exceptionSites.empty()) std::printf("\nsampled exception sites:\n");
+        for (const auto& [site, count] : ranked(capture.exceptionSites, args.top)) {
+            std::printf("  %10llu  %s\n", static_cast<unsigned long long>(count), std::string(capture.reader.string(site)).c_str());
+        }
+    }
+
+    void printDiff(const Report::Capture& baseline, const Report::Capture& candidate, const Arguments& args) {
+        uint64_t baselineTotal = 0;
+        uint64_t candidateTotal = 0;
+        std::vector<Report::DiffRow> rows = Report::diff(baseline, candidate, args.diff, baselineTotal, candidateTotal);
+        std::printf("%s samples: baseline %llu, candidate %llu\n", args.cpu ? "cpu" : "wall", static_cast<unsigned long long>(baselineTotal),
+                    static_cast<unsigned long long>(candidateTotal));
+
+        auto print = [](const Report::DiffRow& row) {
+            std::printf("  %+8.2f %7.2f%% %7.2f%% %8.1f  %s\n", row.delta, row.baselineShare, row.candidateShare, row.z, row.key.c_str());
+        };
+        std::printf("\nregressions (delta points, baseline, candidate, z):\n");
+        for (size_t i = 0; i < rows.size() && i < args.top && rows[i].delta > 0; i++) print(rows[i]);
+        std::printf("\nimprovements (delta points, baseline, candidate, z):\n");
+        for (size_t i = 0; i < rows.size() && i < args.top && rows[rows.size() - 1 - i].delta < 0; i++) print(rows[rows.size() - 1 - i]);
+    }
+
+    int history(const Arguments& args) {
+        if (args.traces.size() != 1) {
+            usage();
+            return 2;
+        }
+        Report::History history;
+        std::string error;
+        if (!Report::loadHistory(args.traces.front(), args.history, history, error)) {
+            std::cerr << "rynox-report: " << error << std::endl;
+            return 1;
+        }
+        const StackProfile& profile = history.profile;
+        size_t metric = args.cpu ? Report::CpuSamples : Report::WallSamples;
+
+        if (args.command == "history-flame") {
+            std::unordered_map<std::string, uint64_t> collapsed;
+            for (size_t i = 0; i < profile.nodes().size(); i++) {
+                if (uint64_t count = profile.count(i, metric)) collapsed[Report::collapsedStack(profile, i)] += count;
+            }
+            for (const auto& [stack, count] : collapsed) std::printf("%s %llu\n", stack.c_str(), static_cast<unsigned long long>(count));
+            return 0;
+        }
+
+        std::unordered_map<std::string, uint64_t> self;
+        std::unordered_map<std::string, uint64_t> total;
+        uint64_t sampleCount = 0;
+        std::unordered_set<std::string> seen;
+        for (size_t i = 0; i < profile.nodes().size(); i++) {
+            uint64_t count = profile.count(i, metric);
+            if (!count) continue;
+            sampleCount += count;
+            self[Report::frameName(profile.methods()[profile.nodes()[i].method])] += count;
+            seen.clear();
+            for (uint32_t id = static_cast<uint32_t>(i) + 1; id != 0; id = profile.nodes()[id - 1].parent) {
+                std::string name = Report::frameName(profile.methods()[profile.nodes()[id - 1].method]);
+                if (seen.insert(name).second) total[name] += count;
+            }
+        }
+
+        std::printf("history: %zu of %zu files, epoch ms %llu .. %llu (%.0f s)\n", history.merged.size(), history.files.size(),
+                    static_cast<unsigned long long>(history.fromMillis), static_cast<unsigned long long>(history.toMillis),
+                    static_cast<double>(history.toMillis - history.fromMillis) / 1e3);
+        std::printf("%s samples: %llu\n", args.cpu ? "cpu" : "wall", static_cast<unsigned long long>(sampleCount));
+        std::printf("truncated stacks: %llu\n", static_cast<unsigned long long>(profile.truncatedStacks()));
+        auto percent = [sampleCount](uint64_t count) { return sampleCount ? 100.0 * static_cast<double>(count) / static_cast<double>(sampleCount) : 0.0; };
+        std::printf("\ntop methods by self samples:\n");
+        for (const auto& [name, count] : ranked(self, args.top)) std::printf("  %6.2f%% %10llu  %s\n", percent(count), static_cast<unsigned long long>(count), name.c_str());
+        std::printf("\ntop methods by total samples:\n");
+        for (const auto& [name, count] : ranked(total, args.top)) std::printf("  %6.2f%% %10llu  %s\n", percent(count), static_cast<unsigned long long>(count), name.c_str());
+        return 0;
+    }
+
+    int compare(const Arguments& args) {
+        if (args.traces.size() != 2) {
+            usage();
+            return 2;
+        }
+
+        // Each capture loads on half of the workers, both at once.
+        Report::LoadOptions load = args.load;
+        load.threads = std::max(1u, load.threads / 2);
+        Report::Capture baseline;
+        Report::Capture candidate;
+        std::string baselineError;
+        std::string candidateError;
+        bool baselineLoaded = false;
+        std::thread loader([&] { baselineLoaded = Report::load(args.traces[0], load, baseline, baselineError); });
+        bool candidateLoaded = Report::load(args.traces[1], load, candidate, candidateError);
+        loader.join();
+        if (!baselineLoaded || !candidateLoaded) {
+            std::cerr << "rynox-report: " << (baselineLoaded ? candidateError : baselineError) << std::endl;
+            return 1;
+        }
+
+        if (args.command == "diff") printDiff(baseline, candidate, args);
+        else Report::writeDiffFlame(baseline, candidate, args.diff, std::cout);
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    Arguments args;
+    if (!parseArguments(argc, argv, args)) {
+        usage();
+        return 2;
+    }
+    if (args.command == "diff" || args.command == "diff-flame") return compare(args);
+    if (args.command == "history" || args.command == "history-flame") return history(args);
+    if (args.command == "recover") {
+        std::string error;
+        if (args.traces.size() != 2) {
+            usage();
+            return 2;
+        }
+        if (Report::recover(args.traces[0], args.traces[1], error)) return 0;
+        std::cerr << "rynox-report: " << error << std::endl;
+        return 1;
+    }
+    if (args.traces.size() != 1) {
+        usage();
+        return 2;
+    }
+
+    Report::Capture capture;
+    std::string error;
+    if (!Report::load(args.traces.front(), args.load, capture, error)) {
+        std::cerr << "rynox-report: " << error << std::endl;
+        return 1;
+    }
+
+    if (args.command == "summary") printSummary(capture, args);
+    else if (args.command == "flame") printFlame(capture, args);
+    else if (args.command == "top") printTop(capture, args);
+    else if (args.command == "timeline") Report::writeTimeline(capture, args.load, std::cout);
+    else {
+        usage();
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "Recover.h"
+#include "TraceFormat.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+namespace {
+    bool readFile(const std::string& path, std::vector<uint8_t>& data) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // Offset just past the last complete record of a segment.
+    size_t usedBytes(const uint8_t* segment, size_t size, size_t start) {
+        size_t offset = start;
+        while (offset + sizeof(uint32_t) <= size) {
+            uint32_t header = 0;
+            std::memcpy(&header, segment + offset, sizeof(header));
+            if (header == 0) break;
+            size_t span = TraceFormat::recordSpan(header >> 8);
+            if (offset + span > size) break;
+            offset += span;
+        }
+        return offset;
+    }
+}
+
+bool Report::recover(const std::string& ringPath, const std::string& outputPath, std::string& error) {
+    std::string dictionaryPath = ringPath;
+    size_t suffix = dictionaryPath.rfind(".data");
+    if (suffix == std::string::npos) {
+        error = ringPath + " is not a ring.data file";
+        return false;
+    }
+    dictionaryPath.replace(suffix, 5, ".dict");
+
+    std::vector<uint8_t> ring;
+    std::vector<uint8_t> dictionary;
+    if (!readFile(ringPath, ring) || !readFile(dictionaryPath, dictionary)) {
+        error = "cannot read " + ringPath + " and " + dictionaryPath;
+        return false;
+    }
+
+    TraceFormat::RingHeader ringHeader{};
+    TraceFormat::FileHeader fileHeader{};
+    if (ring.size() < sizeof(ringHeader) || dictionary.size() < sizeof(fileHeader)) {
+        error = "ring files are truncated";
+        return false;
+    }
+    std::memcpy(&ringHeader, ring.data(), sizeof(ringHeader));
+    std::memcpy(&fileHeader, dictionary.data(), sizeof(fileHeader));
+    if (std::memcmp(ringHeader.magic, TraceFormat::RingMagic, sizeof(ringHeader.magic)) != 0 ||
+        std::memcmp(fileHeader.magic, TraceFormat::FileMagic, sizeof(fileHeader.magic)) != 0 ||
+        ringHeader.segmentSize != fileHeader.segmentSize || ringHeader.segmentSize == 0) {
+        error = "ring and dictionary do not belong together";
+        return false;
+    }
+
+    size_t segmentSize = ringHeader.segmentSize;
+    std::vector<std::pair<uint32_t, size_t>> slots;
+    for (size_t slot = 0; slot < ringHeader.segmentCount; slot++) {
+        size_t offset = (slot + 1) * segmentSize;
+        if (offset + sizeof(TraceFormat::SegmentHeader) > ring.size()) break;
+        TraceFormat::SegmentHeader header{};
+        std::memcpy(&header, ring.data() + offset, sizeof(header));
+        if (std::memcmp(header.magic, TraceFormat::SegmentMagic, sizeof(header.magic)) != 0) continue;
+        slots.emplace_back(header.index, offset);
+    }
+    std::sort(slots.begin(), slots.end());
+
+    // The dictionary file is a trace of its own; the ring segments follow it with new indices.
+    std::vector<uint8_t> out;
+    for (size_t offset = 0; offset < dictionary.size(); offset += segmentSize) {
+        size_t size = std::min(segmentSize, dictionary.size() - offset);
+        size_t headers = offset == 0 ? sizeof(fileHeader) + sizeof(TraceFormat::SegmentHeader) : sizeof(TraceFormat::SegmentHeader);
+        size_t used = usedBytes(dictionary.data() + offset, size, headers);
+        if (offset > 0 && used <= headers) break;
+        out.resize(offset, 0);
+        out.insert(out.end(), dictionary.begin() + static_cast<long>(offset), dictionary.begin() + static_cast<long>(offset + used));
+    }
+    for (const auto& [index, offset] : slots) {
+        size_t used = usedBytes(ring.data() + offset, std::min(segmentSize, ring.size() - offset), sizeof(TraceFormat::SegmentHeader));
+        out.resize((out.size() + segmentSize - 1) / segmentSize * segmentSize, 0);
+        size_t start = out.size();
+        out.insert(out.end(), ring.begin() + static_cast<long>(offset), ring.begin() + static_cast<long>(offset + used));
+        uint32_t newIndex = static_cast<uint32_t>(start / segmentSize);
+        std::memcpy(out.data() + start + offsetof(TraceFormat::SegmentHeader, index), &newIndex, sizeof(newIndex));
+    }
+
+    std::ofstream file(outputPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    if (!file) {
+        error = "cannot write " + outputPath;
+        return false;
+    }
+    std::cerr << "rynox-report: recovered " << slots.size() << " ring segments"
+              << (ringHeader.sealedSignal ? ", sealed by signal " + std::to_string(ringHeader.sealedSignal)
+                                          : ringHeader.closed ? ", closed cleanly" : ", not sealed")
+              << std::endl;
+    return true;
+}
@@ -0,0 +1,12 @@
+#ifndef REPORT_RECOVER_H
+#define REPORT_RECOVER_H
+
+#include <string>
+
+namespace Report {
+    // Stitches a flight recorder ring file (ring.data) and its dictionary (ring.dict, found by name)
+    // into a regular trace: dictionary segments first, then the ring segments oldest first.
+    bool recover(const std::string& ringPath, const std::string& outputPath, std::string& error);
+}
+
+#endif //REPORT_RECOVER_H
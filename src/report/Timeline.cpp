@@ -0,0 +1,179 @@
+#include "Timeline.h"
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+    void appendEscaped(std::string& out, std::string_view text) {
+        out += '"';
+        for (char c : text) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        out += escaped;
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        out += '"';
+    }
+
+    void appendMicros(std::string& out, uint64_t nanos) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f", static_cast<double>(nanos) / 1e3);
+        out += text;
+    }
+
+    // A field that names the event on its slice, in order of preference.
+    int titleField(const TraceReader& reader, uint8_t type) {
+        for (const char* name : {"kind", "name", "class", "method"}) {
+            int index = reader.fieldIndex(type, name);
+            if (index >= 0) return index;
+        }
+        return -1;
+    }
+
+    struct Segment {
+        std::string json;
+        std::unordered_set<uint64_t> threads;
+        std::unordered_set<uint64_t> stacks;
+        // Names carried by ThreadCpu records, for tasks that never had a ThreadStart.
+        std::unordered_map<uint64_t, uint64_t> counterNames;
+    };
+}
+
+void Report::writeTimeline(const Capture& capture, const LoadOptions& options, std::ostream& out) {
+    const TraceReader& reader = capture.reader;
+    using TraceFormat::RecordType;
+    const auto& header = reader.header();
+    uint64_t start = header.startNanos;
+    uint64_t from = start + options.fromNanos;
+    uint64_t to = options.toNanos == UINT64_MAX ? UINT64_MAX : start + options.toNanos;
+    std::string pid = std::to_string(header.pid);
+
+    std::vector<Segment> segments(reader.segmentCount());
+    reader.forEachSegment(options.threads, [&](size_t index, unsigned worker) {
+        Segment& segment = segments[index];
+        TraceReader::Event event;
+        reader.scanSegment(index, [&](uint8_t type, const uint8_t* payload, size_t size, uint64_t base) {
+            if (type < TraceFormat::FirstEvent || type == RecordType::ThreadStart) return;
+            if (!reader.decode(type, payload, size, base, event) || event.nanos < from || event.nanos > to) return;
+            const TraceReader::Schema* schema = reader.schema(type);
+            if (!schema) return;
+
+            int threadIndex = reader.fieldIndex(type, "thread");
+            int durationIndex = reader.fieldIndex(type, "duration");
+            uint64_t thread = threadIndex >= 0 ? event.values[threadIndex] : 0;
+            segment.threads.insert(thread);
+
+            std::string& json = segment.json;
+            json += ",\n{\"ph\":";
+            if (type == RecordType::ThreadCpu) json += "\"C\"";
+            else if (durationIndex >= 0) json += "\"X\"";
+            else if (type == RecordType::Milestone) json += "\"i\",\"s\":\"g\"";
+            else json += "\"i\",\"s\":\"t\"";
+            json += ",\"pid\":" + pid + ",\"tid\":" + std::to_string(thread) + ",\"ts\":";
+            appendMicros(json, event.nanos - start);
+            if (durationIndex >= 0) {
+                json += ",\"dur\":";
+                appendMicros(json, event.values[durationIndex]);
+            }
+            json += ",\"cat\":";
+            appendEscaped(json, schema->name);
+
+            json += ",\"name\":";
+            int stackIndex = reader.fieldIndex(type, "stack");
+            int title = titleField(reader, type);
+            if (type == RecordType::ThreadCpu) {
+                appendEscaped(json, "cpu " + std::to_string(thread));
+            } else if (type == RecordType::Sample && stackIndex >= 0) {
+                std::vector<const TraceReader::StackNode*> frames;
+                reader.frames(event.values[stackIndex], frames);
+                appendEscaped(json, frames.empty() ? "[unknown]" : frameName(reader.string(frames.front()->method)));
+            } else if (title >= 0) {
+                appendEscaped(json, reader.string(event.values[title]));
+            } else {
+                appendEscaped(json, schema->name);
+            }
+            if (stackIndex >= 0 && event.values[stackIndex]) {
+                json += ",\"sf\":" + std::to_string(event.values[stackIndex]);
+                segment.stacks.insert(event.values[stackIndex]);
+            }
+
+            json += ",\"args\":{";
+            bool first = true;
+            for (size_t i = 0; i < schema->fields.size() && i < event.fieldCount; i++) {
+                const auto& field = schema->fields[i];
+                if (field.kind == TraceFormat::Time || field.kind == TraceFormat::ThreadRef || field.kind == TraceFormat::StackRef) continue;
+                if (static_cast<int>(i) == durationIndex) continue;
+                // Counter args must be numeric; the name goes to the thread_name metadata instead.
+                if (type == RecordType::ThreadCpu && field.kind == TraceFormat::StringRef) {
+                    segment.counterNames[thread] = event.values[i];
+                    continue;
+                }
+                if (!first) json += ',';
+                first = false;
+                appendEscaped(json, field.name);
+                json += ':';
+                if (field.kind == TraceFormat::StringRef) appendEscaped(json, reader.string(event.values[i]));
+                else if (field.kind == TraceFormat::Duration) appendMicros(json, event.values[i]);
+                else if (field.kind == TraceFormat::Signed) json += std::to_string(static_cast<int64_t>(event.values[i]));
+                else json += std::to_string(event.values[i]);
+            }
+            json += "}}";
+        });
+    });
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    std::string json = "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" + pid + ",\"args\":{\"name\":\"Rynox " + pid + "\"}}";
+    std::set<uint64_t> threads;
+    std::unordered_set<uint64_t> stacks;
+    std::unordered_map<uint64_t, uint64_t> counterNames;
+    for (const auto& segment : segments) {
+        threads.insert(segment.threads.begin(), segment.threads.end());
+        stacks.insert(segment.stacks.begin(), segment.stacks.end());
+        for (const auto& [thread, name] : segment.counterNames) counterNames[thread] = name;
+    }
+    for (uint64_t thread : threads) {
+        auto it = capture.threads.find(thread);
+        std::string_view name = it == capture.threads.end() ? std::string_view() : reader.string(it->second.name);
+        if (auto counter = counterNames.find(thread); name.empty() && counter != counterNames.end()) name = reader.string(counter->second);
+        json += ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + pid + ",\"tid\":" + std::to_string(thread) + ",\"args\":{\"name\":";
+        appendEscaped(json, name.empty() ? "tid " + std::to_string(thread) : std::string(name));
+        json += "}}";
+    }
+    out << json;
+    for (const auto& segment : segments) out << segment.json;
+    out << "\n],\n\"stackFrames\":{";
+
+    // Only the ancestors of sampled stacks; ids are the trace's stack node ids.
+    std::unordered_set<uint64_t> written;
+    bool first = true;
+    for (uint64_t leaf : stacks) {
+        for (uint64_t id = leaf; id && written.insert(id).second;) {
+            const TraceReader::StackNode* node = reader.node(id);
+            if (!node) break;
+            json.clear();
+            if (!first) json += ',';
+            first = false;
+            json += "\n\"" + std::to_string(id) + "\":{\"name\":";
+            appendEscaped(json, frameName(reader.string(node->method)) + (node->line >= 0 ? ":" + std::to_string(node->line) : ""));
+            json += ",\"category\":\"java\"";
+            if (node->parent) json += ",\"parent\":\"" + std::to_string(node->parent) + "\"";
+            json += '}';
+            out << json;
+            id = node->parent;
+        }
+    }
+    out << "\n}}\n";
+}
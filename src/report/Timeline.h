@@ -0,0 +1,15 @@
+#ifndef REPORT_TIMELINE_H
+#define REPORT_TIMELINE_H
+
+#include "Capture.h"
+#include <ostream>
+
+namespace Report {
+    // Chrome trace event JSON, loadable in Perfetto UI and chrome://tracing. Every event of the
+    // window is placed on its native thread's track on the trace clock: events with a duration field
+    // become slices, ThreadCpu becomes per-thread counters, milestones are global instants and the
+    // rest are thread instants. Samples reference a stackFrames dictionary built from the stack nodes.
+    void writeTimeline(const Capture& capture, const LoadOptions& options, std::ostream& out);
+}
+
+#endif //REPORT_TIMELINE_H